@@ -84,6 +84,14 @@ struct PerFrameConstants
 
     CVector3   cameraPosition;
 	float      frameTime;      // This app does updates on the GPU so we pass over the frame update time
+
+    CVector3   fireworkOrigin; // Packed firework positions are relative to this point, see PackedFirework.h
+    float      padding5;
+
+    CVector3   fireworkRight;  // Camera right and up vectors for instanced firework quads, see FireworkQuads.h
+    float      padding6;
+    CVector3   fireworkUp;
+    float      padding7;
 };
 
 extern PerFrameConstants gPerFrameConstants;      // This variable holds the CPU-side constant buffer described above
@@ -8,7 +8,19 @@
 // Shader input for firework particles
 //--------------------------------------------------------------------------------------
 
-// Structure containing data to render a firework particle. Must exactly match Firework struct declared in Scene.cpp
+// Packed firework particle as it is stored in the vertex buffer. Built from the field list in Particles/PackedFireworkLayout.h,
+// which also builds the C++ PackedFirework struct and the D3D input layout, so they always match
+#include "Particles/PackedFireworkLayout.h"
+
+struct PackedFirework
+{
+#define PACKED_FIREWORK_FIELD(cppType, hlslType, name, format)  hlslType name : name;
+    PACKED_FIREWORK_FIELDS
+#undef PACKED_FIREWORK_FIELD
+};
+
+// Structure containing data to render a firework particle, unpacked by the vertex shader from the above and passed to the
+// geometry shader. Has the same fields as the Firework struct declared in Particles/FireworkTypes.h
 struct Firework
 {
     float3 position : position; // World position of particle
@@ -17,6 +29,15 @@ struct Firework
     float  rotation : rotation; // Z rotation of particle
 };
 
+// Vertex of an instanced firework quad: the packed firework, read once per instance, and a corner of the shared quad,
+// read per vertex (see Particles/FireworkQuads.h)
+struct FireworkQuadVertex
+{
+    PackedFirework firework;
+    float2         corner : quadCorner; // Multiples of the camera right and up vectors, times the particle scale
+    float2         uv     : quadUV;
+};
+
  
 //--------------------------------------------------------------------------------------
 // Shader input / output for models
@@ -90,6 +111,14 @@ cbuffer PerFrameConstants : register(b0) // The b0 gives this constant buffer th
 
     float3   gCameraPosition;
 	float    gFrameTime;      // This app does updates on the GPU so we pass over the frame update time
+
+    float3   gFireworkOrigin; // Packed firework positions are relative to this point (see Particles/PackedFireworkLayout.h)
+    float    padding5;
+
+    float3   gFireworkRight;  // Camera right and up vectors, for the corners of instanced firework quads (see Particles/FireworkQuads.h)
+    float    padding6;
+    float3   gFireworkUp;
+    float    padding7;
 }
 // Note constant buffers are not structs: we don't use the name of the constant buffer, these are really just a collection of global variables (hence the 'g')
 
@@ -112,3 +141,24 @@ cbuffer PerModelConstants : register(b1) // The b1 gives this constant buffer th
 }
 
 
+
+//--------------------------------------------------------------------------------------
+// Firework unpacking
+//--------------------------------------------------------------------------------------
+
+// Unpack a firework from the vertex buffer layout. See Particles/PackedFireworkLayout.h for the packing
+Firework UnpackFirework(PackedFirework input)
+{
+	Firework output;
+
+	// Half float position relative to the per-frame origin
+	output.position = gFireworkOrigin + float3(f16tof32(input.positionXY), f16tof32(input.positionXY >> 16), f16tof32(input.positionZSize));
+
+	// 8-bit scale is stored as the square root of the fraction of the largest scale, 8-bit rotation over a full turn
+	float packedScale = ((input.positionZSize >> 16) & 0xff) / 255.0f;
+	output.scale    = packedScale * packedScale * PACKED_FIREWORK_MAX_SCALE;
+	output.rotation = (input.positionZSize >> 24) * (360.0f / 256.0f);
+
+	output.colour = input.colour; // Unpacked from 8-bit by the input assembler
+	return output;
+}
@@ -1,7 +1,8 @@
 //--------------------------------------------------------------------------------------
 // Pass-Through Vertex Shader for Fireworks
 //--------------------------------------------------------------------------------------
-// Vertex shader that passes on firework data to the geometry shader without change
+// Vertex shader that unpacks firework data from the compact vertex buffer layout and passes
+// it on to the geometry shader. See UnpackFirework in Common.hlsli
 
 #include "Common.hlsli"
 
@@ -11,7 +12,7 @@
 //-----------------------------------------------------------------------------
 
 // Main vertex shader function
-Firework main(Firework input)
+Firework main(PackedFirework input)
 {
-	return input;
+	return UnpackFirework(input);
 }
@@ -0,0 +1,28 @@
+//--------------------------------------------------------------------------------------
+// Instanced Quad Vertex Shader for Fireworks
+//--------------------------------------------------------------------------------------
+// Vertex shader that draws each firework particle as an instance of a shared quad, with no
+// geometry shader. Each vertex is one corner of the quad, placed along the camera right and
+// up vectors from the per-frame constants. See Particles/FireworkQuads.h
+
+#include "Common.hlsli"
+
+
+//-----------------------------------------------------------------------------
+// Main function
+//-----------------------------------------------------------------------------
+
+// Main vertex shader function
+ColourTexturePixelShaderInput main(FireworkQuadVertex input)
+{
+	Firework firework = UnpackFirework(input.firework);
+
+	// Same corner as the geometry shader makes from the camera matrix, which the right and up vectors are the rows of
+	float3 worldPosition = firework.position + (gFireworkRight * input.corner.x + gFireworkUp * input.corner.y) * firework.scale;
+
+	ColourTexturePixelShaderInput output;
+	output.projectedPosition = mul(gViewProjectionMatrix, float4(worldPosition, 1.0f));
+	output.colour            = firework.colour;
+	output.uv                = input.uv;
+	return output;
+}
@@ -0,0 +1,580 @@
+//--------------------------------------------------------------------------------------
+// Headless firework simulation driver
+//--------------------------------------------------------------------------------------
+// Runs the firework simulation with no window or GPU for a number of simulated seconds
+// and reports throughput, peak particle count and the time taken by each phase of the
+// step. The launches come from a recorded launch log (see LaunchLog.h) or a built-in
+// show, so runs are repeatable and can be compared across machines, thread counts and
+// SIMD levels. Builds on any platform with the CMake project in the root folder
+
+#include "FireworkSimulation.h"
+#include "BudgetGovernor.h"
+#include "EmissionLod.h"
+#include "ParticleCulling.h"
+#include "PackedFirework.h"
+#include "FireworkQuads.h"
+#include "UpdateLod.h"
+#include "ParticleTimeline.h"
+#include "FireworkLaunch.h"
+#include "LaunchLog.h"
+#include "ParticleKernels.h"
+#include "CounterRandom.h"
+#include "MathHelpers.h"
+#include "CMatrix4x4.h"
+#include "WorkerPool.h"
+#include "CpuFeatures.h"
+#include "UploadRing.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+//--------------------------------------------------------------------------------------
+// Settings
+//--------------------------------------------------------------------------------------
+
+struct HeadlessSettings
+{
+	float       seconds        = 0;      // Simulated time to run for. 0 for the default: 30s for the built-in show,
+	                                     // until the last firework has died for a replay
+	int         rate           = 60;     // Steps per second (replays use the rate they were recorded at)
+	int         threads        = 0;      // 0 for one per hardware thread
+	int         maxParticles   = 50000;
+	float       launchInterval = 0.5f;   // Built-in show: time between launches
+	uint32_t    seed           = 1;      // Built-in show: seed for launch positions, colours and directions
+	std::string replayFile;              // Launch log to replay instead of the built-in show
+	std::string profileFile;             // Optional CSV of the stats of every step
+	float       budgetMs       = 0;      // Per-step cost target for the budget governor, 0 for no governor
+	int         lodWidth       = 0;      // Viewport width for emission LOD from the app's starting camera, 0 for no LOD
+	int         cullWidth      = 0;      // Viewport width for culled vertex gathers from the starting camera, 0 for none
+	int         updateLodWidth = 0;      // Viewport width for update LOD from the starting camera, 0 for no LOD
+	int         timelineSteps  = 0;      // Steps between checks of the recorded timeline against the simulation, 0 for none
+	bool        instanceBursts = false;  // Burst instancing (see BurstInstances.h)
+	int         emissionCap    = -1;     // Most trail particles emitted in a step, -1 for no cap
+	bool        zeroCopy       = true;   // Culled gathers write packed vertices straight into the upload ring
+	bool        checkQuads     = false;  // Expand culled gathers to quad corners as the instanced vertex shader does
+	bool        setKernel      = false;
+	SimdLevel   kernel         = SimdLevel::Scalar;
+};
+
+
+void PrintUsage()
+{
+	std::printf("Usage: FireworksHeadless [options]\n"
+	            "  --seconds S        Simulated seconds to run (default 30, replays default to their full length)\n"
+	            "  --rate HZ          Simulation steps per second (default 60, ignored for replays)\n"
+	            "  --threads N        Worker threads, 0 for one per hardware thread (default 0)\n"
+	            "  --max-particles N  Particle cap (default 50000)\n"
+	            "  --interval S       Built-in show: seconds between launches (default 0.5)\n"
+	            "  --seed N           Built-in show: random seed (default 1)\n"
+	            "  --replay FILE      Replay a launch log recorded in the app instead of the built-in show\n"
+	            "  --kernel LEVEL     Force the SIMD level: scalar, sse2 or avx2 (default: best available)\n"
+	            "  --profile FILE     Write the counts and phase timings of every step to a CSV file\n"
+	            "  --budget MS        Lower emission quality to keep each step under MS milliseconds (default: off)\n"
+	            "  --lod WIDTH        Emission LOD as seen from the app's starting camera in a WIDTH pixel wide window (default: off)\n"
+	            "  --cull WIDTH       Also gather culled vertices each step as the app does, from the same camera (default: off)\n"
+	            "  --update-lod WIDTH Update distant and off-screen stars less often, as seen from the same camera (default: off)\n"
+	            "  --timeline STEPS   Record every spawn and check closed-form evaluation against the simulation every STEPS steps (default: off)\n"
+	            "  --instance-bursts B  1 to keep bursts of simple stars as instances with shared offset tables (default: 0)\n"
+	            "  --emission-cap N   Emit no more than N trail particles in a step (default: no cap)\n"
+	            "  --zero-copy B      0 to gather culled vertices into an array and pack them from there (default: 1)\n"
+	            "  --quads B          1 to expand culled vertices to instanced quad corners and check them against unpacked ones (default: 0)\n");
+}
+
+
+// Read the command line into settings. Returns false on an unknown option or bad value
+bool ParseArguments(int argc, char* argv[], HeadlessSettings& settings)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string option = argv[i];
+		if (option == "--help" || option == "-h")  return false;
+		if (i + 1 >= argc)
+		{
+			std::fprintf(stderr, "Missing value for %s\n", option.c_str());
+			return false;
+		}
+		const char* value = argv[++i];
+
+		if      (option == "--seconds")        settings.seconds        = std::strtof(value, nullptr);
+		else if (option == "--rate")           settings.rate           = std::atoi(value);
+		else if (option == "--threads")        settings.threads        = std::atoi(value);
+		else if (option == "--max-particles")  settings.maxParticles   = std::atoi(value);
+		else if (option == "--interval")       settings.launchInterval = std::strtof(value, nullptr);
+		else if (option == "--seed")           settings.seed           = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+		else if (option == "--replay")         settings.replayFile     = value;
+		else if (option == "--profile")        settings.profileFile    = value;
+		else if (option == "--budget")         settings.budgetMs       = std::strtof(value, nullptr);
+		else if (option == "--lod")            settings.lodWidth       = std::atoi(value);
+		else if (option == "--cull")           settings.cullWidth      = std::atoi(value);
+		else if (option == "--update-lod")     settings.updateLodWidth = std::atoi(value);
+		else if (option == "--timeline")       settings.timelineSteps  = std::atoi(value);
+		else if (option == "--instance-bursts") settings.instanceBursts = std::atoi(value) != 0;
+		else if (option == "--emission-cap")   settings.emissionCap    = std::atoi(value);
+		else if (option == "--zero-copy")      settings.zeroCopy       = std::atoi(value) != 0;
+		else if (option == "--quads")          settings.checkQuads     = std::atoi(value) != 0;
+		else if (option == "--kernel")
+		{
+			settings.setKernel = true;
+			if      (std::strcmp(value, "scalar") == 0)  settings.kernel = SimdLevel::Scalar;
+			else if (std::strcmp(value, "sse2")   == 0)  settings.kernel = SimdLevel::SSE2;
+			else if (std::strcmp(value, "avx2")   == 0)  settings.kernel = SimdLevel::AVX2;
+			else
+			{
+				std::fprintf(stderr, "Unknown kernel level %s\n", value);
+				return false;
+			}
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option %s\n", option.c_str());
+			return false;
+		}
+	}
+
+	if (settings.rate <= 0 || settings.maxParticles <= 0 || settings.threads < 0 || settings.seconds < 0 ||
+	    settings.launchInterval <= 0 || settings.budgetMs < 0 || settings.lodWidth < 0 || settings.cullWidth < 0 ||
+	    settings.updateLodWidth < 0 || settings.timelineSteps < 0 ||
+	    settings.emissionCap < -1)
+	{
+		std::fprintf(stderr, "Invalid settings\n");
+		return false;
+	}
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Built-in show
+//--------------------------------------------------------------------------------------
+
+// Fill the log with a show that cycles through every launch kind at regular intervals, from positions and colours
+// chosen by the seed. The show is a launch log like a recording, so it runs through the same replay code
+void BuildShow(const HeadlessSettings& settings, LaunchLog& log)
+{
+	float stepTime = 1.0f / settings.rate;
+	log.Clear(stepTime);
+
+	int numLaunches = static_cast<int>(settings.seconds / settings.launchInterval + 0.5f);
+	for (int i = 0; i < numLaunches; ++i)
+	{
+		RandomStream random({ settings.seed, static_cast<uint32_t>(i) });
+
+		LaunchParams params;
+		params.kind            = static_cast<LaunchKind>(i % NumLaunchKinds);
+		params.numFireworks    = 3;
+		params.position        = { random.Next(-80.0f, 80.0f), 0.0f, random.Next(-40.0f, 40.0f) };
+		params.colour          = { random.Next(0.3f, 1.0f), random.Next(0.3f, 1.0f), random.Next(0.3f, 1.0f), 1.0f };
+		params.scale           = 1.0f;
+		params.rotation        = 0.0f;
+		params.initialVelocity = random.Next(70.0f, 100.0f);
+		params.burstParticles  = 200;
+		params.burstLife       = random.Next(2.0f, 3.0f);
+		params.seed            = HashSeed(settings.seed, static_cast<uint32_t>(i));
+
+		log.Add(static_cast<uint32_t>(i * settings.launchInterval / stepTime + 0.5f), params);
+	}
+}
+
+
+// View and projection matrices of the camera the app starts with (see InitScene in Scene.cpp and Camera.cpp), which
+// looks at the launch area of the built-in show. Used for emission LOD and culling
+void StartingCamera(CMatrix4x4& viewMatrix, CMatrix4x4& projectionMatrix)
+{
+	const float fov = PI / 3, aspectRatio = 4.0f / 3.0f, nearClip = 0.1f, farClip = 10000.0f;
+
+	viewMatrix = InverseAffine(MatrixRotationX(ToRadians(-7.5f)) * MatrixTranslation({ 0, 50, -200 }));
+	float scaleX  = 1.0f / std::tan(fov * 0.5f);
+	float scaleZa = farClip / (farClip - nearClip);
+	projectionMatrix = { scaleX,                    0.0f,                0.0f, 0.0f,
+	                       0.0f, aspectRatio * scaleX,                0.0f, 0.0f,
+	                       0.0f,                    0.0f,             scaleZa, 1.0f,
+	                       0.0f,                    0.0f, -nearClip * scaleZa, 0.0f };
+}
+
+
+//--------------------------------------------------------------------------------------
+// Run
+//--------------------------------------------------------------------------------------
+
+// Totals and worst case of one phase of the step over the whole run
+struct PhaseTotals
+{
+	double totalMs = 0;
+	float  maxMs   = 0;
+
+	void Add(float ms)  { totalMs += ms;  if (ms > maxMs)  maxMs = ms; }
+};
+
+
+// Results of evaluating the timeline in closed form and comparing with the simulation's particles
+struct TimelineCheck
+{
+	uint64_t    numChecks  = 0;
+	uint64_t    numMatched = 0; // Particles found in both, by id
+	uint64_t    numMissing = 0; // Simulated particles with no evaluated particle of the same id
+	double      maxError   = 0; // Largest distance between a simulated and an evaluated position
+	PhaseTotals evaluate;
+};
+
+// Evaluate the timeline at the simulation's current time and compare every particle with the one of the same id in the
+// pool. Particles whose ids are not unique are skipped. Evicted particles are still alive in the timeline, so are not
+// counted as missing either way
+void CheckTimeline(FireworkSimulation& simulation, ParticleTimeline& timeline, ParticleStore& evaluated, TimelineCheck& check)
+{
+	auto evaluateStart = std::chrono::steady_clock::now();
+	evaluated.Clear();
+	timeline.Evaluate(simulation.Time(), evaluated);
+	check.evaluate.Add(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - evaluateStart).count());
+
+	ParticleSpan e = evaluated.Span();
+	std::unordered_map<uint32_t, int> byId;
+	for (int i = 0; i < e.count; ++i)
+	{
+		auto inserted = byId.emplace(e.id[i], i);
+		if (!inserted.second)  inserted.first->second = -1;
+	}
+
+	ParticlePool& pool = simulation.Particles();
+	for (int stream = 0; stream < NumParticleStreams; ++stream)
+	{
+		pool.ForEachSpan(stream, 0, pool.StreamSize(stream), [&](const ParticleSpan& p, int)
+		{
+			for (int i = 0; i < p.count; ++i)
+			{
+				auto match = byId.find(p.id[i]);
+				if (match == byId.end())
+				{
+					++check.numMissing;
+					continue;
+				}
+				if (match->second < 0)  continue;
+				int j = match->second;
+				double dx = p.posX[i] - e.posX[j], dy = p.posY[i] - e.posY[j], dz = p.posZ[i] - e.posZ[j];
+				double error = std::sqrt(dx * dx + dy * dy + dz * dz);
+				if (error > check.maxError)  check.maxError = error;
+				++check.numMatched;
+			}
+		});
+	}
+	++check.numChecks;
+}
+
+
+// Results of expanding uploaded instances to their quad corners as the instanced vertex shader does, compared with the
+// corners of the same vertices before they were packed
+struct QuadCheck
+{
+	uint64_t numInstances = 0;
+	double   maxError     = 0; // Largest distance between a corner of a packed instance and the unpacked vertex's corner
+	double   maxRelative  = 0; // The same, as a fraction of the distance from the camera (the packing origin), which is
+	                           // about the angle the error covers on screen
+};
+
+// The packed instances must be the given vertices, packed in the same order
+void CheckQuads(const Firework* vertices, const PackedVertexSpan& instances, int count, const FireworkQuadBasis& basis,
+                QuadCheck& check)
+{
+	CVector3 corners[NumFireworkQuadVertices], instanceCorners[NumFireworkQuadVertices];
+	for (int i = 0; i < count; ++i)
+	{
+		Firework instance = UnpackFirework(instances.vertices[i], instances.origin);
+		Firework vertex   = vertices[i];
+		vertex.scale = std::fabs(vertex.scale); // Packing keeps only the size of the scale, which gives the same quad
+		ExpandFireworkQuad(vertex, basis, corners);
+		ExpandFireworkQuad(instance, basis, instanceCorners);
+		for (int corner = 0; corner < NumFireworkQuadVertices; ++corner)
+		{
+			double error = Length(instanceCorners[corner] - corners[corner]);
+			if (error > check.maxError)  check.maxError = error;
+			double distance = Length(corners[corner] - instances.origin);
+			if (distance > 0 && error / distance > check.maxRelative)  check.maxRelative = error / distance;
+		}
+	}
+	check.numInstances += count;
+}
+
+
+int main(int argc, char* argv[])
+{
+	HeadlessSettings settings;
+	if (!ParseArguments(argc, argv, settings))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (settings.setKernel)
+	{
+		SetParticleKernelLevel(settings.kernel);
+		SetRandomKernelLevel(settings.kernel);
+	}
+
+	// Launches to play - a recording from the app or the built-in show
+	LaunchLog log;
+	if (!settings.replayFile.empty())
+	{
+		if (!log.Load(settings.replayFile))
+		{
+			std::fprintf(stderr, "%s\n", log.LastError().c_str());
+			return 1;
+		}
+	}
+	else
+	{
+		if (settings.seconds == 0)  settings.seconds = 30;
+		BuildShow(settings, log);
+	}
+	float stepTime = log.StepTime();
+
+	// A replay with no time given runs until all launches are played and the last firework has died (with a limit in
+	// case a log never finishes). Otherwise run for exactly the given time
+	bool runToEnd = settings.seconds == 0;
+	uint64_t maxSteps = runToEnd ? static_cast<uint64_t>(3600 / stepTime) : static_cast<uint64_t>(settings.seconds / stepTime + 0.5f);
+
+	WorkerPool workers(settings.threads);
+	FireworkSimulation simulation(settings.maxParticles);
+	simulation.SetWorkerPool(&workers);
+	CMatrix4x4 viewMatrix, projectionMatrix;
+	StartingCamera(viewMatrix, projectionMatrix);
+	if (settings.lodWidth > 0)
+	{
+		simulation.SetEmissionView(MakeEmissionView(viewMatrix, projectionMatrix, static_cast<float>(settings.lodWidth)));
+	}
+	if (settings.updateLodWidth > 0)
+	{
+		simulation.SetUpdateLodView(MakeUpdateLodView(viewMatrix, projectionMatrix, static_cast<float>(settings.updateLodWidth)));
+	}
+
+	// The timeline records the show as it runs, starting from the empty pool
+	ParticleTimeline timeline(stepTime, simulation.Gravity());
+	ParticleStore    evaluated;
+	TimelineCheck    timelineCheck;
+	if (settings.timelineSteps > 0)  simulation.SetTimeline(&timeline);
+	simulation.SetBurstInstancing(settings.instanceBursts);
+	simulation.SetEmissionCap(settings.emissionCap);
+
+	// Culled vertex gathers are packed relative to the camera straight into an upload ring as in the app, timed apart from
+	// the step. The ring's buffer is in memory, with a pretend GPU running two frames behind. Without zero copy they go
+	// through an ordinary array first, as before
+	CullView cullView = MakeCullView(viewMatrix, projectionMatrix, static_cast<float>(settings.cullWidth));
+	CVector3 cameraPosition = InverseAffine(viewMatrix).GetPosition();
+	std::vector<Firework> vertices;
+	MockUploadBackend uploadBackend(settings.cullWidth > 0 ? NumUploadFrames * settings.maxParticles * static_cast<int>(sizeof(PackedFirework)) : 0,
+	                                NumUploadFrames, NumUploadFrames - 1);
+	UploadRing uploadRing(uploadBackend);
+	uint64_t   unsafeUploads = 0;
+	FireworkQuadBasis   quadBasis = MakeFireworkQuadBasis(InverseAffine(viewMatrix));
+	QuadCheck           quadCheck;
+	CullCounts culled;
+	uint64_t   gathered = 0;
+	PhaseTotals gather;
+
+	std::ofstream profile;
+	if (!settings.profileFile.empty())
+	{
+		profile.open(settings.profileFile);
+		if (!profile)
+		{
+			std::fprintf(stderr, "Error writing %s\n", settings.profileFile.c_str());
+			return 1;
+		}
+		profile << "step,particles,spawned,removed,evicted,dropped,update_ms,remove_ms,commit_ms,tier\n";
+	}
+
+	// Each step counts as a frame for the governor, there is no upload
+	BudgetGovernor governor(settings.budgetMs);
+	governor.SetEnabled(settings.budgetMs > 0);
+	std::vector<uint64_t> stepsAtTier(governor.NumTiers());
+
+	PhaseTotals update, remove, commit, total;
+	uint64_t particleUpdates = 0; // Sum over all steps of the particles each step updated
+	uint64_t spawned = 0, removed = 0, evicted = 0, dropped = 0;
+	uint64_t chunks = 0, chunksExpired = 0;
+	uint64_t deferred = 0;
+	uint64_t capped   = 0;
+	uint64_t removedByType[NumFireworkTypes] = {};
+	int      peakParticles = 0;
+	int      peakBursts    = 0;
+	uint64_t peakStep      = 0;
+
+	LaunchReplay replay(log);
+	uint64_t step = 0;
+	for (; step < maxSteps; ++step)
+	{
+		if (runToEnd && replay.Finished() && simulation.NumParticles() == 0)  break;
+
+		particleUpdates += simulation.Particles().Size();
+		replay.Play(simulation.StepNumber(), simulation.Launches());
+		simulation.SetEmissionQuality(governor.Quality());
+		++stepsAtTier[governor.Tier()];
+		simulation.Step(stepTime);
+
+		const SimulationStats& stats = simulation.LastStepStats();
+		if (settings.cullWidth > 0)
+		{
+			auto gatherStart = std::chrono::steady_clock::now();
+			int maxBytes = simulation.NumParticles() * sizeof(PackedFirework);
+			auto packed = static_cast<PackedFirework*>(uploadRing.Begin(maxBytes, sizeof(PackedFirework)));
+			PackedVertexSpan packedSpan = { packed, simulation.NumParticles(), cameraPosition };
+			int numGathered = 0;
+			if (packed != nullptr && settings.zeroCopy)
+			{
+				numGathered  = simulation.Particles().GatherVisibleVertices(packedSpan, 1.0f, cullView, culled);
+				numGathered += simulation.Bursts().GatherVisibleVertices(packedSpan.Skip(numGathered), 1.0f, cullView, culled);
+			}
+			else if (packed != nullptr)
+			{
+				vertices.resize(simulation.NumParticles());
+				numGathered  = simulation.Particles().GatherVisibleVertices(vertices.data(), 1.0f, cullView, culled);
+				numGathered += simulation.Bursts().GatherVisibleVertices(vertices.data() + numGathered, 1.0f, cullView, culled);
+				PackFireworks(vertices.data(), numGathered, packedSpan);
+			}
+			int uploadOffset = uploadRing.End(numGathered * sizeof(PackedFirework));
+			if (packed != nullptr && !uploadBackend.CheckWrite(uploadOffset, numGathered * sizeof(PackedFirework)))  ++unsafeUploads;
+			uploadRing.EndFrame();
+			gathered += numGathered;
+			gather.Add(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - gatherStart).count());
+
+			// The zero copy gathers have no unpacked vertices to check against, so gather them again
+			if (settings.checkQuads && packed != nullptr)
+			{
+				if (settings.zeroCopy)
+				{
+					CullCounts recounted;
+					vertices.resize(simulation.NumParticles());
+					int numUnpacked = simulation.Particles().GatherVisibleVertices(vertices.data(), 1.0f, cullView, recounted);
+					simulation.Bursts().GatherVisibleVertices(vertices.data() + numUnpacked, 1.0f, cullView, recounted);
+				}
+				CheckQuads(vertices.data(), packedSpan, numGathered, quadBasis, quadCheck);
+			}
+		}
+		if (settings.timelineSteps > 0 && (step + 1) % settings.timelineSteps == 0)
+		{
+			CheckTimeline(simulation, timeline, evaluated, timelineCheck);
+		}
+		governor.AddFrame(stats.TotalMs());
+		update.Add(stats.updateMs);
+		remove.Add(stats.removeMs);
+		commit.Add(stats.commitMs);
+		total .Add(stats.TotalMs());
+		spawned += stats.numSpawned;
+		removed += stats.numRemoved;
+		evicted += stats.numEvicted;
+		for (int type = 0; type < NumFireworkTypes; ++type)  removedByType[type] += stats.numRemovedByType[type];
+		dropped += stats.numDropped;
+		chunks        += stats.numChunks;
+		chunksExpired += stats.numChunksExpired;
+		deferred      += stats.numDeferred;
+		capped        += stats.numCapped;
+		if (stats.numBursts > peakBursts)  peakBursts = stats.numBursts;
+		if (stats.numParticles > peakParticles)
+		{
+			peakParticles = stats.numParticles;
+			peakStep      = step;
+		}
+
+		if (profile.is_open())
+		{
+			profile << step << ',' << stats.numParticles << ',' << stats.numSpawned << ',' << stats.numRemoved << ','
+			        << stats.numEvicted << ',' << stats.numDropped << ',' << stats.updateMs << ',' << stats.removeMs << ',' << stats.commitMs << ','
+			        << governor.Tier() << '\n';
+		}
+	}
+
+
+	// Report //
+
+	double wallSeconds = total.totalMs / 1000.0;
+	double steps       = step > 0 ? static_cast<double>(step) : 1.0;
+
+	std::printf("Scenario:       %s, %d launches\n", settings.replayFile.empty() ? "built-in show" : settings.replayFile.c_str(), log.Size());
+	std::printf("Steps:          %llu (%.1f simulated seconds at %.0f Hz)\n", static_cast<unsigned long long>(step),
+	            step * stepTime, 1.0f / stepTime);
+	std::printf("Threads:        %d   Kernel: %s   Max particles: %d\n", workers.NumThreads(),
+	            SimdLevelName(ParticleKernelLevel()), settings.maxParticles);
+	std::printf("Peak particles: %d (step %llu)\n", peakParticles, static_cast<unsigned long long>(peakStep));
+	std::printf("Spawned:        %llu   Removed: %llu   Evicted: %llu   Dropped: %llu\n", static_cast<unsigned long long>(spawned),
+	            static_cast<unsigned long long>(removed), static_cast<unsigned long long>(evicted), static_cast<unsigned long long>(dropped));
+	std::printf("Deaths by type:");
+	for (int type = 0; type < NumFireworkTypes; ++type)
+	{
+		std::printf(" %s %llu", FireworkTypeName(static_cast<FireworkType>(type)), static_cast<unsigned long long>(removedByType[type]));
+	}
+	std::printf("\n");
+	std::printf("Expiry search:  %.1f%% of chunks had expiries due\n", chunks > 0 ? 100.0 * chunksExpired / chunks : 0.0);
+	if (simulation.UsingEmissionView())
+	{
+		std::printf("Emission LOD:   starting camera, %d pixels wide\n", settings.lodWidth);
+	}
+	if (simulation.UsingUpdateLodView())
+	{
+		std::printf("Update LOD:     starting camera, %d pixels wide: %.1f%% of particle updates deferred\n",
+		            settings.updateLodWidth, particleUpdates > 0 ? 100.0 * deferred / particleUpdates : 0.0);
+	}
+	if (settings.emissionCap >= 0 || capped > 0)
+	{
+		std::printf("Emission caps:  %llu trail particles not emitted\n", static_cast<unsigned long long>(capped));
+	}
+	if (simulation.UsingBurstInstancing())
+	{
+		std::printf("Bursts:         instanced, peak %d bursts, %d stars in instances at the end\n", peakBursts, simulation.Bursts().NumStars());
+	}
+	if (governor.Enabled())
+	{
+		std::printf("Budget:         %.2f ms per step, steps at each tier:", governor.TargetMs());
+		for (int tier = 0; tier < governor.NumTiers(); ++tier)
+		{
+			std::printf(" %s %llu", DefaultQualityTiers()[tier].name, static_cast<unsigned long long>(stepsAtTier[tier]));
+		}
+		std::printf("\n");
+	}
+	if (settings.cullWidth > 0)
+	{
+		double tested = culled.numTested > 0 ? culled.numTested : 1.0;
+		std::printf("Culling:        starting camera, %d pixels wide: %.1f%% outside view, %.1f%% faded\n", settings.cullWidth,
+		            100.0 * culled.numOutside / tested, 100.0 * culled.numFaded / tested);
+		const UploadRingStats& ring = uploadRing.Stats();
+		std::printf("Upload:         %.1f MB of %.1f MB (%.1f MB unpacked), gather and pack %.4f ms per step\n",
+		            ring.numBytes / 1.0e6, culled.numTested * static_cast<double>(sizeof(PackedFirework)) / 1.0e6,
+		            gathered * sizeof(Firework) / 1.0e6, gather.totalMs / steps);
+		std::printf("Upload ring:    %llu uploads, %llu wraps, %llu discards, %llu unsafe writes\n",
+		            static_cast<unsigned long long>(ring.numUploads), static_cast<unsigned long long>(ring.numWraps),
+		            static_cast<unsigned long long>(ring.numDiscards), static_cast<unsigned long long>(unsafeUploads));
+		if (settings.checkQuads)
+		{
+			std::printf("Quads:          %llu instances expanded, max corner error %.3g (%.3f%% of distance from camera)\n",
+			            static_cast<unsigned long long>(quadCheck.numInstances), quadCheck.maxError, 100.0 * quadCheck.maxRelative);
+		}
+	}
+	if (settings.timelineSteps > 0)
+	{
+		std::printf("Timeline:       %d spawns recorded, %llu particles checked at %llu steps: %llu not found, max position "
+		            "error %.3g, evaluation %.4f ms per check\n", timeline.Size(), static_cast<unsigned long long>(timelineCheck.numMatched),
+		            static_cast<unsigned long long>(timelineCheck.numChecks), static_cast<unsigned long long>(timelineCheck.numMissing),
+		            timelineCheck.maxError, timelineCheck.evaluate.totalMs / (timelineCheck.numChecks > 0 ? timelineCheck.numChecks : 1));
+	}
+	std::printf("Step time:      %.3f s total (%.1fx real time)\n", wallSeconds,
+	            wallSeconds > 0 ? step * stepTime / wallSeconds : 0.0);
+	std::printf("Throughput:     %.0f particles/sec\n", wallSeconds > 0 ? particleUpdates / wallSeconds : 0.0);
+	std::printf("\n%-8s %12s %10s %10s %7s\n", "Phase", "total ms", "mean ms", "max ms", "share");
+
+	auto printPhase = [&](const char* name, const PhaseTotals& phase)
+	{
+		std::printf("%-8s %12.2f %10.4f %10.4f %6.1f%%\n", name, phase.totalMs, phase.totalMs / steps, phase.maxMs,
+		            total.totalMs > 0 ? 100.0 * phase.totalMs / total.totalMs : 0.0);
+	};
+	printPhase("update", update);
+	printPhase("remove", remove);
+	printPhase("commit", commit);
+	printPhase("total",  total);
+
+	return 0;
+}
@@ -121,6 +121,11 @@ float Length(const CVector3& v)
 // E.g. CVector3 randomDir = RandomVector(myDir, 15); // Get a random vector going roughly in the same directions as "myDir", within 15 degrees
 // or   CVector3 anyDir = RandomVector(CVector3(0, 1, 0), 180); // Get a random vector in any direction
 CVector3 RandomVectorInCone(const CVector3& direction, float angle)
+{
+	return RandomVectorInCone(direction, angle, DefaultRandomStream());
+}
+
+CVector3 RandomVectorInCone(const CVector3& direction, float angle, RandomStream& random)
 {
 	// Maths here is not important for the assignment - useful function to have in your toolbox
 	// 
@@ -129,8 +134,8 @@ CVector3 RandomVectorInCone(const CVector3& direction, float angle)
 	float radians = ToRadians(angle);
 
 	// Random deviation and rotation
-	float a = Random(0.0f, ToRadians(angle));
-	float b = Random(0.0f, ToRadians(360.0f));
+	float a = random.Next(0.0f, ToRadians(angle));
+	float b = random.Next(0.0f, ToRadians(360.0f));
 
 	// Create two perpendicular unit vectors that are orthogonal to dir
 	CVector3 u;
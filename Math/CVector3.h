@@ -98,5 +98,8 @@ float Length(const CVector3& v);
 // or   CVector3 anyDir = RandomVector(CVector3(0, 1, 0), 180); // Get a random vector in any direction
 CVector3 RandomVectorInCone(const CVector3& direction, float angle);
 
+// As above, but taking its random numbers from the given stream, so the result can be repeated
+CVector3 RandomVectorInCone(const CVector3& direction, float angle, RandomStream& random);
+
 
 #endif // _CVECTOR3_H_DEFINED_
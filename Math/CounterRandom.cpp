@@ -0,0 +1,523 @@
+//--------------------------------------------------------------------------------------
+// Counter-based random numbers (Philox4x32-10)
+//--------------------------------------------------------------------------------------
+
+#include "CounterRandom.h"
+
+#include <cmath>
+
+#if SIMD_X86_AVAILABLE
+	#include <immintrin.h>
+#endif
+
+
+// Philox constants (Salmon et al. 2011)
+const uint32_t PhiloxM0 = 0xD2511F53u;
+const uint32_t PhiloxM1 = 0xCD9E8D57u;
+const uint32_t PhiloxW0 = 0x9E3779B9u;
+const uint32_t PhiloxW1 = 0xBB67AE85u;
+const int      PhiloxRounds = 10;
+
+// The batch functions work in groups of 8 blocks, whatever the SIMD width, so every level produces the same layout:
+// in RandomFloats element (group * 32 + word * 8 + lane) is word "word" of block (group * 8 + lane)
+const int GroupBlocks = 8;
+
+// Unit vector polynomial coefficients - Taylor series of sin and cos, accurate to ~1e-9 on [0, pi/2]
+const float HalfPi = 1.57079632679f;
+const float SinC3 = -1.0f / 6.0f,  SinC5 = 1.0f / 120.0f,  SinC7  = -1.0f / 5040.0f,    SinC9  = 1.0f / 362880.0f,
+            SinC11 = -1.0f / 39916800.0f;
+const float CosC2 = -1.0f / 2.0f,  CosC4 = 1.0f / 24.0f,   CosC6  = -1.0f / 720.0f,     CosC8  = 1.0f / 40320.0f,
+            CosC10 = -1.0f / 3628800.0f, CosC12 = 1.0f / 479001600.0f;
+
+
+//--------------------------------------------------------------------------------------
+// Scalar version
+//--------------------------------------------------------------------------------------
+
+// Philox4x32-10: four random 32-bit values for the given 128-bit counter and 64-bit key
+void Philox4x32(const uint32_t counter[4], RandomKey key, uint32_t out[4])
+{
+	uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+	uint32_t k0 = key.id, k1 = key.frame;
+	for (int round = 0; round < PhiloxRounds; ++round)
+	{
+		uint64_t product0 = static_cast<uint64_t>(PhiloxM0) * c0;
+		uint64_t product1 = static_cast<uint64_t>(PhiloxM1) * c2;
+		uint32_t hi0 = static_cast<uint32_t>(product0 >> 32), lo0 = static_cast<uint32_t>(product0);
+		uint32_t hi1 = static_cast<uint32_t>(product1 >> 32), lo1 = static_cast<uint32_t>(product1);
+		c0 = hi1 ^ c1 ^ k0;
+		c1 = lo1;
+		c2 = hi0 ^ c3 ^ k1;
+		c3 = lo0;
+		k0 += PhiloxW0;
+		k1 += PhiloxW1;
+	}
+	out[0] = c0;  out[1] = c1;  out[2] = c2;  out[3] = c3;
+}
+
+
+// Unit vector from two sets of random bits: z uniform in (-1, 1], angle around z from the quadrant (top two bits of
+// angleBits) plus an angle within the quadrant (next 24 bits). Sin and cos are polynomials, not library calls, so the
+// SIMD versions can repeat exactly the same operations
+static void UnitVectorFromBits(uint32_t zBits, uint32_t angleBits, float& x, float& y, float& z)
+{
+	z = 1.0f - 2.0f * (static_cast<float>(zBits >> 8) * (1.0f / 16777216.0f));
+	float r = std::sqrt(1.0f - z * z);
+
+	float angle  = static_cast<float>((angleBits >> 6) & 0xFFFFFFu) * (HalfPi / 16777216.0f);
+	float angle2 = angle * angle;
+	float s = angle * (1.0f + angle2 * (SinC3 + angle2 * (SinC5 + angle2 * (SinC7 + angle2 * (SinC9 + angle2 * SinC11)))));
+	float c = 1.0f + angle2 * (CosC2 + angle2 * (CosC4 + angle2 * (CosC6 + angle2 * (CosC8 + angle2 * (CosC10 + angle2 * CosC12)))));
+
+	// Rotate into the quadrant: 0: (c, s)  1: (-s, c)  2: (-c, -s)  3: (s, -c)
+	uint32_t quadrant = angleBits >> 30;
+	float qx = (quadrant & 1) ? s : c;
+	float qy = (quadrant & 1) ? c : s;
+	if ((quadrant + 1) & 2)  qx = -qx;
+	if (quadrant & 2)        qy = -qy;
+	x = r * qx;
+	y = r * qy;
+}
+
+
+// One group of 8 blocks, written to the group layout described above (used for whole groups and for the tail)
+static void FloatGroupScalar(RandomKey key, uint32_t stream, uint32_t firstBlock, float* group, float a, float b)
+{
+	for (int lane = 0; lane < GroupBlocks; ++lane)
+	{
+		uint32_t counter[4] = { firstBlock + lane, stream, 0, 0 };
+		uint32_t bits[4];
+		Philox4x32(counter, key, bits);
+		for (int word = 0; word < 4; ++word)  group[word * GroupBlocks + lane] = UniformFloat(bits[word], a, b);
+	}
+}
+
+static void UnitVectorGroupScalar(RandomKey key, uint32_t stream, uint32_t firstBlock, float* x, float* y, float* z)
+{
+	for (int lane = 0; lane < GroupBlocks; ++lane)
+	{
+		uint32_t counter[4] = { firstBlock + lane, stream, 0, 0 };
+		uint32_t bits[4];
+		Philox4x32(counter, key, bits);
+		UnitVectorFromBits(bits[0], bits[1], x[lane],               y[lane],               z[lane]);
+		UnitVectorFromBits(bits[2], bits[3], x[GroupBlocks + lane], y[GroupBlocks + lane], z[GroupBlocks + lane]);
+	}
+}
+
+static void Float3PerIdScalar(const uint32_t* ids, uint32_t frame, uint32_t stream,
+                              float* outX, float* outY, float* outZ, int begin, int end, float a, float b)
+{
+	for (int i = begin; i < end; ++i)
+	{
+		uint32_t counter[4] = { 0, stream, 0, 0 };
+		uint32_t bits[4];
+		Philox4x32(counter, { ids[i], frame }, bits);
+		outX[i] = UniformFloat(bits[0], a, b);
+		outY[i] = UniformFloat(bits[1], a, b);
+		outZ[i] = UniformFloat(bits[2], a, b);
+	}
+}
+
+
+#if SIMD_X86_AVAILABLE
+
+//--------------------------------------------------------------------------------------
+// SSE2 version - 4 blocks at a time
+//--------------------------------------------------------------------------------------
+
+// 32x32 -> 64-bit multiply of each lane by m, split into high and low halves. SSE2 only multiplies the even lanes,
+// so the odd lanes are shifted down and multiplied separately
+static inline void MulHiLoSSE2(__m128i a, __m128i m, __m128i& hi, __m128i& lo)
+{
+	const __m128i lowMask = _mm_set_epi32(0, -1, 0, -1);
+	__m128i even = _mm_mul_epu32(a, m);
+	__m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+	lo = _mm_or_si128(_mm_and_si128(even, lowMask), _mm_slli_epi64(odd, 32));
+	hi = _mm_or_si128(_mm_srli_epi64(even, 32), _mm_andnot_si128(lowMask, odd));
+}
+
+static inline void PhiloxSSE2(__m128i& c0, __m128i& c1, __m128i& c2, __m128i& c3, __m128i k0, __m128i k1)
+{
+	const __m128i m0 = _mm_set1_epi32(static_cast<int>(PhiloxM0));
+	const __m128i m1 = _mm_set1_epi32(static_cast<int>(PhiloxM1));
+	const __m128i w0 = _mm_set1_epi32(static_cast<int>(PhiloxW0));
+	const __m128i w1 = _mm_set1_epi32(static_cast<int>(PhiloxW1));
+	for (int round = 0; round < PhiloxRounds; ++round)
+	{
+		__m128i hi0, lo0, hi1, lo1;
+		MulHiLoSSE2(c0, m0, hi0, lo0);
+		MulHiLoSSE2(c2, m1, hi1, lo1);
+		c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), k0);
+		c1 = lo1;
+		c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), k1);
+		c3 = lo0;
+		k0 = _mm_add_epi32(k0, w0);
+		k1 = _mm_add_epi32(k1, w1);
+	}
+}
+
+// Top 24 bits to a float in [0, 1)
+static inline __m128 UnitFloatSSE2(__m128i bits)
+{
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(bits, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+}
+
+static inline __m128 UniformSSE2(__m128i bits, __m128 a, __m128 range)
+{
+	return _mm_add_ps(a, _mm_mul_ps(range, UnitFloatSSE2(bits)));
+}
+
+static inline void UnitVectorSSE2(__m128i zBits, __m128i angleBits, float* x, float* y, float* z)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128 vz = _mm_sub_ps(one, _mm_mul_ps(_mm_set1_ps(2.0f), UnitFloatSSE2(zBits)));
+	__m128 r  = _mm_sqrt_ps(_mm_sub_ps(one, _mm_mul_ps(vz, vz)));
+
+	__m128i angleInt = _mm_and_si128(_mm_srli_epi32(angleBits, 6), _mm_set1_epi32(0xFFFFFF));
+	__m128 angle  = _mm_mul_ps(_mm_cvtepi32_ps(angleInt), _mm_set1_ps(HalfPi / 16777216.0f));
+	__m128 angle2 = _mm_mul_ps(angle, angle);
+	__m128 s = _mm_add_ps(_mm_set1_ps(SinC9), _mm_mul_ps(angle2, _mm_set1_ps(SinC11)));
+	s = _mm_add_ps(_mm_set1_ps(SinC7), _mm_mul_ps(angle2, s));
+	s = _mm_add_ps(_mm_set1_ps(SinC5), _mm_mul_ps(angle2, s));
+	s = _mm_add_ps(_mm_set1_ps(SinC3), _mm_mul_ps(angle2, s));
+	s = _mm_mul_ps(angle, _mm_add_ps(one, _mm_mul_ps(angle2, s)));
+	__m128 c = _mm_add_ps(_mm_set1_ps(CosC10), _mm_mul_ps(angle2, _mm_set1_ps(CosC12)));
+	c = _mm_add_ps(_mm_set1_ps(CosC8), _mm_mul_ps(angle2, c));
+	c = _mm_add_ps(_mm_set1_ps(CosC6), _mm_mul_ps(angle2, c));
+	c = _mm_add_ps(_mm_set1_ps(CosC4), _mm_mul_ps(angle2, c));
+	c = _mm_add_ps(_mm_set1_ps(CosC2), _mm_mul_ps(angle2, c));
+	c = _mm_add_ps(one, _mm_mul_ps(angle2, c));
+
+	__m128i quadrant = _mm_srli_epi32(angleBits, 30);
+	const __m128i bit0 = _mm_set1_epi32(1), bit1 = _mm_set1_epi32(2);
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, bit0), bit0));
+	__m128 negX = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_add_epi32(quadrant, bit0), bit1), bit1));
+	__m128 negY = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, bit1), bit1));
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	__m128 qx = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+	__m128 qy = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+	qx = _mm_xor_ps(qx, _mm_and_ps(negX, signBit));
+	qy = _mm_xor_ps(qy, _mm_and_ps(negY, signBit));
+
+	_mm_storeu_ps(x, _mm_mul_ps(r, qx));
+	_mm_storeu_ps(y, _mm_mul_ps(r, qy));
+	_mm_storeu_ps(z, vz);
+}
+
+static void RandomFloatsSSE2(RandomKey key, uint32_t stream, float* out, int numGroups, float a, float b)
+{
+	const __m128 va = _mm_set1_ps(a), range = _mm_set1_ps(b - a);
+	const __m128i k0 = _mm_set1_epi32(static_cast<int>(key.id)), k1 = _mm_set1_epi32(static_cast<int>(key.frame));
+	for (int group = 0; group < numGroups; ++group)
+	{
+		for (int half = 0; half < GroupBlocks; half += 4)
+		{
+			uint32_t firstBlock = group * GroupBlocks + half;
+			__m128i c0 = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(firstBlock)), _mm_set_epi32(3, 2, 1, 0));
+			__m128i c1 = _mm_set1_epi32(static_cast<int>(stream)), c2 = _mm_setzero_si128(), c3 = _mm_setzero_si128();
+			PhiloxSSE2(c0, c1, c2, c3, k0, k1);
+
+			float* groupOut = out + group * GroupBlocks * 4 + half;
+			_mm_storeu_ps(groupOut + 0 * GroupBlocks, UniformSSE2(c0, va, range));
+			_mm_storeu_ps(groupOut + 1 * GroupBlocks, UniformSSE2(c1, va, range));
+			_mm_storeu_ps(groupOut + 2 * GroupBlocks, UniformSSE2(c2, va, range));
+			_mm_storeu_ps(groupOut + 3 * GroupBlocks, UniformSSE2(c3, va, range));
+		}
+	}
+}
+
+static void RandomUnitVectorsSSE2(RandomKey key, uint32_t stream, float* x, float* y, float* z, int numGroups)
+{
+	const __m128i k0 = _mm_set1_epi32(static_cast<int>(key.id)), k1 = _mm_set1_epi32(static_cast<int>(key.frame));
+	for (int group = 0; group < numGroups; ++group)
+	{
+		for (int half = 0; half < GroupBlocks; half += 4)
+		{
+			uint32_t firstBlock = group * GroupBlocks + half;
+			__m128i c0 = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(firstBlock)), _mm_set_epi32(3, 2, 1, 0));
+			__m128i c1 = _mm_set1_epi32(static_cast<int>(stream)), c2 = _mm_setzero_si128(), c3 = _mm_setzero_si128();
+			PhiloxSSE2(c0, c1, c2, c3, k0, k1);
+
+			int v = group * GroupBlocks * 2 + half;
+			UnitVectorSSE2(c0, c1, x + v, y + v, z + v);
+			v += GroupBlocks;
+			UnitVectorSSE2(c2, c3, x + v, y + v, z + v);
+		}
+	}
+}
+
+static int RandomFloat3PerIdSSE2(const uint32_t* ids, uint32_t frame, uint32_t stream,
+                                 float* outX, float* outY, float* outZ, int count, float a, float b)
+{
+	const __m128 va = _mm_set1_ps(a), range = _mm_set1_ps(b - a);
+	const __m128i k1 = _mm_set1_epi32(static_cast<int>(frame));
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i c0 = _mm_setzero_si128(), c1 = _mm_set1_epi32(static_cast<int>(stream));
+		__m128i c2 = _mm_setzero_si128(), c3 = _mm_setzero_si128();
+		PhiloxSSE2(c0, c1, c2, c3, _mm_loadu_si128(reinterpret_cast<const __m128i*>(ids + i)), k1);
+		_mm_storeu_ps(outX + i, UniformSSE2(c0, va, range));
+		_mm_storeu_ps(outY + i, UniformSSE2(c1, va, range));
+		_mm_storeu_ps(outZ + i, UniformSSE2(c2, va, range));
+	}
+	return i;
+}
+
+
+//--------------------------------------------------------------------------------------
+// AVX2 version - 8 blocks at a time
+//--------------------------------------------------------------------------------------
+
+SIMD_TARGET_AVX2 static inline void MulHiLoAVX2(__m256i a, __m256i m, __m256i& hi, __m256i& lo)
+{
+	const __m256i lowMask = _mm256_set1_epi64x(0xFFFFFFFFll);
+	__m256i even = _mm256_mul_epu32(a, m);
+	__m256i odd  = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+	lo = _mm256_or_si256(_mm256_and_si256(even, lowMask), _mm256_slli_epi64(odd, 32));
+	hi = _mm256_or_si256(_mm256_srli_epi64(even, 32), _mm256_andnot_si256(lowMask, odd));
+}
+
+SIMD_TARGET_AVX2 static inline void PhiloxAVX2(__m256i& c0, __m256i& c1, __m256i& c2, __m256i& c3, __m256i k0, __m256i k1)
+{
+	const __m256i m0 = _mm256_set1_epi32(static_cast<int>(PhiloxM0));
+	const __m256i m1 = _mm256_set1_epi32(static_cast<int>(PhiloxM1));
+	const __m256i w0 = _mm256_set1_epi32(static_cast<int>(PhiloxW0));
+	const __m256i w1 = _mm256_set1_epi32(static_cast<int>(PhiloxW1));
+	for (int round = 0; round < PhiloxRounds; ++round)
+	{
+		__m256i hi0, lo0, hi1, lo1;
+		MulHiLoAVX2(c0, m0, hi0, lo0);
+		MulHiLoAVX2(c2, m1, hi1, lo1);
+		c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), k0);
+		c1 = lo1;
+		c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), k1);
+		c3 = lo0;
+		k0 = _mm256_add_epi32(k0, w0);
+		k1 = _mm256_add_epi32(k1, w1);
+	}
+}
+
+SIMD_TARGET_AVX2 static inline __m256 UnitFloatAVX2(__m256i bits)
+{
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(bits, 8)), _mm256_set1_ps(1.0f / 16777216.0f));
+}
+
+SIMD_TARGET_AVX2 static inline __m256 UniformAVX2(__m256i bits, __m256 a, __m256 range)
+{
+	return _mm256_add_ps(a, _mm256_mul_ps(range, UnitFloatAVX2(bits)));
+}
+
+SIMD_TARGET_AVX2 static inline void UnitVectorAVX2(__m256i zBits, __m256i angleBits, float* x, float* y, float* z)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	__m256 vz = _mm256_sub_ps(one, _mm256_mul_ps(_mm256_set1_ps(2.0f), UnitFloatAVX2(zBits)));
+	__m256 r  = _mm256_sqrt_ps(_mm256_sub_ps(one, _mm256_mul_ps(vz, vz)));
+
+	__m256i angleInt = _mm256_and_si256(_mm256_srli_epi32(angleBits, 6), _mm256_set1_epi32(0xFFFFFF));
+	__m256 angle  = _mm256_mul_ps(_mm256_cvtepi32_ps(angleInt), _mm256_set1_ps(HalfPi / 16777216.0f));
+	__m256 angle2 = _mm256_mul_ps(angle, angle);
+	__m256 s = _mm256_add_ps(_mm256_set1_ps(SinC9), _mm256_mul_ps(angle2, _mm256_set1_ps(SinC11)));
+	s = _mm256_add_ps(_mm256_set1_ps(SinC7), _mm256_mul_ps(angle2, s));
+	s = _mm256_add_ps(_mm256_set1_ps(SinC5), _mm256_mul_ps(angle2, s));
+	s = _mm256_add_ps(_mm256_set1_ps(SinC3), _mm256_mul_ps(angle2, s));
+	s = _mm256_mul_ps(angle, _mm256_add_ps(one, _mm256_mul_ps(angle2, s)));
+	__m256 c = _mm256_add_ps(_mm256_set1_ps(CosC10), _mm256_mul_ps(angle2, _mm256_set1_ps(CosC12)));
+	c = _mm256_add_ps(_mm256_set1_ps(CosC8), _mm256_mul_ps(angle2, c));
+	c = _mm256_add_ps(_mm256_set1_ps(CosC6), _mm256_mul_ps(angle2, c));
+	c = _mm256_add_ps(_mm256_set1_ps(CosC4), _mm256_mul_ps(angle2, c));
+	c = _mm256_add_ps(_mm256_set1_ps(CosC2), _mm256_mul_ps(angle2, c));
+	c = _mm256_add_ps(one, _mm256_mul_ps(angle2, c));
+
+	__m256i quadrant = _mm256_srli_epi32(angleBits, 30);
+	const __m256i bit0 = _mm256_set1_epi32(1), bit1 = _mm256_set1_epi32(2);
+	__m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, bit0), bit0));
+	__m256 negX = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, bit0), bit1), bit1));
+	__m256 negY = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, bit1), bit1));
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+	__m256 qx = _mm256_blendv_ps(c, s, swap);
+	__m256 qy = _mm256_blendv_ps(s, c, swap);
+	qx = _mm256_xor_ps(qx, _mm256_and_ps(negX, signBit));
+	qy = _mm256_xor_ps(qy, _mm256_and_ps(negY, signBit));
+
+	_mm256_storeu_ps(x, _mm256_mul_ps(r, qx));
+	_mm256_storeu_ps(y, _mm256_mul_ps(r, qy));
+	_mm256_storeu_ps(z, vz);
+}
+
+SIMD_TARGET_AVX2 static void RandomFloatsAVX2(RandomKey key, uint32_t stream, float* out, int numGroups, float a, float b)
+{
+	const __m256 va = _mm256_set1_ps(a), range = _mm256_set1_ps(b - a);
+	const __m256i k0 = _mm256_set1_epi32(static_cast<int>(key.id)), k1 = _mm256_set1_epi32(static_cast<int>(key.frame));
+	const __m256i laneIndex = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+	for (int group = 0; group < numGroups; ++group)
+	{
+		__m256i c0 = _mm256_add_epi32(_mm256_set1_epi32(group * GroupBlocks), laneIndex);
+		__m256i c1 = _mm256_set1_epi32(static_cast<int>(stream)), c2 = _mm256_setzero_si256(), c3 = _mm256_setzero_si256();
+		PhiloxAVX2(c0, c1, c2, c3, k0, k1);
+
+		float* groupOut = out + group * GroupBlocks * 4;
+		_mm256_storeu_ps(groupOut + 0 * GroupBlocks, UniformAVX2(c0, va, range));
+		_mm256_storeu_ps(groupOut + 1 * GroupBlocks, UniformAVX2(c1, va, range));
+		_mm256_storeu_ps(groupOut + 2 * GroupBlocks, UniformAVX2(c2, va, range));
+		_mm256_storeu_ps(groupOut + 3 * GroupBlocks, UniformAVX2(c3, va, range));
+	}
+}
+
+SIMD_TARGET_AVX2 static void RandomUnitVectorsAVX2(RandomKey key, uint32_t stream, float* x, float* y, float* z, int numGroups)
+{
+	const __m256i k0 = _mm256_set1_epi32(static_cast<int>(key.id)), k1 = _mm256_set1_epi32(static_cast<int>(key.frame));
+	const __m256i laneIndex = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+	for (int group = 0; group < numGroups; ++group)
+	{
+		__m256i c0 = _mm256_add_epi32(_mm256_set1_epi32(group * GroupBlocks), laneIndex);
+		__m256i c1 = _mm256_set1_epi32(static_cast<int>(stream)), c2 = _mm256_setzero_si256(), c3 = _mm256_setzero_si256();
+		PhiloxAVX2(c0, c1, c2, c3, k0, k1);
+
+		int v = group * GroupBlocks * 2;
+		UnitVectorAVX2(c0, c1, x + v, y + v, z + v);
+		v += GroupBlocks;
+		UnitVectorAVX2(c2, c3, x + v, y + v, z + v);
+	}
+}
+
+SIMD_TARGET_AVX2 static int RandomFloat3PerIdAVX2(const uint32_t* ids, uint32_t frame, uint32_t stream,
+                                                  float* outX, float* outY, float* outZ, int count, float a, float b)
+{
+	const __m256 va = _mm256_set1_ps(a), range = _mm256_set1_ps(b - a);
+	const __m256i k1 = _mm256_set1_epi32(static_cast<int>(frame));
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i c0 = _mm256_setzero_si256(), c1 = _mm256_set1_epi32(static_cast<int>(stream));
+		__m256i c2 = _mm256_setzero_si256(), c3 = _mm256_setzero_si256();
+		PhiloxAVX2(c0, c1, c2, c3, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ids + i)), k1);
+		_mm256_storeu_ps(outX + i, UniformAVX2(c0, va, range));
+		_mm256_storeu_ps(outY + i, UniformAVX2(c1, va, range));
+		_mm256_storeu_ps(outZ + i, UniformAVX2(c2, va, range));
+	}
+	return i;
+}
+
+#endif // SIMD_X86_AVAILABLE
+
+
+//--------------------------------------------------------------------------------------
+// Dispatch
+//--------------------------------------------------------------------------------------
+
+static SimdLevel gRandomLevel = DetectSimdLevel();
+
+SimdLevel RandomKernelLevel()
+{
+	return gRandomLevel;
+}
+
+void SetRandomKernelLevel(SimdLevel level)
+{
+	SimdLevel supported = DetectSimdLevel();
+	gRandomLevel = level > supported ? supported : level;
+}
+
+
+// Fill out[0, count) with uniform floats in [a, b) for the given key and stream
+void RandomFloats(RandomKey key, uint32_t stream, float* out, int count, float a, float b)
+{
+	const int groupSize = GroupBlocks * 4;
+	int numGroups = count / groupSize;
+
+	int group = 0;
+#if SIMD_X86_AVAILABLE
+	if      (gRandomLevel == SimdLevel::AVX2)  { RandomFloatsAVX2(key, stream, out, numGroups, a, b);  group = numGroups; }
+	else if (gRandomLevel == SimdLevel::SSE2)  { RandomFloatsSSE2(key, stream, out, numGroups, a, b);  group = numGroups; }
+#endif
+	for (; group < numGroups; ++group)  FloatGroupScalar(key, stream, group * GroupBlocks, out + group * groupSize, a, b);
+
+	// Partial last group
+	int remaining = count - numGroups * groupSize;
+	if (remaining > 0)
+	{
+		float last[GroupBlocks * 4];
+		FloatGroupScalar(key, stream, numGroups * GroupBlocks, last, a, b);
+		for (int i = 0; i < remaining; ++i)  out[numGroups * groupSize + i] = last[i];
+	}
+}
+
+
+// Fill x/y/z[0, count) with unit vectors evenly distributed over the sphere
+void RandomUnitVectors(RandomKey key, uint32_t stream, float* x, float* y, float* z, int count)
+{
+	const int groupSize = GroupBlocks * 2;
+	int numGroups = count / groupSize;
+
+	int group = 0;
+#if SIMD_X86_AVAILABLE
+	if      (gRandomLevel == SimdLevel::AVX2)  { RandomUnitVectorsAVX2(key, stream, x, y, z, numGroups);  group = numGroups; }
+	else if (gRandomLevel == SimdLevel::SSE2)  { RandomUnitVectorsSSE2(key, stream, x, y, z, numGroups);  group = numGroups; }
+#endif
+	for (; group < numGroups; ++group)
+	{
+		int v = group * groupSize;
+		UnitVectorGroupScalar(key, stream, group * GroupBlocks, x + v, y + v, z + v);
+	}
+
+	int remaining = count - numGroups * groupSize;
+	if (remaining > 0)
+	{
+		float lastX[GroupBlocks * 2], lastY[GroupBlocks * 2], lastZ[GroupBlocks * 2];
+		UnitVectorGroupScalar(key, stream, numGroups * GroupBlocks, lastX, lastY, lastZ);
+		int v = numGroups * groupSize;
+		for (int i = 0; i < remaining; ++i)
+		{
+			x[v + i] = lastX[i];  y[v + i] = lastY[i];  z[v + i] = lastZ[i];
+		}
+	}
+}
+
+
+// One key per element: for each i, three uniform floats in [a, b) from the key {ids[i], frame}
+void RandomFloat3PerId(const uint32_t* ids, uint32_t frame, uint32_t stream,
+                       float* outX, float* outY, float* outZ, int count, float a, float b)
+{
+	int i = 0;
+#if SIMD_X86_AVAILABLE
+	if      (gRandomLevel == SimdLevel::AVX2)  i = RandomFloat3PerIdAVX2(ids, frame, stream, outX, outY, outZ, count, a, b);
+	else if (gRandomLevel == SimdLevel::SSE2)  i = RandomFloat3PerIdSSE2(ids, frame, stream, outX, outY, outZ, count, a, b);
+#endif
+	Float3PerIdScalar(ids, frame, stream, outX, outY, outZ, i, count, a, b);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Scalar stream
+//--------------------------------------------------------------------------------------
+
+uint32_t RandomStream::NextBits()
+{
+	if (mUsed == 4)
+	{
+		uint32_t counter[4] = { mBlock++, mStream, 0, 0 };
+		Philox4x32(counter, mKey, mBits);
+		mUsed = 0;
+	}
+	return mBits[mUsed++];
+}
+
+void RandomStream::NextUnitVector(float& x, float& y, float& z)
+{
+	uint32_t zBits = NextBits();
+	UnitVectorFromBits(zBits, NextBits(), x, y, z);
+}
+
+
+static thread_local RandomStream gDefaultRandom({ 0x5EED5EEDu, 0 });
+
+RandomStream& DefaultRandomStream()
+{
+	return gDefaultRandom;
+}
+
+void SeedDefaultRandom(uint32_t seed)
+{
+	gDefaultRandom = RandomStream({ seed, 0 });
+}
@@ -0,0 +1,99 @@
+//--------------------------------------------------------------------------------------
+// Counter-based random numbers (Philox4x32-10)
+//--------------------------------------------------------------------------------------
+// A counter-based generator has no state: the random bits are a function of a key and a
+// counter, value = Philox(key, counter). Keying by particle id and frame number means every
+// particle gets its own random numbers each frame whichever thread or chunk it is updated
+// in, so results are the same on 1 thread or 32, and no state is shared between threads.
+// The batched functions generate 4 (SSE2) or 8 (AVX2) blocks at once and give exactly the
+// same numbers at every SIMD level
+// Code in .cpp file
+
+#ifndef _COUNTER_RANDOM_H_INCLUDED_
+#define _COUNTER_RANDOM_H_INCLUDED_
+
+#include "CpuFeatures.h"
+
+#include <stdint.h>
+
+
+// Key for a random sequence, typically a particle id and a frame number
+struct RandomKey
+{
+	uint32_t id;
+	uint32_t frame;
+};
+
+
+// Philox4x32-10: four random 32-bit values for the given 128-bit counter and 64-bit key
+void Philox4x32(const uint32_t counter[4], RandomKey key, uint32_t out[4]);
+
+// Convert 32 random bits to a float in the range [a, b). Uses the top 24 bits, the most a float can hold
+inline float UniformFloat(uint32_t bits, float a, float b)
+{
+	return a + (b - a) * (static_cast<float>(bits >> 8) * (1.0f / 16777216.0f));
+}
+
+
+//--------------------------------------------------------------------------------------
+// Scalar stream
+//--------------------------------------------------------------------------------------
+// Sequential random numbers for one key, for code that needs a few values at a time. Uses counter
+// words {block, stream, 0, 0}, so different stream numbers give independent sequences for the same key
+class RandomStream
+{
+public:
+	RandomStream(RandomKey key, uint32_t stream = 0) : mKey(key), mStream(stream), mBlock(0), mUsed(4) {}
+
+	// Next 32 random bits
+	uint32_t NextBits();
+
+	// Random float in the range [a, b)
+	float Next(float a, float b) { return UniformFloat(NextBits(), a, b); }
+
+	// Random integer from a to b (inclusive)
+	int NextInt(int a, int b) { return a + static_cast<int>((static_cast<uint64_t>(NextBits()) * static_cast<uint32_t>(b - a + 1)) >> 32); }
+
+	// Random unit vector, evenly distributed over the sphere
+	void NextUnitVector(float& x, float& y, float& z);
+
+private:
+	RandomKey mKey;
+	uint32_t  mStream;
+	uint32_t  mBlock;   // Counter - the next block to generate
+	uint32_t  mBits[4]; // Current block
+	int       mUsed;    // Number of values of the current block already returned
+};
+
+// Random stream for code with no key of its own (e.g. UI launches). One per thread, all threads start from the same seed
+RandomStream& DefaultRandomStream();
+
+// Restart the calling thread's default stream from the given seed
+void SeedDefaultRandom(uint32_t seed);
+
+
+//--------------------------------------------------------------------------------------
+// Batched generation
+//--------------------------------------------------------------------------------------
+// Each batch function is its own sequence (it does not follow on from a RandomStream with the same key and stream)
+
+// Fill out[0, count) with uniform floats in [a, b) for the given key and stream
+void RandomFloats(RandomKey key, uint32_t stream, float* out, int count, float a, float b);
+
+// Fill x/y/z[0, count) with unit vectors evenly distributed over the sphere, for the given key and stream
+void RandomUnitVectors(RandomKey key, uint32_t stream, float* x, float* y, float* z, int count);
+
+// One key per element: for each i, three uniform floats in [a, b) from the key {ids[i], frame}. Used to give many
+// particles their own random values in one call
+void RandomFloat3PerId(const uint32_t* ids, uint32_t frame, uint32_t stream,
+                       float* outX, float* outY, float* outZ, int count, float a, float b);
+
+
+// SIMD level used by the batch functions. Defaults to the best the CPU supports
+SimdLevel RandomKernelLevel();
+
+// Override the SIMD level (e.g. to compare against the scalar version). Levels above what the CPU supports are clamped
+void SetRandomKernelLevel(SimdLevel level);
+
+
+#endif //_COUNTER_RANDOM_H_INCLUDED_
@@ -7,6 +7,7 @@
 
 #include <cmath>
 #include <stdint.h>
+#include "CounterRandom.h"
 #include <CVector3.h>
 
 
@@ -46,32 +47,40 @@ inline float ToDegrees(float r)
 
 
 // Return random integer from a to b (inclusive)
-// Can only return up to RAND_MAX different values, spread evenly across the given range
-// RAND_MAX is defined in stdlib.h and is compiler-specific (32767 on VS-2005, higher elsewhere)
+// Uses the calling thread's default counter-based random stream (see CounterRandom.h) rather than rand(), which is slow,
+// has only 15 bits on Visual Studio, and is not thread-safe. Code that must be repeatable should use its own RandomStream
 inline uint32_t Random(const int a, const int b)
 {
-	// Could just use a + rand() % (b-a), but using a more complex form to allow range
-	// to exceed RAND_MAX and still return values spread across the range
-	uint32_t t = (b - a + 1) * rand();
-	return t == 0 ? a : a + (t - 1) / RAND_MAX;
+	return static_cast<uint32_t>(DefaultRandomStream().NextInt(a, b));
 }
 
-// Return random 32-bit float from a to b (inclusive)
-// Can only return up to RAND_MAX different values, spread evenly across the given range
-// RAND_MAX is defined in stdlib.h and is compiler-specific (32767 on VS-2005, higher elsewhere)
+// Return random 32-bit float from a to b
 inline float Random(const float a, const float b)
 {
-	return a + (b - a) * (static_cast<float>(rand()) / RAND_MAX);
+	return DefaultRandomStream().Next(a, b);
 }
 
-// Return random 64-bit float from a to b (inclusive)
-// Can only return up to RAND_MAX different values, spread evenly across the given range
-// RAND_MAX is defined in stdlib.h and is compiler-specific (32767 on VS-2005, higher elsewhere)
+// Return random 64-bit float from a to b
 inline double Random(const double a, const double b)
 {
-	return a + (b - a) * (static_cast<double>(rand()) / RAND_MAX);
+	// Two draws give 53 bits, the full precision of a double
+	RandomStream& stream = DefaultRandomStream();
+	uint64_t high = stream.NextBits() >> 6;  // 26 bits
+	uint64_t low  = stream.NextBits() >> 5;  // 27 bits
+	return a + (b - a) * (static_cast<double>((high << 27) | low) / 9007199254740992.0);
 }
 
 
 
+// Mix two values into a well distributed 32-bit value, e.g. to make the id of a spawned particle from its parent's id
+inline uint32_t HashSeed(uint32_t a, uint32_t b)
+{
+	uint32_t h = a * 0x9E3779B1u ^ (b + 0x7F4A7C15u + (a << 6) + (a >> 2));
+	h ^= h >> 16;  h *= 0x85EBCA6Bu;
+	h ^= h >> 13;  h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+	return h;
+}
+
+
 #endif // _MATH_HELPERS_H_DEFINED_
@@ -0,0 +1,58 @@
+//--------------------------------------------------------------------------------------
+// Adaptive particle budget - lowers emission quality when the fireworks cost too much
+//--------------------------------------------------------------------------------------
+
+#include "BudgetGovernor.h"
+
+
+const std::vector<QualityTier>& DefaultQualityTiers()
+{
+	//                                               trail rate, burst scale
+	static const std::vector<QualityTier> tiers = { { "Full",    { 1.0f,  1.0f } },
+	                                                { "High",    { 0.6f,  1.0f } },
+	                                                { "Medium",  { 0.3f,  1.0f } },
+	                                                { "Low",     { 0.1f,  0.7f } },
+	                                                { "Minimum", { 0.0f,  0.4f } } };
+	return tiers;
+}
+
+
+BudgetGovernor::BudgetGovernor(float targetMs, const std::vector<QualityTier>& tiers)
+	: mTiers(tiers), mTargetMs(targetMs)
+{
+}
+
+
+void BudgetGovernor::SetEnabled(bool enabled)
+{
+	mEnabled = enabled;
+	if (!mEnabled)
+	{
+		mTier = 0;
+		mFramesOver = mFramesUnder = 0;
+	}
+}
+
+
+// Report the measured firework cost of the last frame
+void BudgetGovernor::AddFrame(float costMs)
+{
+	mAverageMs += (costMs - mAverageMs) * Smoothing;
+	if (!mEnabled)  return;
+
+	// Count how long the cost has been over budget, or comfortably under it
+	mFramesOver  = mAverageMs > mTargetMs                 ? mFramesOver  + 1 : 0;
+	mFramesUnder = mAverageMs < mTargetMs * RaiseFraction ? mFramesUnder + 1 : 0;
+
+	// Drop quickly, climb back slowly
+	if (mFramesOver >= FramesToLower && mTier + 1 < NumTiers())
+	{
+		++mTier;
+		mFramesOver = 0;
+	}
+	else if (mFramesUnder >= FramesToRaise && mTier > 0)
+	{
+		--mTier;
+		mFramesUnder = 0;
+	}
+}
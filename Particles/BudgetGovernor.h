@@ -0,0 +1,88 @@
+//--------------------------------------------------------------------------------------
+// Adaptive particle budget - lowers emission quality when the fireworks cost too much
+//--------------------------------------------------------------------------------------
+// Each frame the measured cost of the fireworks (simulation steps plus vertex upload) is
+// compared against a target. When the cost stays over the target the governor drops to
+// a lower quality tier, which emits fewer cosmetic particles, and when there is plenty
+// of headroom again it climbs back. Tiers thin out trails first and only shrink bursts
+// at the lowest levels - rockets are never affected, so a heavy finale slows the trails
+// down rather than losing fireworks
+// Code in .cpp file
+
+#ifndef _BUDGET_GOVERNOR_H_INCLUDED_
+#define _BUDGET_GOVERNOR_H_INCLUDED_
+
+#include "FireworkSimulation.h"
+
+#include <vector>
+
+
+// A named level of emission quality, see EmissionQuality in FireworkSimulation.h
+struct QualityTier
+{
+	const char*     name;
+	EmissionQuality quality;
+};
+
+// Default tiers from best to worst: trails are reduced first, bursts only in the last two tiers
+const std::vector<QualityTier>& DefaultQualityTiers();
+
+
+class BudgetGovernor
+{
+public:
+	// Construction //
+
+	// Keep the measured cost under targetMs per frame using the given tiers, ordered from best to worst quality
+	BudgetGovernor(float targetMs = 4.0f, const std::vector<QualityTier>& tiers = DefaultQualityTiers());
+
+
+	// Settings //
+
+	void  SetTargetMs(float targetMs) { mTargetMs = targetMs; }
+	float TargetMs() const            { return mTargetMs; }
+
+	// Turn the governor off to always use the best tier (e.g. for deterministic recordings and replays)
+	void SetEnabled(bool enabled);
+	bool Enabled() const { return mEnabled; }
+
+
+	// Usage //
+
+	// Report the measured firework cost of the last frame. May change the current tier
+	void AddFrame(float costMs);
+
+	// Current tier (0 is the best) and its settings. Pass Quality() to FireworkSimulation::SetEmissionQuality each frame
+	int                    Tier()      const { return mTier; }
+	int                    NumTiers()  const { return static_cast<int>(mTiers.size()); }
+	const char*            TierName()  const { return mTiers[mTier].name; }
+	const EmissionQuality& Quality()   const { return mTiers[mTier].quality; }
+
+	// Smoothed cost the decisions are based on
+	float AverageCostMs() const { return mAverageMs; }
+
+
+private:
+	// The cost must be over the target for this many frames in a row to drop a tier. Ignores single slow frames, and
+	// gives particles emitted at the old tier time to start dying before dropping again
+	static const int FramesToLower = 10;
+
+	// The cost must be under RaiseFraction of the target for this many frames in a row to climb a tier, so the quality
+	// does not flip back and forth between two tiers that are either side of the target
+	static const int FramesToRaise = 60;
+	static constexpr float RaiseFraction = 0.6f;
+
+	// Weight of the newest frame in the smoothed cost
+	static constexpr float Smoothing = 0.25f;
+
+	std::vector<QualityTier> mTiers;
+	float mTargetMs;
+	bool  mEnabled = true;
+	int   mTier = 0;
+	float mAverageMs = 0;
+	int   mFramesOver = 0;
+	int   mFramesUnder = 0;
+};
+
+
+#endif //_BUDGET_GOVERNOR_H_INCLUDED_
@@ -0,0 +1,233 @@
+//--------------------------------------------------------------------------------------
+// Burst instancing - the stars of a burst kept as one record and a shared offset table
+//--------------------------------------------------------------------------------------
+
+#include "BurstInstances.h"
+#include "ParticleMotion.h"
+#include "ParticleKernels.h"
+#include "CounterRandom.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+BurstInstance MakeBurstInstance(const CVector3& position, const CVector3& velocity, const ColourRGBA& colour, float scale,
+                                float spread, float life, int numStars, uint32_t rocketId)
+{
+	// Mix the id so that rockets with similar ids use different tables and entries
+	uint32_t hash = rocketId * 0x9E3779B1u;
+	hash ^= hash >> 15;
+
+	BurstInstance burst;
+	burst.position    = position;
+	burst.velocity    = velocity;
+	burst.colour      = colour;
+	burst.scale       = scale;
+	burst.spread      = spread;
+	burst.life        = life;
+	burst.numStars    = numStars;
+	burst.numSteps    = 0;
+	burst.table       = static_cast<int>(hash % NumBurstTables);
+	burst.firstOffset = static_cast<int>((hash / NumBurstTables) % BurstTableSize);
+	return burst;
+}
+
+
+BurstInstances::BurstInstances()
+	: mScratch(BurstTableSize)
+{
+	// Each table has its own random sequence, keyed by the entry and the table
+	const int numOffsets = NumBurstTables * BurstTableSize;
+	mOffsetX.resize(numOffsets);
+	mOffsetY.resize(numOffsets);
+	mOffsetZ.resize(numOffsets);
+	std::vector<uint32_t> entries(BurstTableSize);
+	for (int i = 0; i < BurstTableSize; ++i)  entries[i] = static_cast<uint32_t>(i);
+	for (int table = 0; table < NumBurstTables; ++table)
+	{
+		int first = table * BurstTableSize;
+		RandomFloat3PerId(entries.data(), static_cast<uint32_t>(table), 0, mOffsetX.data() + first, mOffsetY.data() + first,
+		                  mOffsetZ.data() + first, BurstTableSize, -1.0f, 1.0f);
+	}
+	mVisible.resize(BurstTableSize);
+}
+
+
+void BurstInstances::Add(const BurstInstance& burst)
+{
+	mBursts.push_back(burst);
+	mNumStars += burst.numStars;
+}
+
+
+int BurstInstances::Step(float stepTime, float gravity)
+{
+	mStepTime = stepTime;
+	mGravity  = gravity;
+
+	// Stars die when a step takes their life to 0 or below, as for particles
+	int numRemoved = 0;
+	for (auto& burst : mBursts)
+	{
+		++burst.numSteps;
+		if (burst.life - burst.numSteps * stepTime <= 0)  numRemoved += burst.numStars;
+	}
+	if (numRemoved > 0)
+	{
+		mBursts.erase(std::remove_if(mBursts.begin(), mBursts.end(), [&](const BurstInstance& burst)
+		{
+			return burst.life - burst.numSteps * stepTime <= 0;
+		}), mBursts.end());
+		mNumStars -= numRemoved;
+	}
+	return numRemoved;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Rendering
+//--------------------------------------------------------------------------------------
+
+// The centre moves like a star with the rocket's velocity, and a star with offset o is o * move further on, at the
+// current and previous step (the previous position is the spawn position for a new burst)
+BurstInstances::BurstFrame BurstInstances::Frame(const BurstInstance& burst, float interpolation) const
+{
+	float age     = burst.numSteps * mStepTime;
+	float prevAge = burst.numSteps > 0 ? age - mStepTime : 0.0f;
+	MotionCoefficients c    = MotionOverAge(age,     mStepTime, mGravity, StarDragBase);
+	MotionCoefficients prev = MotionOverAge(prevAge, mStepTime, mGravity, StarDragBase);
+	float move        = prev.move        + (c.move        - prev.move)        * interpolation;
+	float gravityMove = prev.gravityMove + (c.gravityMove - prev.gravityMove) * interpolation;
+
+	BurstFrame frame;
+	frame.centreX    = burst.position.x + burst.velocity.x * move;
+	frame.centreY    = burst.position.y + burst.velocity.y * move + gravityMove;
+	frame.centreZ    = burst.position.z + burst.velocity.z * move;
+	frame.offsetMove = burst.spread * move;
+	frame.scale      = burst.scale    - StarShrinkRate * age;
+	frame.alpha      = burst.colour.a - StarFadeRate   * age;
+	return frame;
+}
+
+
+void BurstInstances::ExpandStars(const BurstInstance& burst, const BurstFrame& frame, const ParticleSpan& stars) const
+{
+	// The run of table entries wraps round the end of the table, so it is done in up to two pieces
+	const int tableStart = burst.table * BurstTableSize;
+	for (int star = 0; star < burst.numStars; )
+	{
+		int entry = (burst.firstOffset + star) % BurstTableSize;
+		int count = std::min(burst.numStars - star, BurstTableSize - entry);
+		const float* offsetX = mOffsetX.data() + tableStart + entry;
+		const float* offsetY = mOffsetY.data() + tableStart + entry;
+		const float* offsetZ = mOffsetZ.data() + tableStart + entry;
+		for (int i = 0; i < count; ++i)
+		{
+			stars.posX[star + i] = stars.prevX[star + i] = frame.centreX + offsetX[i] * frame.offsetMove;
+			stars.posY[star + i] = stars.prevY[star + i] = frame.centreY + offsetY[i] * frame.offsetMove;
+			stars.posZ[star + i] = stars.prevZ[star + i] = frame.centreZ + offsetZ[i] * frame.offsetMove;
+		}
+		star += count;
+	}
+	for (int i = 0; i < burst.numStars; ++i)
+	{
+		stars.scale[i]    = frame.scale;
+		stars.colourR[i]  = burst.colour.r;
+		stars.colourG[i]  = burst.colour.g;
+		stars.colourB[i]  = burst.colour.b;
+		stars.colourA[i]  = frame.alpha;
+		stars.rotation[i] = 0;
+		stars.type[i]     = static_cast<uint8_t>(FireworkType::StarSimple);
+	}
+}
+
+
+template <class F>
+void BurstInstances::ForEachStarVertex(float interpolation, F&& write) const
+{
+	int numWritten = 0;
+	for (const auto& burst : mBursts)
+	{
+		BurstFrame frame = Frame(burst, interpolation);
+		const int tableStart = burst.table * BurstTableSize;
+		for (int star = 0; star < burst.numStars; ++star)
+		{
+			int entry = tableStart + (burst.firstOffset + star) % BurstTableSize;
+			Firework vertex;
+			vertex.position.x = frame.centreX + mOffsetX[entry] * frame.offsetMove;
+			vertex.position.y = frame.centreY + mOffsetY[entry] * frame.offsetMove;
+			vertex.position.z = frame.centreZ + mOffsetZ[entry] * frame.offsetMove;
+			vertex.scale      = frame.scale;
+			vertex.colour     = { burst.colour.r, burst.colour.g, burst.colour.b, frame.alpha };
+			vertex.rotation   = 0;
+			write(numWritten++, vertex);
+		}
+	}
+}
+
+
+void BurstInstances::GatherVertices(Firework* vertices, float interpolation)
+{
+	ForEachStarVertex(interpolation, [&](int i, const Firework& vertex) { vertices[i] = vertex; });
+}
+
+void BurstInstances::GatherVertices(const PackedVertexSpan& vertices, float interpolation)
+{
+	ForEachStarVertex(interpolation, [&](int i, const Firework& vertex)
+	{
+		vertices.vertices[i] = PackFirework(vertex, vertices.origin);
+	});
+}
+
+
+template <class F>
+void BurstInstances::ForEachVisibleBurst(float interpolation, const CullView& view, CullCounts& counts, F&& gather)
+{
+	for (const auto& burst : mBursts)
+	{
+		// Test the sphere round the whole burst first: offsets are up to spread in each axis, so within sqrt(3) * spread
+		BurstFrame frame = Frame(burst, interpolation);
+		float radius = 1.7320508f * std::fabs(frame.offsetMove) + QuadRadius * std::fabs(frame.scale);
+		bool outside = false;
+		for (const auto& plane : view.planes)
+		{
+			outside |= plane[0] * frame.centreX + plane[1] * frame.centreY + plane[2] * frame.centreZ + plane[3] < -radius;
+		}
+		if (outside || frame.alpha <= 0)
+		{
+			counts.numTested  += burst.numStars;
+			counts.numOutside += outside ? burst.numStars : 0;
+			counts.numFaded   += outside ? 0 : burst.numStars;
+			continue;
+		}
+
+		// Otherwise work out the stars and cull them one by one like particles. They are written already interpolated
+		mScratch.Clear();
+		mScratch.AddRange(burst.numStars);
+		ParticleSpan stars = mScratch.Span();
+		ExpandStars(burst, frame, stars);
+		if (BuildVisibleMask(stars, 1.0f, view, mVisible.data(), counts) == 0)  continue;
+		gather(stars, mVisible.data());
+	}
+}
+
+
+int BurstInstances::GatherVisibleVertices(Firework* vertices, float interpolation, const CullView& view, CullCounts& counts)
+{
+	int numWritten = 0;
+	ForEachVisibleBurst(interpolation, view, counts, [&](const ParticleSpan& stars, const uint8_t* visible)
+	{
+		numWritten += ::GatherVisibleVertices(stars, visible, 1.0f, vertices + numWritten);
+	});
+	return numWritten;
+}
+
+int BurstInstances::GatherVisibleVertices(const PackedVertexSpan& vertices, float interpolation, const CullView& view, CullCounts& counts)
+{
+	int numWritten = 0;
+	ForEachVisibleBurst(interpolation, view, counts, [&](const ParticleSpan& stars, const uint8_t* visible)
+	{
+		numWritten += GatherVisiblePackedVertices(stars, visible, 1.0f, vertices.Skip(numWritten));
+	});
+	return numWritten;
+}
@@ -0,0 +1,133 @@
+//--------------------------------------------------------------------------------------
+// Burst instancing - the stars of a burst kept as one record and a shared offset table
+//--------------------------------------------------------------------------------------
+// The stars of a peony burst all start where the rocket burst, with the same life, colour,
+// scale and velocity apart from a random offset added to the velocity. Their motion is
+// linear in the velocity (see ParticleMotion.h), so every star is at the position of a star
+// with no offset (the burst centre) plus its offset times a "move" coefficient shared by the
+// whole burst. A burst is stored as one record with the centre's spawn state and its age,
+// and the offsets come from a few tables of random offsets shared by all bursts: each burst
+// uses a run of entries from one table, picked by its rocket's id. Updating a burst is just
+// counting its steps whatever its size, and the star positions are only worked out when
+// they are culled and uploaded. Instanced stars can't emit trails or be evicted, so only
+// bursts of simple stars are instanced
+// Code in .cpp file
+
+#ifndef _BURST_INSTANCES_H_INCLUDED_
+#define _BURST_INSTANCES_H_INCLUDED_
+
+#include "FireworkTypes.h"
+#include "ParticleStore.h"
+#include "ParticleCulling.h"
+#include "PackedFirework.h"
+
+#include <vector>
+#include <stdint.h>
+
+
+// Number of shared offset tables, and offsets in each. Bursts with more stars than a table holds are not instanced
+const int NumBurstTables = 16;
+const int BurstTableSize = 1024;
+
+
+// One burst of simple stars
+struct BurstInstance
+{
+	CVector3   position;    // Where the rocket burst
+	CVector3   velocity;    // Velocity of the rocket at the burst, which all the stars start with plus their offset
+	ColourRGBA colour;
+	float      scale;
+	float      spread;      // Offsets are up to this in each axis
+	float      life;
+	int        numStars;
+	int        numSteps;    // Steps since the burst
+	int        table;       // Offset table, and the entry for the first star - the others use the entries after it in turn
+	int        firstOffset;
+};
+
+// A burst of numStars stars with a table and first entry picked by the rocket's id
+BurstInstance MakeBurstInstance(const CVector3& position, const CVector3& velocity, const ColourRGBA& colour, float scale,
+                                float spread, float life, int numStars, uint32_t rocketId);
+
+
+class BurstInstances
+{
+public:
+	// Construction //
+
+	// Builds the offset tables, which are the same on every run
+	BurstInstances();
+
+	// Remove all bursts
+	void Clear() { mBursts.clear();  mNumStars = 0; }
+
+
+	// Update //
+
+	// Add a burst, spawned at the end of the current step
+	void Add(const BurstInstance& burst);
+
+	// Count a step of stepTime for every burst and remove those whose stars have died. The step time and gravity are used
+	// to work out the stars' positions until the next step. Returns the number of stars removed
+	int Step(float stepTime, float gravity);
+
+
+	// Size //
+
+	int NumBursts() const { return static_cast<int>(mBursts.size()); }
+	int NumStars()  const { return mNumStars; }
+
+
+	// Rendering //
+
+	// Write the render data of every star into the given array in the Firework vertex layout, burst after burst. The array
+	// must have space for NumStars() elements. See ParticleStore::GatherVertices for interpolation
+	void GatherVertices(Firework* vertices, float interpolation = 1.0f);
+
+	// As above but only the stars that pass the culling tests of the view (see ParticleCulling.h). A burst entirely out of
+	// view or faded is skipped without working out its stars. Adds to counts and returns the number of vertices written
+	int GatherVisibleVertices(Firework* vertices, float interpolation, const CullView& view, CullCounts& counts);
+
+	// As the two above, but written packed straight into the span (usually the mapped vertex buffer), see PackedFirework.h
+	void GatherVertices(const PackedVertexSpan& vertices, float interpolation = 1.0f);
+	int  GatherVisibleVertices(const PackedVertexSpan& vertices, float interpolation, const CullView& view, CullCounts& counts);
+
+
+private:
+	// Positions of the centre and distance moved per unit of offset, interpolated as for rendering
+	struct BurstFrame
+	{
+		float centreX, centreY, centreZ;
+		float offsetMove; // Times spread
+		float scale;
+		float alpha;
+	};
+	BurstFrame Frame(const BurstInstance& burst, float interpolation) const;
+
+	// Write the stars of a burst into a span of numStars particles: the position, already interpolated, as both the current
+	// and previous position, and the scale, colour and rotation. The other columns are left as they are
+	void ExpandStars(const BurstInstance& burst, const BurstFrame& frame, const ParticleSpan& stars) const;
+
+	// Call write(index, vertex) for every star, burst after burst
+	template <class F>
+	void ForEachStarVertex(float interpolation, F&& write) const;
+
+	// Call gather(stars, visible) for the stars of each burst that may be in view, expanded into mScratch, with their
+	// visibility mask. Adds to counts
+	template <class F>
+	void ForEachVisibleBurst(float interpolation, const CullView& view, CullCounts& counts, F&& gather);
+
+	std::vector<BurstInstance> mBursts; // Oldest first
+	int   mNumStars = 0;
+	float mStepTime = 0;
+	float mGravity  = 0;
+
+	// Offset tables, one column per axis, with offsets in [-1, 1)
+	AlignedVector<float> mOffsetX, mOffsetY, mOffsetZ;
+
+	ParticleStore          mScratch; // Stars of a burst for culling
+	AlignedVector<uint8_t> mVisible;
+};
+
+
+#endif //_BURST_INSTANCES_H_INCLUDED_
@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// Emission level of detail - fewer trail and burst particles for small or off-screen fireworks
+//--------------------------------------------------------------------------------------
+
+#include "EmissionLod.h"
+
+#include <cmath>
+
+
+EmissionView MakeEmissionView(const CMatrix4x4& viewMatrix, const CMatrix4x4& projectionMatrix, float viewportWidth)
+{
+	EmissionView view;
+	view.viewProjection   = viewMatrix * projectionMatrix;
+	view.projectionScaleX = projectionMatrix.e00;
+	view.projectionScaleY = projectionMatrix.e11;
+	view.viewportWidth    = viewportWidth;
+	return view;
+}
+
+
+// Emission rate for an emitter of the given world space radius at the given position
+float EmissionRate(const EmissionView& view, float x, float y, float z, float radius)
+{
+	// Clip space position (row vector times matrix)
+	const CMatrix4x4& m = view.viewProjection;
+	float clipX = x * m.e00 + y * m.e10 + z * m.e20 + m.e30;
+	float clipY = x * m.e01 + y * m.e11 + z * m.e21 + m.e31;
+	float clipW = x * m.e03 + y * m.e13 + z * m.e23 + m.e33; // Distance in front of the camera
+
+	// Off-screen if the bounding sphere is behind the camera or fully outside the sides of the view
+	float marginX = radius * view.projectionScaleX;
+	float marginY = radius * view.projectionScaleY;
+	if (clipW <= -radius || std::fabs(clipX) > clipW + marginX || std::fabs(clipY) > clipW + marginY)
+	{
+		return view.minimumRate;
+	}
+
+	// Width on screen in pixels: the radius in normalised device coordinates (clip space radius over w) is the fraction of
+	// the screen width the emitter's diameter covers. Emitters that reach behind the camera count as close
+	if (clipW <= radius)  return 1.0f;
+	float pixels = marginX / clipW * view.viewportWidth;
+
+	float rate = pixels / view.fullDetailPixels;
+	if (rate > 1.0f)              return 1.0f;
+	if (rate < view.minimumRate)  return view.minimumRate;
+	return rate;
+}
+
+
+void EmissionRates(const EmissionView& view, const ParticleSpan& p, float radius, float* rates)
+{
+	for (int i = 0; i < p.count; ++i)  rates[i] = EmissionRate(view, p.posX[i], p.posY[i], p.posZ[i], radius);
+}
+
+
+// Scale for the particles of an emitter emitting at the given rate
+float EmissionScale(const EmissionView& view, float rate)
+{
+	if (rate >= 1.0f)  return 1.0f;
+	float scale = 1.0f / std::sqrt(rate);
+	return scale < view.maximumScaleUp ? scale : view.maximumScaleUp;
+}
@@ -0,0 +1,46 @@
+//--------------------------------------------------------------------------------------
+// Emission level of detail - fewer trail and burst particles for small or off-screen fireworks
+//--------------------------------------------------------------------------------------
+// Each emitter (a trail star, a comet, a rocket about to burst) is given a rate from its
+// projected size on screen: emitters that cover many pixels emit every particle, distant
+// ones emit fewer and those outside the view emit the minimum. The particles that are
+// emitted are made bigger to keep the overall brightness, so a wide shot of a large show
+// looks much the same with a fraction of the particles
+// Code in .cpp file
+
+#ifndef _EMISSION_LOD_H_INCLUDED_
+#define _EMISSION_LOD_H_INCLUDED_
+
+#include "ParticleStore.h"
+#include "CMatrix4x4.h"
+
+
+// The camera view used to choose emission rates, plus the LOD settings
+struct EmissionView
+{
+	CMatrix4x4 viewProjection;
+	float      projectionScaleX; // e00 and e11 of the projection matrix, converts view space sizes to clip space
+	float      projectionScaleY;
+	float      viewportWidth;    // In pixels
+
+	float fullDetailPixels = 24.0f; // Emitters at least this many pixels across emit at the full rate
+	float minimumRate      = 0.1f;  // Rate for tiny and off-screen emitters
+	float maximumScaleUp   = 2.0f;  // Largest increase in the size of the emitted particles to make up for fewer of them
+};
+
+// Make a view from a camera's matrices (row vector convention, as Camera.h) and the viewport width in pixels
+EmissionView MakeEmissionView(const CMatrix4x4& viewMatrix, const CMatrix4x4& projectionMatrix, float viewportWidth);
+
+
+// Emission rate (minimumRate to 1) for an emitter of the given world space radius at the given position
+float EmissionRate(const EmissionView& view, float x, float y, float z, float radius);
+
+// Emission rates for every particle in a span, treating each as an emitter of the given radius
+void EmissionRates(const EmissionView& view, const ParticleSpan& particles, float radius, float* rates);
+
+// Scale for the particles of an emitter emitting at the given rate, so the total area (and so brightness with additive
+// blending) stays about the same: 1 / sqrt(rate), but no more than maximumScaleUp
+float EmissionScale(const EmissionView& view, float rate);
+
+
+#endif //_EMISSION_LOD_H_INCLUDED_
@@ -0,0 +1,149 @@
+//--------------------------------------------------------------------------------------
+// Rate-based emitters - particles that leave a stream of children behind them
+//--------------------------------------------------------------------------------------
+
+#include "Emitter.h"
+#include "ParticleKernels.h"
+#include "MathHelpers.h"
+
+#include <algorithm>
+#include <vector>
+
+
+bool IsValidEmitter(const EmitterDesc& desc)
+{
+	return desc.burst > 0 && desc.interval >= 0 && desc.maxPerStep >= 0;
+}
+
+
+// Trail stars leave lots of little, short-lived simple stars behind them, one every 0.05s
+EmitterDesc SmallTrailStarEmitter()
+{
+	EmitterDesc desc;
+	desc.interval = 0.05f;
+	return desc;
+}
+
+// Comets leave a trail of the same short-lived simple stars, one every step
+EmitterDesc CometEmitter()
+{
+	EmitterDesc desc;
+	desc.interval = 0;
+	return desc;
+}
+
+
+EmitterCounts RunEmitters(const ParticleSpan& p, const EmitterDesc& desc, float stepTime, uint32_t frame, float rate,
+                          const EmissionView* view, int maxChildren, SpawnBuffer& spawns)
+{
+	EmitterCounts counts;
+	if (!IsValidEmitter(desc))  return counts;
+
+	// With emission LOD each emitter has its own rate from its size on screen
+	std::vector<float>& lodRates = spawns.emitterRates;
+	lodRates.assign(p.count, 1.0f);
+	if (view != nullptr)  EmissionRates(*view, p, TrailLodRadius, lodRates.data());
+
+	// Emissions each emitter owes this step, moving its accumulator on (see Emitter.h)
+	std::vector<int>& emissions = spawns.emitterEmissions;
+	emissions.resize(p.count);
+	int numEmissions = 0;
+	for (int i = 0; i < p.count; ++i)
+	{
+		float emitterRate = rate * lodRates[i];
+		int   owed = 0;
+		if (desc.interval > 0)
+		{
+			// A lower rate emits less often. With no emission at all the timer keeps running at the full rate, so the
+			// trail picks up again when the rate goes back up
+			float interval = emitterRate > 0 ? desc.interval / emitterRate : desc.interval;
+			p.timer[i] -= stepTime;
+			while (p.timer[i] <= 0) // Several may be due if the interval is shorter than the step
+			{
+				p.timer[i] += interval;
+				owed += emitterRate > 0 ? 1 : 0;
+			}
+		}
+		else
+		{
+			float due = p.timer[i] + emitterRate;
+			owed = static_cast<int>(due);
+			p.timer[i] = due - owed;
+		}
+
+		if (owed > desc.maxPerStep)
+		{
+			counts.numCapped += (owed - desc.maxPerStep) * desc.burst;
+			owed = desc.maxPerStep;
+		}
+		emissions[i] = owed;
+		numEmissions += owed;
+	}
+
+	// Over the span's limit, keep an even share of each emitter's emissions: emitter i keeps the emissions that take the
+	// running total of kept ones up a whole number, scaling the total owed before it down to the limit
+	int maxEmissions = maxChildren >= 0 ? maxChildren / desc.burst : numEmissions;
+	if (numEmissions > maxEmissions)
+	{
+		int64_t before = 0;
+		for (int i = 0; i < p.count; ++i)
+		{
+			int64_t after = before + emissions[i];
+			int kept = static_cast<int>(after * maxEmissions / numEmissions - before * maxEmissions / numEmissions);
+			before = after;
+			emissions[i] = kept;
+		}
+		counts.numCapped += (numEmissions - maxEmissions) * desc.burst;
+		numEmissions = maxEmissions;
+	}
+
+	Firework firework;
+	firework.position = { 0, 0, 0 }; // Set per child below
+	firework.scale    = desc.childScale;
+	firework.colour   = { 0, 0, 0 }; // Set per child below
+	firework.rotation = 0;
+
+	FireworkUpdate fireworkUpdate = {};
+	fireworkUpdate.type = desc.childType;
+	fireworkUpdate.life = desc.childLife;
+
+	// Reserve and fill the children of the whole span in one step
+	ParticleSpan children = spawns.Reserve(desc.childType, numEmissions * desc.burst, desc.childLife);
+	InitParticles(children, firework, fireworkUpdate);
+	counts.numEmitted = children.count;
+
+	// When every emitter spawns a single child with no LOD, the children line up with the emitters and each column is
+	// filled by a kernel
+	if (desc.burst == 1 && view == nullptr && std::count(emissions.begin(), emissions.end(), 1) == p.count)
+	{
+		CopyPositionAndColour(children, p);
+		ScaleVelocity(children, p, desc.inheritVelocity);
+		InheritIds(children, p, frame);
+		AddRandomVelocity(children, desc.jitter, frame);
+		return counts;
+	}
+
+	int c = 0;
+	for (int i = 0; i < p.count; ++i)
+	{
+		uint32_t parentKey = HashSeed(p.id[i], frame);
+		float scale = view != nullptr ? desc.childScale * EmissionScale(*view, lodRates[i]) : desc.childScale;
+		for (int child = 0; child < emissions[i] * desc.burst; ++child, ++c)
+		{
+			children.id[c] = HashSeed(parentKey, child);
+
+			// Children start at the emitter's position with its colour, and part of its velocity so they lag behind
+			children.posX[c] = children.prevX[c] = p.posX[i];
+			children.posY[c] = children.prevY[c] = p.posY[i];
+			children.posZ[c] = children.prevZ[c] = p.posZ[i];
+			children.colourR[c] = p.colourR[i];  children.colourG[c] = p.colourG[i];
+			children.colourB[c] = p.colourB[i];  children.colourA[c] = p.colourA[i];
+			children.velX[c] = p.velX[i] * desc.inheritVelocity;
+			children.velY[c] = p.velY[i] * desc.inheritVelocity;
+			children.velZ[c] = p.velZ[i] * desc.inheritVelocity;
+			children.scale[c] = scale;
+		}
+	}
+	AddRandomVelocity(children, desc.jitter, frame);
+	return counts;
+}
@@ -0,0 +1,72 @@
+//--------------------------------------------------------------------------------------
+// Rate-based emitters - particles that leave a stream of children behind them
+//--------------------------------------------------------------------------------------
+// Trail stars and comets are both emitters: every so often each one spawns children at its
+// position, moving with part of its velocity plus a little random jitter. An EmitterDesc
+// says how often, how many and what the children are like, and RunEmitters does it for a
+// whole span of emitters: it works out how many emissions each emitter owes this step from
+// an accumulator kept in the emitter's timer column, applies the caps, then reserves and
+// fills all the children of the span in one go with the spawn kernels (ParticleKernels.h).
+//
+// The accumulator depends on the interval. With an interval, the timer counts down the time
+// to the next emission, and an emission is due each time it reaches 0. With no interval, the
+// emitter emits on every step at full rate, and the timer holds the fraction of an emission
+// carried over from step to step. Lower rates (from the emission quality and LOD) stretch the
+// interval or reduce the fraction added per step, so children stay evenly spaced. Each
+// emitter is limited to maxPerStep emissions in a step. The caller can also give a limit
+// for the whole span: emissions over it are skipped evenly across the span, so no emitter's
+// trail stops altogether. Skipped emissions still use up the accumulator
+// Code in .cpp file
+
+#ifndef _EMITTER_H_INCLUDED_
+#define _EMITTER_H_INCLUDED_
+
+#include "SpawnBuffer.h"
+#include "EmissionLod.h"
+
+#include <stdint.h>
+
+
+// How an emitter emits and what it emits
+struct EmitterDesc
+{
+	float interval        = 0;    // Seconds between emissions at full rate, 0 to emit on every step
+	int   burst           = 1;    // Children spawned by each emission
+	float inheritVelocity = 0.5f; // Fraction of the emitter's velocity the children start with, so they lag behind
+	float jitter          = 5.0f; // Random velocity added to each child, up to this in each axis
+	int   maxPerStep      = 4;    // Most emissions by one emitter in a step
+
+	// Child template. Children take the emitter's position and colour
+	FireworkType childType  = FireworkType::StarSimple;
+	float        childLife  = TrailSparkLife;
+	float        childScale = 0.75f;
+};
+
+// True if the desc can be run: at least one child per emission, and no negative interval or maxPerStep
+bool IsValidEmitter(const EmitterDesc& desc);
+
+// The emitters of the built-in types
+EmitterDesc SmallTrailStarEmitter();
+EmitterDesc CometEmitter();
+
+// World space radius of an emitter and the short trail behind it, for emission LOD
+const float TrailLodRadius = 5.0f;
+
+
+// What happened in one call of RunEmitters
+struct EmitterCounts
+{
+	int numEmitted = 0; // Children spawned
+	int numCapped  = 0; // Children skipped because of maxPerStep or the span's limit
+};
+
+// Run the emitters of a span for one step of stepTime, putting their children in the spawn buffer. "rate" is the
+// fraction of the full rate to emit at (see EmissionQuality), and with an emission view each emitter's rate is also
+// lowered by its size on screen, with bigger children to make up for it. maxChildren limits the children from the whole
+// span, -1 for no limit. Random numbers are keyed by emitter id and frame. A desc that isn't valid emits nothing. The
+// spawn buffer's emitter scratch space is used for the per-emitter working, so nothing is allocated once it has grown
+EmitterCounts RunEmitters(const ParticleSpan& emitters, const EmitterDesc& desc, float stepTime, uint32_t frame, float rate,
+                          const EmissionView* view, int maxChildren, SpawnBuffer& spawns);
+
+
+#endif //_EMITTER_H_INCLUDED_
@@ -0,0 +1,61 @@
+//--------------------------------------------------------------------------------------
+// Firework launches - the rockets created by the launch buttons
+//--------------------------------------------------------------------------------------
+
+#include "FireworkLaunch.h"
+
+
+// Create the rockets for a launch in the given spawn buffer. Returns the number of rockets created
+int LaunchFireworks(const LaunchParams& params, SpawnBuffer& spawns)
+{
+	// Rocket type, payload and launch cone of each kind of launch
+	FireworkType rocketType  = FireworkType::PeonyRocket;
+	FireworkType payloadType = FireworkType::StarSimple;
+	float        coneAngle   = 15; // Launches in a random direction within this many degrees of up (0,1,0)
+	switch (params.kind)
+	{
+		case LaunchKind::Peony:                                                                  break;
+		case LaunchKind::Comet:           rocketType = FireworkType::CometRocket;                break;
+		case LaunchKind::Brocade:         rocketType = FireworkType::BrocadeRocket; coneAngle = 180; break;
+		case LaunchKind::PeonyWithTrails: payloadType = FireworkType::StarSmallTrail;            break;
+	}
+
+	// All randomness comes from the seed, so the launch can be repeated exactly
+	RandomStream random({ params.seed, 0 });
+
+	for (int i = 0; i < params.numFireworks; ++i)
+	{
+		CVector3 fireworkDirection = RandomVectorInCone(CVector3{ 0, 1, 0 }, coneAngle, random);
+
+		Firework firework;
+		firework.position = params.position;
+		firework.scale    = params.scale;
+		firework.colour   = params.colour; // 4th value is alpha transparency - 1.0 is not transparent
+		firework.rotation = params.rotation;
+
+		FireworkUpdate fireworkUpdate = {};
+		fireworkUpdate.type           = rocketType;
+		fireworkUpdate.id             = HashSeed(params.seed, i);
+		fireworkUpdate.velocity       = fireworkDirection * params.initialVelocity; // Initial velocity of rocket (speed 70 to 100)
+		fireworkUpdate.life           = params.burstLife;      // How long before rocket bursts
+		fireworkUpdate.payloadTypeA   = payloadType;           // Type of star in the burst (comets: type of trail star)
+		fireworkUpdate.payloadIntA    = params.burstParticles; // How many stars the emit at the burst
+		fireworkUpdate.payloadColourA = params.colour;         // Colour of stars when it bursts
+
+		spawns.Add(firework, fireworkUpdate);
+	}
+	return params.numFireworks;
+}
+
+
+const char* LaunchKindName(LaunchKind kind)
+{
+	switch (kind)
+	{
+		case LaunchKind::Peony:           return "Peony";
+		case LaunchKind::Comet:           return "Comet";
+		case LaunchKind::Brocade:         return "Brocade";
+		case LaunchKind::PeonyWithTrails: return "Peony with Small Trails";
+	}
+	return "Unknown";
+}
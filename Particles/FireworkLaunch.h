@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// Firework launches - the rockets created by the launch buttons
+//--------------------------------------------------------------------------------------
+// A launch is fully described by LaunchParams, including the seed for its random directions
+// and particle ids, so the same parameters always create exactly the same rockets. This is
+// what allows launches to be recorded and replayed (see LaunchLog.h)
+// Code in .cpp file
+
+#ifndef _FIREWORK_LAUNCH_H_INCLUDED_
+#define _FIREWORK_LAUNCH_H_INCLUDED_
+
+#include "SpawnBuffer.h"
+#include "CVector3.h"
+#include "ColourRGBA.h"
+
+#include <stdint.h>
+
+
+// The kinds of launch on offer
+enum class LaunchKind : uint8_t
+{
+	Peony,
+	Comet,
+	Brocade,
+	PeonyWithTrails,
+};
+const int NumLaunchKinds = 4;
+
+
+// Everything needed to repeat a launch exactly
+struct LaunchParams
+{
+	LaunchKind kind;
+	int        numFireworks;    // Rockets launched together
+	CVector3   position;
+	ColourRGBA colour;          // Colour of the rockets and their stars
+	float      scale;
+	float      rotation;
+	float      initialVelocity;
+	int        burstParticles;  // Stars in each burst
+	float      burstLife;       // Rocket flight time before it bursts
+	uint32_t   seed;            // Keys the launch directions and the rocket ids
+};
+
+
+// Create the rockets for a launch in the given spawn buffer. Returns the number of rockets created
+int LaunchFireworks(const LaunchParams& params, SpawnBuffer& spawns);
+
+// Name of a launch kind for display, e.g. "Peony"
+const char* LaunchKindName(LaunchKind kind);
+
+
+#endif //_FIREWORK_LAUNCH_H_INCLUDED_
@@ -0,0 +1,30 @@
+//--------------------------------------------------------------------------------------
+// Firework quads - the data for drawing particles as instances of one shared quad
+//--------------------------------------------------------------------------------------
+
+#include "FireworkQuads.h"
+
+
+const FireworkQuadVertex FireworkQuadVertices[NumFireworkQuadVertices] =
+{
+	{ -1,  1,   0, 0 },
+	{  1,  1,   1, 0 },
+	{ -1, -1,   0, 1 },
+	{  1, -1,   1, 1 },
+};
+
+
+FireworkQuadBasis MakeFireworkQuadBasis(const CMatrix4x4& cameraMatrix)
+{
+	return { cameraMatrix.GetXAxis(), cameraMatrix.GetYAxis() };
+}
+
+
+void ExpandFireworkQuad(const Firework& firework, const FireworkQuadBasis& basis, CVector3 corners[NumFireworkQuadVertices])
+{
+	for (int i = 0; i < NumFireworkQuadVertices; ++i)
+	{
+		const FireworkQuadVertex& vertex = FireworkQuadVertices[i];
+		corners[i] = firework.position + (basis.right * vertex.cornerX + basis.up * vertex.cornerY) * firework.scale;
+	}
+}
@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// Firework quads - the data for drawing particles as instances of one shared quad
+//--------------------------------------------------------------------------------------
+// Particles can be drawn in two ways. As points, which the geometry shader turns into a
+// camera-facing quad each, working out all four corners from the camera matrix for every
+// particle - geometry shaders that add vertices are slow on many GPUs. Or instanced: a
+// quad of four vertices in a small vertex buffer of its own is drawn once per particle,
+// with the packed vertex streams (see PackedFirework.h) read once per instance. Then the
+// vertex shader puts each corner along the camera's right and up vectors, which are worked
+// out once per frame here rather than for every corner
+//
+// This builds the shared quad and the per-frame vectors, and expands a particle to its
+// corners on the CPU exactly as the instanced vertex shader (FireworkQuad_vs.hlsl) does
+// Code in .cpp file
+
+#ifndef _FIREWORK_QUADS_H_INCLUDED_
+#define _FIREWORK_QUADS_H_INCLUDED_
+
+#include "FireworkTypes.h"
+#include "CMatrix4x4.h"
+
+
+// A vertex of the shared quad: its corner as multiples of the camera right and up vectors (times the particle scale),
+// and its texture coordinate
+struct FireworkQuadVertex
+{
+	float cornerX, cornerY;
+	float u, v;
+};
+
+// The quad as a triangle strip, in the same order as the geometry shader outputs its corners
+const int NumFireworkQuadVertices = 4;
+extern const FireworkQuadVertex FireworkQuadVertices[NumFireworkQuadVertices];
+
+
+// World space directions of the quad's x and y, the same for every particle in a frame
+struct FireworkQuadBasis
+{
+	CVector3 right;
+	CVector3 up;
+};
+
+// The basis for a camera with the given world matrix. These are the first two rows of the matrix, which the geometry
+// shader multiplies each corner by, so both paths draw the same quads
+FireworkQuadBasis MakeFireworkQuadBasis(const CMatrix4x4& cameraMatrix);
+
+
+// The world positions of the corners of a particle's quad, in the order of FireworkQuadVertices. The rotation is not
+// used, as in the geometry shader
+void ExpandFireworkQuad(const Firework& firework, const FireworkQuadBasis& basis, CVector3 corners[NumFireworkQuadVertices]);
+
+
+#endif //_FIREWORK_QUADS_H_INCLUDED_
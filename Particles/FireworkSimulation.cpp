@@ -0,0 +1,517 @@
+//--------------------------------------------------------------------------------------
+// The firework simulation - particle pool, per-type update, spawning and removal
+//--------------------------------------------------------------------------------------
+
+#include "FireworkSimulation.h"
+#include "ParticleKernels.h"
+#include "EmissionLod.h"
+#include "Emitter.h"
+#include "MathHelpers.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <vector>
+#include <cstring>
+
+
+//--------------------------------------------------------------------------------------
+// Per-type updates
+//--------------------------------------------------------------------------------------
+
+// Each type of firework has its own update function below, called for one chunk of that type's bucket (see
+// FireworkSimulation::UpdateChunk). Movement, life, and star fading / drag have already been done by a vectorised kernel
+// (see ParticleKernels.h), so these functions only deal with the per-type events: trails and bursts. Every particle in the
+// span has the same type, so there are no type tests inside the loops. Fireworks die when their life reaches 0, they are
+// removed after the update
+//
+// When emission LOD is on (see EmissionLod.h) each emitter's rate also depends on its size on screen, and the particles it
+// does emit are made bigger to make up for it. This is the world space size used to judge that for bursts (see Emitter.h
+// for trails)
+const float BurstLodRadius = 40.0f; // Around the stars of a burst as they spread out
+
+
+//------------------------------------
+// TRAIL STARS AND COMETS - UPDATE IN FLIGHT
+//------------------------------------
+// Trail stars work like simple stars but emit lots of little, short-lived simple stars behind them, leaving a trail.
+// Comets leave the same kind of trail, one star every step. Both are rate-based emitters (see Emitter.h), run by
+// RunEmitters with the settings from FireworkSimulation::SetEmitter
+
+
+// Number of stars in a burst at the given quality and LOD rate. A rocket that had a burst always gets at least one star
+static int BurstSize(int numStars, const EmissionQuality& quality, float lodRate)
+{
+	float rate = quality.burstScale * lodRate;
+	if (numStars <= 0 || rate >= 1)  return numStars;
+	int scaled = static_cast<int>(numStars * rate + 0.5f);
+	return scaled > 0 ? scaled : 1;
+}
+
+// LOD rate for a burst from rocket i, 1 if emission LOD is off
+static float BurstLodRate(const ParticleSpan& p, int i, const EmissionView* view)
+{
+	return view != nullptr ? EmissionRate(*view, p.posX[i], p.posY[i], p.posZ[i], BurstLodRadius) : 1.0f;
+}
+
+
+//-------------------------------
+// PEONY ROCKET BURST
+//-------------------------------
+// For PeonyRockets: payloadTypeA is the type of star to launch on burst - random in all directions.
+//                   payloadIntA is the number of stars to launch when it bursts, and payloadColourA is the colour of those stars
+// With burst instancing, bursts of simple stars are staged as a single instance instead (see BurstInstances.h)
+static void BurstPeonyRockets(const ParticleSpan& p, uint32_t frame, const EmissionQuality& quality, const EmissionView* view,
+                              bool instance, SpawnBuffer& spawns)
+{
+	for (int i = 0; i < p.count; ++i)
+	{
+		if (p.life[i] > 0)  continue;
+
+		// Payload is kept in a cold column, only read here when a rocket bursts
+		const FireworkPayload& payload = p.payload[i];
+
+		// Distant bursts have fewer, bigger stars (see EmissionLod.h)
+		float lodRate = BurstLodRate(p, i, view);
+
+		Firework firework;
+		firework.position = { p.posX[i], p.posY[i], p.posZ[i] }; // Stars emit from where the rocket is when it burst (life reached 0)
+		firework.scale = view != nullptr ? 1.5f * EmissionScale(*view, lodRate) : 1.5f;
+		firework.colour = payload.colourA; // Rocket contains star colour in its payload
+		firework.rotation = 0;
+
+		FireworkUpdate fireworkUpdate = {};
+		fireworkUpdate.type     = payload.typeA;
+		fireworkUpdate.velocity = { p.velX[i], p.velY[i], p.velZ[i] }; // Add the rocket's velocity at burst to the initial star velocity for more realism
+		fireworkUpdate.life     = PeonyStarLife; // How long stars last
+		fireworkUpdate.timer    = 0;
+
+		int numStars = BurstSize(payload.intA, quality, lodRate);
+		if (instance && payload.typeA == FireworkType::StarSimple && numStars > 0 && numStars <= BurstTableSize)
+		{
+			spawns.bursts.push_back(MakeBurstInstance(firework.position, fireworkUpdate.velocity, firework.colour, firework.scale,
+			                                          50.0f, PeonyStarLife, numStars, p.id[i]));
+			continue;
+		}
+
+		// Reserve and fill the whole burst in one step
+		ParticleSpan stars = spawns.Reserve(payload.typeA, numStars, PeonyStarLife);
+		InitParticles(stars, firework, fireworkUpdate);
+		AssignChildIds(stars, p.id[i], frame);
+		AddRandomVelocity(stars, 50.0f, frame);
+	}
+}
+
+
+//-------------------------------
+// BROCADE ROCKET BURST
+//-------------------------------
+// Bursts into long-lived trail stars that glitter as they fall
+static void BurstBrocadeRockets(const ParticleSpan& p, uint32_t frame, const EmissionQuality& quality, const EmissionView* view,
+                                SpawnBuffer& spawns)
+{
+	for (int i = 0; i < p.count; ++i)
+	{
+		if (p.life[i] > 0)  continue;
+
+		const FireworkPayload& payload = p.payload[i];
+
+		float lodRate = BurstLodRate(p, i, view);
+
+		Firework firework;
+		firework.position = { p.posX[i], p.posY[i], p.posZ[i] };
+		firework.scale = view != nullptr ? 1.5f * EmissionScale(*view, lodRate) : 1.5f;
+		firework.colour = payload.colourA;
+		firework.rotation = 0;
+
+		FireworkUpdate fireworkUpdate = {};
+		fireworkUpdate.type = FireworkType::StarSmallTrail; // <<< MAKE THEM TRAIL STARS
+		fireworkUpdate.velocity = { p.velX[i], p.velY[i], p.velZ[i] };
+		fireworkUpdate.life = BrocadeStarLife; // Live longer so they fall
+		fireworkUpdate.timer = 0.05f; // <<< Start emitting small glitter right away!
+
+		ParticleSpan stars = spawns.Reserve(FireworkType::StarSmallTrail, BurstSize(payload.intA, quality, lodRate), BrocadeStarLife);
+		InitParticles(stars, firework, fireworkUpdate);
+		AssignChildIds(stars, p.id[i], frame);
+		AddRandomVelocity(stars, 60.0f, frame);
+	}
+}
+
+//------------------------------------
+// ADD YOUR FIREWORKS UPDATES / BURSTS
+//------------------------------------
+// Write a function like those above and call it for the new type in FireworkSimulation::UpdateChunk
+
+
+//--------------------------------------------------------------------------------------
+// Simulation
+//--------------------------------------------------------------------------------------
+
+// Rockets first, so their bursts are committed before the trails of the stars
+const FireworkType FireworkSimulation::ChunkOrder[NumFireworkTypes] = { FireworkType::PeonyRocket, FireworkType::FancyPeonyRocket,
+                                                                        FireworkType::BrocadeRocket, FireworkType::CometRocket,
+                                                                        FireworkType::StarSmallTrail, FireworkType::StarSimple };
+
+
+FireworkSimulation::FireworkSimulation(int maxParticles)
+	: mParticles(maxParticles), mSpawns(1), mMaxParticles(maxParticles)
+{
+	mEmitters[static_cast<int>(FireworkType::StarSmallTrail)] = SmallTrailStarEmitter();
+	mEmitters[static_cast<int>(FireworkType::CometRocket)]    = CometEmitter();
+}
+
+
+// Types whose update runs an emitter
+bool FireworkSimulation::IsEmitterType(FireworkType type)
+{
+	return type == FireworkType::StarSmallTrail || type == FireworkType::CometRocket;
+}
+
+
+// Update one chunk of one type bucket or ring. Runs on a worker thread, so must not change the size of any bucket - new
+// fireworks go into the given spawn buffer, and dead fireworks are only marked in the alive mask, they are removed after
+// all chunks are done
+void FireworkSimulation::UpdateChunk(int chunkIndex, float stepTime, SpawnBuffer& spawns)
+{
+	Chunk& chunk = mChunks[chunkIndex];
+	ParticleSpan p = chunk.ring < 0 ? mParticles.Bucket(chunk.type).Span(chunk.begin, chunk.end)
+	                                : mParticles.Ring(chunk.ring).Span(chunk.begin, chunk.end);
+
+	// Simple stars only move, so groups of them in a ring that are distant or out of view can be left to catch up on a
+	// later step (see UpdateLod.h). Groups due on this step are integrated over all the steps they missed in one go, in
+	// runs of neighbouring groups needing the same number of steps, then given their next period from where they are now.
+	// Groups that may still get new particles are never late
+	if (chunk.ring >= 0 && chunk.type == FireworkType::StarSimple)
+	{
+		ParticleSpan run = {};
+		int runSteps = 0;
+		ParticleSpan             runGroups[ParticleRing::NumLodGroups];
+		ParticleRing::GroupLod*  runLods  [ParticleRing::NumLodGroups];
+		int numRunGroups = 0;
+		auto integrateRun = [&]()
+		{
+			if (run.count == 0)  return;
+			IntegrateParticleSteps(run, stepTime, runSteps, mGravity, ParticleFade::Always);
+			for (int g = 0; g < numRunGroups; ++g)
+			{
+				runLods[g]->period  = UpdatePeriod(mUpdateLodView, runGroups[g], stepTime);
+				runLods[g]->recheck = mUpdateLodView.nearRecheck;
+			}
+			run.count = 0;
+			numRunGroups = 0;
+		};
+
+		chunk.numDead = 0;
+		mParticles.Ring(chunk.ring).ForEachLodGroup(chunk.block, [&](const ParticleSpan& group, ParticleRing::GroupLod& lod, bool full)
+		{
+			bool useLod = mUseUpdateLodView && full;
+			if (!useLod)  lod.period = 1; // Any steps it is behind are still caught up
+
+			int numSteps = lod.lag + 1;
+			if (numSteps < lod.period)
+			{
+				lod.lag = numSteps;
+				chunk.numDeferred += group.count;
+				integrateRun();
+				return;
+			}
+			lod.lag = 0;
+
+			if (numSteps != runSteps)  integrateRun();
+			if (run.count == 0)
+			{
+				run = group;
+				runSteps = numSteps;
+			}
+			else
+			{
+				run.count += group.count; // The groups are next to each other in the block
+			}
+			// Groups updated every step only look again every few steps, going to a lower rate isn't urgent
+			if (useLod && (lod.period > 1 || --lod.recheck <= 0))
+			{
+				runGroups[numRunGroups] = group;
+				runLods  [numRunGroups] = &lod;
+				++numRunGroups;
+			}
+		});
+		integrateRun();
+		return;
+	}
+
+	// Random numbers come from a counter-based generator keyed by particle id and step number (see CounterRandom.h), so they
+	// don't depend on which chunk or thread a particle is updated in
+	uint32_t frame = mStepNumber;
+
+	const EmissionView* view = mUseEmissionView ? &mEmissionView : nullptr;
+
+	// Rockets only need to look for bursts when one of their expiries is due (see FireExpiries)
+	bool expiring = mExpiring[static_cast<int>(chunk.type)];
+
+	// One decision per chunk selects the whole update for the type
+	EmitterCounts emitted;
+	switch (chunk.type)
+	{
+		case FireworkType::StarSimple: // Simple stars just shrink, fade out and slightly slow down (whilst falling)
+			IntegrateParticles(p, stepTime, mGravity, ParticleFade::Always);
+			break;
+
+		case FireworkType::StarSmallTrail:
+			IntegrateParticles(p, stepTime, mGravity, ParticleFade::Always);
+			emitted = RunEmitters(p, mEmitters[static_cast<int>(chunk.type)], stepTime, frame, mQuality.trailRate, view,
+			                      chunk.maxEmitted, spawns);
+			break;
+
+		case FireworkType::CometRocket:
+			IntegrateParticles(p, stepTime, mGravity, ParticleFade::Never);
+			emitted = RunEmitters(p, mEmitters[static_cast<int>(chunk.type)], stepTime, frame, mQuality.trailRate, view,
+			                      chunk.maxEmitted, spawns);
+			break;
+
+		case FireworkType::PeonyRocket:
+			IntegrateParticles(p, stepTime, mGravity, ParticleFade::Never);
+			if (expiring)  BurstPeonyRockets(p, frame, mQuality, view, mInstanceBursts, spawns);
+			break;
+
+		case FireworkType::BrocadeRocket:
+			IntegrateParticles(p, stepTime, mGravity, ParticleFade::Never);
+			if (expiring)  BurstBrocadeRockets(p, frame, mQuality, view, spawns);
+			break;
+
+		default: // Types with no special behaviour yet just fly until their life runs out
+			IntegrateParticles(p, stepTime, mGravity, ParticleFade::Never);
+			break;
+	}
+	chunk.numCapped = emitted.numCapped;
+
+	// Ring particles die in order, so their dead are counted from the front after the update instead
+	if (chunk.ring >= 0)
+	{
+		chunk.numDead = 0;
+		return;
+	}
+
+	// Mark which particles survived while the chunk's life values are still in cache. With no expiries due every particle
+	// is still alive, so the mask is just filled in
+	uint8_t* alive = mParticles.AliveMask(chunk.type) + chunk.begin;
+	if (expiring)
+	{
+		chunk.numDead = BuildAliveMask(p, alive);
+	}
+	else
+	{
+		std::memset(alive, 1, p.count);
+		chunk.numDead = 0;
+	}
+}
+
+
+void FireworkSimulation::FireExpiries(double stepStart, double stepEnd)
+{
+	// An event is at the tick its search starts, so the search lasts from then until the expiry time plus the margin
+	mFiredExpiries.clear();
+	mExpiries.Advance(static_cast<uint64_t>(stepEnd / ExpiryTickTime), mFiredExpiries);
+	for (const auto& event : mFiredExpiries)
+	{
+		double searchEnd = (event.tick + 1) * ExpiryTickTime + 2 * ExpiryMargin;
+		if (searchEnd > mSearchUntil[event.tag])  mSearchUntil[event.tag] = searchEnd;
+	}
+	for (int type = 0; type < NumFireworkTypes; ++type)  mExpiring[type] = mSearchUntil[type] > stepStart;
+}
+
+
+// Schedule the expiry of the particles from firstNew[type] to the end of each bucket
+void FireworkSimulation::ScheduleExpiries(const int* firstNew)
+{
+	const double maxTime = 1e15 * ExpiryTickTime; // Keeps ticks in range for lives that are practically forever
+
+	for (int type = 0; type < NumFireworkTypes; ++type)
+	{
+		ParticleStore& bucket = mParticles.Bucket(static_cast<FireworkType>(type));
+		const float* life = bucket.Span().life;
+
+		uint64_t lastTick = ~uint64_t(0);
+		for (int i = firstNew[type]; i < bucket.Size(); ++i)
+		{
+			double searchStart = mTime + life[i] - ExpiryMargin;
+			if (searchStart < 0)        searchStart = 0;
+			if (searchStart > maxTime)  searchStart = maxTime;
+
+			uint64_t tick = static_cast<uint64_t>(searchStart / ExpiryTickTime);
+			if (tick == lastTick)  continue; // One event is enough for a run of particles expiring together
+			mExpiries.Insert(tick, type);
+			lastTick = tick;
+		}
+	}
+}
+
+
+// Record the particles from firstNew[type] to the end of each bucket, and from firstNewInRing[class] to the end of each
+// ring, in the timeline. They have just been committed so are still in their spawn state, at the end of this step
+void FireworkSimulation::RecordSpawns(const int* firstNew, const int* firstNewInRing)
+{
+	for (int type = 0; type < NumFireworkTypes; ++type)
+	{
+		ParticleStore& bucket = mParticles.Bucket(static_cast<FireworkType>(type));
+		mTimeline->Record(bucket.Span(firstNew[type], bucket.Size()), mTime);
+	}
+	for (int c = 0; c < NumLifetimeClasses; ++c)
+	{
+		ParticleRing& ring = mParticles.Ring(c);
+		ring.ForEachSpan(firstNewInRing[c], ring.Size(), [&](const ParticleSpan& span, int) { mTimeline->Record(span, mTime); });
+	}
+}
+
+
+// Advance all fireworks by stepTime
+void FireworkSimulation::Step(float stepTime)
+{
+	using Clock = std::chrono::steady_clock;
+	using Milliseconds = std::chrono::duration<float, std::milli>;
+	auto updateStart = Clock::now();
+
+	// Find which buckets have particles that may die (or burst) in this step
+	double stepStart = mTime;
+	mTime += stepTime;
+	FireExpiries(stepStart, mTime);
+	int numBurstStarsExpired = mBursts.Step(stepTime, mGravity);
+
+	// Split each type bucket into chunks, always in the same type order so the order spawns are committed doesn't depend on
+	// threading, and spawns from more important types are committed first. Each block of the type's rings is a chunk too
+	mChunks.clear();
+	for (FireworkType type : ChunkOrder)
+	{
+		int bucketSize = mParticles.Bucket(type).Size();
+		for (int begin = 0; begin < bucketSize; begin += ChunkSize)
+		{
+			int end = begin + ChunkSize < bucketSize ? begin + ChunkSize : bucketSize;
+			mChunks.push_back({ type, begin, end, 0, -1, 0, 0, -1, 0 });
+		}
+		for (int c = 0; c < NumLifetimeClasses; ++c)
+		{
+			if (GetLifetimeClass(c).type != type)  continue;
+			const ParticleRing& ring = mParticles.Ring(c);
+			for (int block = 0; block < ring.NumBlocks(); ++block)
+			{
+				int begin, end;
+				ring.BlockRange(block, begin, end);
+				mChunks.push_back({ type, begin, end, 0, c, block, 0, -1, 0 });
+			}
+		}
+	}
+
+	// The emission cap is shared between the chunks of emitter types by their number of emitters. The chunks are the same
+	// whatever the number of threads, so are their shares
+	if (mEmissionCap >= 0)
+	{
+		int64_t numEmitters = 0;
+		for (const auto& chunk : mChunks)  numEmitters += IsEmitterType(chunk.type) ? chunk.end - chunk.begin : 0;
+		for (auto& chunk : mChunks)
+		{
+			if (!IsEmitterType(chunk.type))  continue;
+			int64_t share = static_cast<int64_t>(mEmissionCap) * (chunk.end - chunk.begin) / numEmitters; // In 64 bits, as large caps overflow int
+			chunk.maxEmitted = static_cast<int>(std::min<int64_t>(share, std::numeric_limits<int>::max()));
+		}
+	}
+
+	// Update chunks in parallel, each collecting its new fireworks in its own spawn buffer (after the launch buffer)
+	int numChunks = static_cast<int>(mChunks.size());
+	if (static_cast<int>(mSpawns.size()) < numChunks + 1)  mSpawns.resize(numChunks + 1);
+	mParticles.PrepareAliveMasks();
+	auto updateChunk = [&](int chunk)
+	{
+		UpdateChunk(chunk, stepTime, mSpawns[LaunchSpawnBuffer + 1 + chunk]);
+	};
+	if (mWorkers != nullptr)  mWorkers->ParallelFor(numChunks, updateChunk);
+	else                      for (int chunk = 0; chunk < numChunks; ++chunk)  updateChunk(chunk);
+	auto removeStart = Clock::now();
+
+	// Fireworks that died this step - marked in the alive masks of the buckets, and the leading run of each ring
+	int removeByType[NumFireworkTypes] = {};
+	int popByClass[NumLifetimeClasses];
+	for (const auto& chunk : mChunks)  removeByType[static_cast<int>(chunk.type)] += chunk.numDead;
+	for (int c = 0; c < NumLifetimeClasses; ++c)  popByClass[c] = mParticles.Ring(c).CountExpired(stepTime);
+	mLastStepStats.numRemoved = 0;
+	for (int type = 0; type < NumFireworkTypes; ++type)  mLastStepStats.numRemovedByType[type] = removeByType[type];
+	for (int c = 0; c < NumLifetimeClasses; ++c)  mLastStepStats.numRemovedByType[static_cast<int>(GetLifetimeClass(c).type)] += popByClass[c];
+	mLastStepStats.numRemovedByType[static_cast<int>(FireworkType::StarSimple)] += numBurstStarsExpired;
+	for (int type = 0; type < NumFireworkTypes; ++type)  mLastStepStats.numRemoved += mLastStepStats.numRemovedByType[type];
+
+	// Instanced bursts are committed ahead of the particles (after making room for launches), as they come from rockets.
+	// Their stars take their share of the particle limit from the pool
+	int numLive = mParticles.Size() + mSpawns[LaunchSpawnBuffer].Size() - mLastStepStats.numRemoved + numBurstStarsExpired;
+	int numBurstStarsAdded = 0, numBurstStarsDropped = 0;
+	for (const auto& spawns : mSpawns)
+	{
+		for (const auto& burst : spawns.bursts)
+		{
+			if (numLive + mBursts.NumStars() + burst.numStars <= mMaxParticles)
+			{
+				mBursts.Add(burst);
+				numBurstStarsAdded += burst.numStars;
+			}
+			else
+			{
+				numBurstStarsDropped += burst.numStars;
+			}
+		}
+	}
+	mParticles.SetMaxParticles(mMaxParticles - mBursts.NumStars());
+
+	// If the new fireworks won't all fit, mark the least visible stars for removal too, when the new ones are worth more
+	mLastStepStats.numEvicted = EvictForSpawnBuffers(mParticles, mSpawns, removeByType, popByClass,
+	                                                 mLastStepStats.numEvictedByType);
+
+	// All columns of all buckets are compacted in one pass using the alive masks. The rings just drop their front
+	mParticles.CompactDead(removeByType, mWorkers);
+	for (int c = 0; c < NumLifetimeClasses; ++c)  mParticles.Ring(c).PopFront(popByClass[c]);
+	auto commitStart = Clock::now();
+
+	// Add all new fireworks (launches first, then chunk order) to their type buckets and rings - the single commit point of the step.
+	// A prefix sum over the buffers' per-type sizes places each buffer, then their columns are copied in parallel
+	int numStaged = 0;
+	for (const auto& spawns : mSpawns)  numStaged += spawns.Size();
+	int firstNew[NumFireworkTypes];
+	int firstNewInRing[NumLifetimeClasses];
+	for (int type = 0; type < NumFireworkTypes; ++type)  firstNew[type] = mParticles.Bucket(static_cast<FireworkType>(type)).Size();
+	for (int c = 0; c < NumLifetimeClasses; ++c)  firstNewInRing[c] = mParticles.Ring(c).Size();
+	mLastStepStats.numDropped = CommitSpawnBuffers(mParticles, mSpawns, mWorkers);
+	mLastStepStats.numSpawned = numStaged - mLastStepStats.numDropped + numBurstStarsAdded;
+	mLastStepStats.numDropped += numBurstStarsDropped;
+	ScheduleExpiries(firstNew);
+	if (mTimeline != nullptr)  RecordSpawns(firstNew, firstNewInRing);
+	auto commitEnd = Clock::now();
+
+	mLastStepStats.numParticles = NumParticles();
+	mLastStepStats.numBursts    = mBursts.NumBursts();
+	mLastStepStats.numChunks        = numChunks;
+	mLastStepStats.numChunksExpired = 0;
+	mLastStepStats.numDeferred      = 0;
+	mLastStepStats.numCapped        = 0;
+	for (const auto& chunk : mChunks)
+	{
+		mLastStepStats.numChunksExpired += mExpiring[static_cast<int>(chunk.type)] ? 1 : 0;
+		mLastStepStats.numDeferred      += chunk.numDeferred;
+		mLastStepStats.numCapped        += chunk.numCapped;
+	}
+	mLastStepStats.updateMs = Milliseconds(removeStart - updateStart).count();
+	mLastStepStats.removeMs = Milliseconds(commitStart - removeStart).count();
+	mLastStepStats.commitMs = Milliseconds(commitEnd   - commitStart).count();
+
+	++mStepNumber;
+}
+
+
+// Remove all fireworks and pending launches and restart the step count
+void FireworkSimulation::Reset()
+{
+	mParticles.Clear();
+	mBursts.Clear();
+	mParticles.SetMaxParticles(mMaxParticles);
+	for (auto& spawns : mSpawns)  spawns.Clear();
+	mStepNumber = 0;
+	mLastStepStats = SimulationStats();
+	mExpiries.Reset();
+	mTime = 0;
+	for (int type = 0; type < NumFireworkTypes; ++type)  mSearchUntil[type] = 0;
+}
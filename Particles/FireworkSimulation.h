@@ -0,0 +1,242 @@
+//--------------------------------------------------------------------------------------
+// The firework simulation - particle pool, per-type update, spawning and removal
+//--------------------------------------------------------------------------------------
+// Everything needed to step the fireworks, with no dependency on Windows or DirectX, so
+// the same code runs in the app and in the headless driver (see Headless/HeadlessMain.cpp).
+// Each step integrates and updates all particles in parallel chunks, removes the dead and
+// commits new particles at a single point, and records how long each phase took.
+// A particle's lifetime is known when it is spawned, so its expiry is scheduled on a timing
+// wheel then. Only buckets with expiries due are searched for bursts and deaths in a step.
+// Stars of a fixed life go to their lifetime class ring instead (see ParticlePool.h), where
+// the dead are always at the front, so they are popped off without any search. With update
+// LOD, groups of simple stars in the rings that are distant or out of view are updated less often.
+// With burst instancing, bursts of simple stars are kept as one record each outside the pool
+// Code in .cpp file
+
+#ifndef _FIREWORK_SIMULATION_H_INCLUDED_
+#define _FIREWORK_SIMULATION_H_INCLUDED_
+
+#include "FireworkTypes.h"
+#include "ParticlePool.h"
+#include "SpawnBuffer.h"
+#include "WorkerPool.h"
+#include "EmissionLod.h"
+#include "Emitter.h"
+#include "UpdateLod.h"
+#include "ParticleTimeline.h"
+#include "BurstInstances.h"
+#include "TimingWheel.h"
+
+#include <vector>
+#include <stdint.h>
+
+
+// How many particles the fireworks emit, from 0 to 1 - lowered to keep the cost down (see BudgetGovernor.h).
+// Rockets themselves are never reduced
+struct EmissionQuality
+{
+	float trailRate  = 1; // Fraction of trail particles emitted by trail stars and comets
+	float burstScale = 1; // Fraction of the stars in each burst (always at least one)
+};
+
+
+// Counts and timings for one simulation step
+struct SimulationStats
+{
+	int numParticles = 0; // After the step, including the stars of instanced bursts
+	int numBursts    = 0; // Instanced bursts after the step
+	int numSpawned   = 0; // New particles committed to the pool
+	int numRemoved   = 0; // Particles that died
+	int numRemovedByType[NumFireworkTypes] = {};
+	int numEvicted   = 0; // Live particles removed to make room for more valuable new ones (see EvictForSpawnBuffers)
+	int numEvictedByType[NumFireworkTypes] = {};
+	int numDropped   = 0; // New particles that did not fit in the pool
+	int numChunks        = 0; // Chunks updated
+	int numChunksExpired = 0; // Chunks from buckets with expiries due, which were searched for bursts and deaths
+	int numDeferred      = 0; // Particles not updated this step because of update LOD, they catch up on a later step
+	int numCapped        = 0; // Trail particles not emitted because of the emitter caps (see SetEmitter and SetEmissionCap)
+
+	// Time spent in each phase, in milliseconds
+	float updateMs = 0; // Integration and per-type events (trails, bursts) for all chunks
+	float removeMs = 0; // Choosing particles to evict and compacting the buckets to remove them and the dead
+	float commitMs = 0; // Copying new particles into the pool
+
+	float TotalMs() const { return updateMs + removeMs + commitMs; }
+};
+
+
+class FireworkSimulation
+{
+public:
+	// Construction //
+
+	// The simulation will not hold more than maxParticles at once, further spawns are dropped
+	FireworkSimulation(int maxParticles);
+
+
+	// Settings //
+
+	// Threads to spread the update over. Pass nullptr to update on the calling thread. The pool is not owned.
+	// Results are the same with any number of threads
+	void        SetWorkerPool(WorkerPool* workers) { mWorkers = workers; }
+	WorkerPool* Workers() const                    { return mWorkers; }
+
+	void  SetGravity(float gravity) { mGravity = gravity; }
+	float Gravity() const           { return mGravity; }
+
+	// Particles emitted by the update are reduced by this. The simulation is only deterministic if it is the same on
+	// every step of every run
+	void                   SetEmissionQuality(const EmissionQuality& quality) { mQuality = quality; }
+	const EmissionQuality& GetEmissionQuality() const                         { return mQuality; }
+
+	// Emission LOD: trails and bursts emit fewer, bigger particles the smaller they are on screen from the given view (see
+	// EmissionLod.h). Off by default. Like the quality, the view must be the same on every run for the same results
+	void SetEmissionView(const EmissionView& view) { mEmissionView = view;  mUseEmissionView = true; }
+	void ClearEmissionView()                       { mUseEmissionView = false; }
+	bool UsingEmissionView() const                 { return mUseEmissionView; }
+
+	// Emitters: how trail stars and comets emit their trails (see Emitter.h). Only those two types have emitters. Each
+	// emitter is limited by its desc's maxPerStep, and all of them together by the emission cap: the most trail particles
+	// emitted in a step, -1 (the default) for none. Like the quality, these change the results. SetEmitter returns false
+	// and keeps the old emitter if the desc isn't valid (see IsValidEmitter)
+	bool               SetEmitter(FireworkType type, const EmitterDesc& desc)
+	{
+		if (!IsValidEmitter(desc))  return false;
+		mEmitters[static_cast<int>(type)] = desc;
+		return true;
+	}
+	const EmitterDesc& GetEmitter(FireworkType type) const                    { return mEmitters[static_cast<int>(type)]; }
+	void SetEmissionCap(int maxPerStep) { mEmissionCap = maxPerStep; }
+	int  EmissionCap() const            { return mEmissionCap; }
+
+	// Update LOD: simple stars that are small on screen or out of view from the given view are updated every few steps
+	// (see UpdateLod.h). Off by default. Also changes the results, so the view must be the same on every run
+	void SetUpdateLodView(const UpdateLodView& view) { mUpdateLodView = view;  mUseUpdateLodView = true; }
+	void ClearUpdateLodView()                        { mUseUpdateLodView = false; }
+	bool UsingUpdateLodView() const                  { return mUseUpdateLodView; }
+
+	// Burst instancing: bursts of simple stars are kept as one record each, with their stars' positions worked out from a
+	// shared offset table when drawn (see BurstInstances.h). Off by default. Bursts already made are not changed when it is
+	// switched. The stars look different from those of a normal burst, so it must be the same on every run
+	void SetBurstInstancing(bool instance) { mInstanceBursts = instance; }
+	bool UsingBurstInstancing() const      { return mInstanceBursts; }
+
+	// Record every particle committed from now on in the given timeline, in its spawn state (see ParticleTimeline.h), so
+	// the show can be evaluated at any time afterwards. Pass nullptr to stop. The timeline is not owned. Stars of instanced
+	// bursts are not recorded
+	void              SetTimeline(ParticleTimeline* timeline) { mTimeline = timeline; }
+	ParticleTimeline* Timeline() const                        { return mTimeline; }
+
+
+	// Launching //
+
+	// Buffer for launches from outside the update (UI, scripted shows, replays). Its contents are committed at the
+	// end of the next step, before anything spawned during that step
+	SpawnBuffer& Launches() { return mSpawns[LaunchSpawnBuffer]; }
+
+
+	// Update //
+
+	// Advance all fireworks by stepTime. The simulation is deterministic given the same launches on the same steps
+	void Step(float stepTime);
+
+	// Remove all fireworks and pending launches and restart the step count
+	void Reset();
+
+	// Particles must only be added through Launches() (or by the update), which schedules their expiry. A particle added
+	// straight to the pool may not die until a particle of its type spawned through the simulation expires
+
+
+	// Data access //
+
+	ParticlePool&       Particles()       { return mParticles; }
+	const ParticlePool& Particles() const { return mParticles; }
+
+	// Instanced bursts, which are drawn as well as the particles. The pool and the bursts together hold no more than
+	// maxParticles: the pool's own limit is lowered by the stars of the bursts
+	BurstInstances&       Bursts()       { return mBursts; }
+	const BurstInstances& Bursts() const { return mBursts; }
+
+	// Particles in the pool plus stars of instanced bursts - the number of vertices to draw
+	int NumParticles() const { return mParticles.Size() + mBursts.NumStars(); }
+
+	// Number of steps run since the last reset. Keys the particles' random numbers together with their ids
+	uint32_t StepNumber() const { return mStepNumber; }
+
+	// Simulated time at the end of the last step - the time particles committed in that step were spawned
+	double Time() const { return mTime; }
+
+	const SimulationStats& LastStepStats() const { return mLastStepStats; }
+
+
+private:
+	// The update is split into fixed-size chunks of particles that are spread across the worker threads. A chunk only
+	// holds particles of one type. Particles spawned during the update go into the chunk's own spawn buffer. Chunks are
+	// a fixed size, not one per thread, so the result is the same whatever the number of threads
+	static const int ChunkSize = 4096;
+
+	struct Chunk
+	{
+		FireworkType type;
+		int          begin; // Range of particles in the type's bucket, or in one block of the ring
+		int          end;
+		int          numDead; // Set by the update, which also fills in the chunk's part of the bucket's alive mask
+		int          ring;    // Lifetime class of the ring the chunk is in, -1 for the type's bucket
+		int          block;   // Block of the ring
+		int          numDeferred; // Particles left for a later step by update LOD
+		int          maxEmitted;  // Chunk's share of the emission cap, -1 for no cap
+		int          numCapped;   // Emissions skipped because of the caps
+	};
+
+	static bool IsEmitterType(FireworkType type);
+
+	// Launches are committed first, then the chunk buffers in chunk order. Chunks are made in the order of the types
+	// below, so if the pool fills up, bursts from rockets are kept ahead of the trails from stars
+	static const int LaunchSpawnBuffer = 0;
+	static const FireworkType ChunkOrder[NumFireworkTypes];
+
+	void UpdateChunk(int chunkIndex, float stepTime, SpawnBuffer& spawns);
+
+	// Expiry schedule. Each new particle's expiry time (time of spawn + life) is put on a timing wheel, and when it comes
+	// round the particle's bucket is searched for deaths (and bursts, for rockets) until just after that time. Life is
+	// counted down in floats, a step at a time, so a particle can die slightly before or after its expiry time - the
+	// search starts ExpiryMargin early and ends ExpiryMargin late, far more than the drift over lives of a few seconds.
+	// Nearby expiries share an event: all the stars of a burst expire together, as do all trails emitted in a step
+	static constexpr double ExpiryTickTime = 1.0 / 128;
+	static constexpr double ExpiryMargin   = 0.01;
+
+	// Advance the wheel to the end of this step and choose which buckets to search. Schedule the new particles after commit
+	void FireExpiries(double stepStart, double stepEnd);
+	void ScheduleExpiries(const int* firstNew);
+
+	// Add the particles committed this step to the timeline
+	void RecordSpawns(const int* firstNew, const int* firstNewInRing);
+
+	ParticlePool             mParticles;
+	BurstInstances           mBursts;
+	std::vector<Chunk>       mChunks; // Rebuilt each step
+	std::vector<SpawnBuffer> mSpawns;
+	WorkerPool*              mWorkers    = nullptr;
+	float                    mGravity    = -30.0f; // Tweaked to make getting nice firework settings easier
+	EmissionQuality          mQuality;
+	EmitterDesc              mEmitters[NumFireworkTypes];
+	int                      mEmissionCap = -1;
+	EmissionView             mEmissionView;
+	bool                     mUseEmissionView = false;
+	UpdateLodView            mUpdateLodView;
+	bool                     mUseUpdateLodView = false;
+	ParticleTimeline*        mTimeline   = nullptr;
+	bool                     mInstanceBursts = false;
+	int                      mMaxParticles;
+	uint32_t                 mStepNumber = 0;
+
+	TimingWheel                     mExpiries;
+	std::vector<TimingWheel::Event> mFiredExpiries;
+	double                          mTime = 0; // Simulated time at the end of the last step
+	double                          mSearchUntil[NumFireworkTypes] = {}; // Search each bucket for deaths until this time
+	bool                            mExpiring   [NumFireworkTypes] = {}; // Search each bucket in this step
+	SimulationStats          mLastStepStats;
+};
+
+
+#endif //_FIREWORK_SIMULATION_H_INCLUDED_
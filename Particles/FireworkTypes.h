@@ -0,0 +1,114 @@
+//--------------------------------------------------------------------------------------
+// Firework types and the per-particle data structures used to spawn and render them
+//--------------------------------------------------------------------------------------
+
+#ifndef _FIREWORK_TYPES_H_INCLUDED_
+#define _FIREWORK_TYPES_H_INCLUDED_
+
+#include "CVector3.h"
+#include "ColourRGBA.h"
+
+#include <stdint.h>
+
+
+// TODO: You will be adding more firework types here as required from the assessment brief
+enum class FireworkType : uint8_t { PeonyRocket, FancyPeonyRocket, StarSimple, StarSmallTrail, CometRocket, BrocadeRocket};
+
+// Number of entries in the enum above, keep up to date when adding types
+const int NumFireworkTypes = 6;
+
+// Name of a firework type for display and reports, keep up to date when adding types
+inline const char* FireworkTypeName(FireworkType type)
+{
+	static const char* const names[NumFireworkTypes] = { "PeonyRocket", "FancyPeonyRocket", "StarSimple", "StarSmallTrail",
+	                                                     "CometRocket", "BrocadeRocket" };
+	return names[static_cast<int>(type)];
+}
+
+
+
+// Lifetime classes - particles of one type that are always spawned with the same life. They are spawned in order and all
+// age at the same rate, so they also die in order: the ParticlePool keeps each class in a FIFO ring (see ParticleRing.h)
+// and removes the dead from the front, with no compaction. Spawn them with exactly the life given here
+const float TrailSparkLife  = 0.4f; // Trails of trail stars and comets
+const float PeonyStarLife   = 1.4f; // Peony burst stars, of whichever star type the rocket's payload holds
+const float BrocadeStarLife = 7.0f; // Brocade burst stars
+
+struct LifetimeClass
+{
+	FireworkType type;
+	float        life;
+	const char*  name;
+};
+
+// Keep the number up to date when adding classes
+const int NumLifetimeClasses = 4;
+inline const LifetimeClass& GetLifetimeClass(int lifetimeClass)
+{
+	static const LifetimeClass classes[NumLifetimeClasses] = { { FireworkType::StarSimple,     TrailSparkLife,  "TrailSpark"     },
+	                                                           { FireworkType::StarSimple,     PeonyStarLife,   "PeonyStar"      },
+	                                                           { FireworkType::StarSmallTrail, PeonyStarLife,   "PeonyTrailStar" },
+	                                                           { FireworkType::StarSmallTrail, BrocadeStarLife, "BrocadeStar"    } };
+	return classes[lifetimeClass];
+}
+
+// Lifetime class of particles of the given type spawned with the given life, or -1 if there isn't one
+inline int FindLifetimeClass(FireworkType type, float life)
+{
+	for (int c = 0; c < NumLifetimeClasses; ++c)
+	{
+		if (GetLifetimeClass(c).type == type && GetLifetimeClass(c).life == life)  return c;
+	}
+	return -1;
+}
+
+
+// Data only needed to update a firework. Enough data here already for basic fireworks. You *might* want to add other data members, but it isn't initially necessary
+// Each firework is made of parts. E.g a Peony firework starts with a single PeonyRocket particle that shoots into
+//                                 the air, when its life runs out it emits a large number of PeonyStar particles in random directions
+//                                 The number and colour of PeonyStar particles is held in the payload variables
+// This structure is only used to describe a particle when spawning it, the ParticleStore keeps the same data in separate columns
+struct FireworkUpdate
+{
+	FireworkType type;     // Firework type from enum above
+	uint32_t     id;       // Identifies the particle, keys its random numbers (see CounterRandom.h). Set by the spawning code
+	CVector3     velocity; // World velocity of particle
+
+	float        life;     // Current life of particle (seconds)
+	float        timer;    // Internal timer for triggering events in flight, can be unused (see StarSmallTrail for example of use)
+
+	FireworkType payloadTypeA;   // Information about firework payload - usage depends on firework type, can be unused
+	FireworkType payloadTypeB;   //
+	int          payloadIntA;    //
+	int          payloadIntB;    //
+	ColourRGBA   payloadColourA; //
+	ColourRGBA   payloadColourB; //
+};
+
+
+// The payload part of FireworkUpdate. Only read when a rocket bursts, so the ParticleStore keeps it in its own
+// column, away from the data touched every frame
+struct FireworkPayload
+{
+	FireworkType typeA;
+	FireworkType typeB;
+	int          intA;
+	int          intB;
+	ColourRGBA   colourA;
+	ColourRGBA   colourB;
+};
+
+
+// Data to render a firework, updated using data above in C++, then packed (see PackedFirework.h) and sent over to GPU for
+// rendering. Unlikely to need to change this. Has the same fields as the Firework struct in Common.hlsli, which the vertex
+// shader unpacks into
+struct Firework
+{
+	CVector3   position; // World position of the firework
+	float      scale;    // Scale of firework for rendering
+	ColourRGBA colour;   // RGBA colour - A is transparency
+	float      rotation; // Z rotation of particle
+};
+
+
+#endif //_FIREWORK_TYPES_H_INCLUDED_
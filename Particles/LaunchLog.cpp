@@ -0,0 +1,164 @@
+//--------------------------------------------------------------------------------------
+// Recording and replay of firework launches
+//--------------------------------------------------------------------------------------
+
+#include "LaunchLog.h"
+
+#include <fstream>
+#include <cstring>
+
+
+// File layout (little-endian):
+//   Header: "FWLG", uint32 version, float step time, uint32 event count
+//   Events: uint32 step, uint8 kind, uint8 rocket count, uint16 burst particles, float position[3], float colour[4],
+//           float scale, float rotation, float initial velocity, float burst life, uint32 seed    (56 bytes each)
+const char     LogMagic[4] = { 'F', 'W', 'L', 'G' };
+const uint32_t LogVersion  = 1;
+const int      EventBytes  = 56;
+
+
+// Helpers to read and write fixed-size values through a byte pointer
+template <class T> static void Write(char*& p, T value)  { memcpy(p, &value, sizeof(T));  p += sizeof(T); }
+template <class T> static T    Read (const char*& p)     { T value;  memcpy(&value, p, sizeof(T));  p += sizeof(T);  return value; }
+
+
+bool LaunchLog::Save(const std::string& fileName)
+{
+	std::ofstream file(fileName, std::ios::binary);
+	if (!file)
+	{
+		mLastError = "Error creating launch log " + fileName;
+		return false;
+	}
+
+	char header[16];
+	char* p = header;
+	memcpy(p, LogMagic, sizeof(LogMagic));  p += sizeof(LogMagic);
+	Write<uint32_t>(p, LogVersion);
+	Write<float>   (p, mStepTime);
+	Write<uint32_t>(p, static_cast<uint32_t>(mEvents.size()));
+	file.write(header, sizeof(header));
+
+	std::vector<char> events(mEvents.size() * EventBytes);
+	p = events.data();
+	for (const auto& event : mEvents)
+	{
+		const LaunchParams& params = event.params;
+		Write<uint32_t>(p, event.step);
+		Write<uint8_t> (p, static_cast<uint8_t>(params.kind));
+		Write<uint8_t> (p, static_cast<uint8_t>(params.numFireworks));
+		Write<uint16_t>(p, static_cast<uint16_t>(params.burstParticles));
+		Write<float>(p, params.position.x);  Write<float>(p, params.position.y);  Write<float>(p, params.position.z);
+		Write<float>(p, params.colour.r);    Write<float>(p, params.colour.g);
+		Write<float>(p, params.colour.b);    Write<float>(p, params.colour.a);
+		Write<float>(p, params.scale);
+		Write<float>(p, params.rotation);
+		Write<float>(p, params.initialVelocity);
+		Write<float>(p, params.burstLife);
+		Write<uint32_t>(p, params.seed);
+	}
+	file.write(events.data(), events.size());
+
+	if (!file)
+	{
+		mLastError = "Error writing launch log " + fileName;
+		return false;
+	}
+	return true;
+}
+
+
+bool LaunchLog::Load(const std::string& fileName)
+{
+	std::ifstream file(fileName, std::ios::binary);
+	if (!file)
+	{
+		mLastError = "Error opening launch log " + fileName;
+		return false;
+	}
+
+	char header[16];
+	if (!file.read(header, sizeof(header)) || memcmp(header, LogMagic, sizeof(LogMagic)) != 0)
+	{
+		mLastError = fileName + " is not a launch log";
+		return false;
+	}
+	const char* p = header + sizeof(LogMagic);
+	uint32_t version   = Read<uint32_t>(p);
+	float    stepTime  = Read<float>(p);
+	uint32_t numEvents = Read<uint32_t>(p);
+	if (version != LogVersion)
+	{
+		mLastError = "Unsupported launch log version in " + fileName;
+		return false;
+	}
+
+	// The count comes from the file, so check the rest of the file holds exactly that many events before allocating for
+	// them - a corrupt count could ask for far more memory than there is
+	std::streamoff eventsStart = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff eventsEnd = file.tellg();
+	file.seekg(eventsStart);
+	if (!file || eventsStart < 0 || eventsEnd < eventsStart)
+	{
+		mLastError = "Error reading launch log " + fileName;
+		return false;
+	}
+	uint64_t eventsSize = static_cast<uint64_t>(numEvents) * EventBytes;
+	if (eventsSize != static_cast<uint64_t>(eventsEnd - eventsStart))
+	{
+		mLastError = eventsSize > static_cast<uint64_t>(eventsEnd - eventsStart) ? "Launch log " + fileName + " is truncated"
+		                                                                          : "Launch log " + fileName + " has data after its launches";
+		return false;
+	}
+
+	std::vector<char> events(static_cast<size_t>(eventsSize));
+	if (!file.read(events.data(), events.size()))
+	{
+		mLastError = "Launch log " + fileName + " is truncated";
+		return false;
+	}
+
+	mStepTime = stepTime;
+	mEvents.resize(numEvents);
+	p = events.data();
+	for (auto& event : mEvents)
+	{
+		LaunchParams& params = event.params;
+		event.step            = Read<uint32_t>(p);
+		params.kind           = static_cast<LaunchKind>(Read<uint8_t>(p));
+		params.numFireworks   = Read<uint8_t>(p);
+		params.burstParticles = Read<uint16_t>(p);
+		params.position.x = Read<float>(p);  params.position.y = Read<float>(p);  params.position.z = Read<float>(p);
+		params.colour.r   = Read<float>(p);  params.colour.g   = Read<float>(p);
+		params.colour.b   = Read<float>(p);  params.colour.a   = Read<float>(p);
+		params.scale           = Read<float>(p);
+		params.rotation        = Read<float>(p);
+		params.initialVelocity = Read<float>(p);
+		params.burstLife       = Read<float>(p);
+		params.seed            = Read<uint32_t>(p);
+
+		if (static_cast<int>(params.kind) >= NumLaunchKinds)
+		{
+			mLastError = "Unknown launch kind in " + fileName;
+			mEvents.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Create the rockets of all launches on the given step in the spawn buffer
+int LaunchReplay::Play(uint32_t step, SpawnBuffer& spawns)
+{
+	const auto& events = mLog->Events();
+	int played = 0;
+	while (mNext < static_cast<int>(events.size()) && events[mNext].step <= step)
+	{
+		LaunchFireworks(events[mNext].params, spawns);
+		++mNext;
+		++played;
+	}
+	return played;
+}
@@ -0,0 +1,97 @@
+//--------------------------------------------------------------------------------------
+// Recording and replay of firework launches
+//--------------------------------------------------------------------------------------
+// Every launch is recorded with the simulation step it happened on. Replaying the log from
+// a cleared simulation at the same fixed step time gives exactly the same show, so frame
+// time and particle count profiles can be compared between builds on identical workloads.
+// Logs are saved in a compact binary format (see LaunchLog.cpp)
+// Code in .cpp file
+
+#ifndef _LAUNCH_LOG_H_INCLUDED_
+#define _LAUNCH_LOG_H_INCLUDED_
+
+#include "FireworkLaunch.h"
+
+#include <string>
+#include <vector>
+
+
+// One recorded launch
+struct LaunchEvent
+{
+	uint32_t     step;   // Simulation step the launch is committed on
+	LaunchParams params;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Launch log
+//--------------------------------------------------------------------------------------
+
+class LaunchLog
+{
+public:
+	// Construction //
+
+	// stepTime is the fixed simulation step the log is recorded at - replays must use the same
+	LaunchLog(float stepTime = 1.0f / 60.0f) : mStepTime(stepTime) {}
+
+
+	// Recording //
+
+	// Clear the log ready to record at the given step time
+	void Clear(float stepTime) { mEvents.clear(); mStepTime = stepTime; }
+
+	// Add a launch. Steps must not decrease
+	void Add(uint32_t step, const LaunchParams& params) { mEvents.push_back({ step, params }); }
+
+
+	// Access //
+
+	float StepTime() const { return mStepTime; }
+	int   Size()     const { return static_cast<int>(mEvents.size()); }
+
+	const std::vector<LaunchEvent>& Events() const { return mEvents; }
+
+
+	// Files //
+
+	// Save / load the log in binary form. Return false on failure, with a message in LastError()
+	bool Save(const std::string& fileName);
+	bool Load(const std::string& fileName);
+
+	const std::string& LastError() const { return mLastError; }
+
+
+private:
+	float mStepTime;
+	std::vector<LaunchEvent> mEvents;
+	std::string mLastError;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Replay
+//--------------------------------------------------------------------------------------
+
+class LaunchReplay
+{
+public:
+	// Replay the given log (which must stay alive) from its start
+	LaunchReplay(const LaunchLog& log) : mLog(&log), mNext(0) {}
+
+	// Create the rockets of all launches on the given step in the spawn buffer. Call once per step, with steps in
+	// order, before the step is simulated. Returns the number of launches played
+	int Play(uint32_t step, SpawnBuffer& spawns);
+
+	// True when every launch in the log has been played
+	bool Finished() const { return mNext >= mLog->Size(); }
+
+
+private:
+	const LaunchLog* mLog;
+	int              mNext; // Next event to play
+};
+
+
+#endif //_LAUNCH_LOG_H_INCLUDED_
@@ -0,0 +1,92 @@
+//--------------------------------------------------------------------------------------
+// Packed firework vertex - the compact form of the Firework struct sent to the GPU
+//--------------------------------------------------------------------------------------
+
+#include "PackedFirework.h"
+
+#include <cmath>
+#include <cstring>
+
+
+float HalfToFloat(uint16_t half)
+{
+	uint32_t sign     = static_cast<uint32_t>(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1f;
+	uint32_t mantissa = half & 0x3ff;
+
+	uint32_t bits;
+	if (exponent == 31)
+	{
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	}
+	else if (exponent == 0)
+	{
+		float value = std::ldexp(static_cast<float>(mantissa), -24);
+		return sign ? -value : value;
+	}
+	else
+	{
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+void PackFireworks(const Firework* vertices, int count, const PackedVertexSpan& packed)
+{
+	for (int i = 0; i < count; ++i)  packed.vertices[i] = PackFirework(vertices[i], packed.origin);
+}
+
+
+Firework UnpackFirework(const PackedFirework& packed, const CVector3& origin)
+{
+	float scale = ((packed.positionZSize >> 16) & 0xff) / 255.0f;
+
+	Firework vertex;
+	vertex.position.x = origin.x + HalfToFloat(static_cast<uint16_t>(packed.positionXY));
+	vertex.position.y = origin.y + HalfToFloat(static_cast<uint16_t>(packed.positionXY >> 16));
+	vertex.position.z = origin.z + HalfToFloat(static_cast<uint16_t>(packed.positionZSize));
+	vertex.scale      = scale * scale * MaxPackedScale;
+	vertex.colour.r   = ( packed.colour        & 0xff) / 255.0f;
+	vertex.colour.g   = ((packed.colour >>  8) & 0xff) / 255.0f;
+	vertex.colour.b   = ((packed.colour >> 16) & 0xff) / 255.0f;
+	vertex.colour.a   = ( packed.colour >> 24        ) / 255.0f;
+	vertex.rotation   = (packed.positionZSize >> 24) * (360.0f / 256.0f);
+	return vertex;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Gathers
+//--------------------------------------------------------------------------------------
+
+void GatherPackedVertices(const ParticleSpan& p, float interpolation, const PackedVertexSpan& vertices)
+{
+	for (int i = 0; i < p.count; ++i)
+	{
+		vertices.vertices[i] = PackFirework(p.prevX[i] + (p.posX[i] - p.prevX[i]) * interpolation,
+		                                    p.prevY[i] + (p.posY[i] - p.prevY[i]) * interpolation,
+		                                    p.prevZ[i] + (p.posZ[i] - p.prevZ[i]) * interpolation,
+		                                    p.scale[i], p.colourR[i], p.colourG[i], p.colourB[i], p.colourA[i], p.rotation[i],
+		                                    vertices.origin);
+	}
+}
+
+
+int GatherVisiblePackedVertices(const ParticleSpan& p, const uint8_t* visible, float interpolation, const PackedVertexSpan& vertices)
+{
+	int numWritten = 0;
+	for (int i = 0; i < p.count; ++i)
+	{
+		if (!visible[i])  continue;
+
+		vertices.vertices[numWritten++] = PackFirework(p.prevX[i] + (p.posX[i] - p.prevX[i]) * interpolation,
+		                                               p.prevY[i] + (p.posY[i] - p.prevY[i]) * interpolation,
+		                                               p.prevZ[i] + (p.posZ[i] - p.prevZ[i]) * interpolation,
+		                                               p.scale[i], p.colourR[i], p.colourG[i], p.colourB[i], p.colourA[i],
+		                                               p.rotation[i], vertices.origin);
+	}
+	return numWritten;
+}
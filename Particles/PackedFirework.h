@@ -0,0 +1,161 @@
+//--------------------------------------------------------------------------------------
+// Packed firework vertex - the compact form of the Firework struct sent to the GPU
+//--------------------------------------------------------------------------------------
+// The Firework struct is 36 bytes of floats. The vertex buffer holds 12-byte packed vertices
+// instead, which the vertex shader unpacks again. See PackedFireworkLayout.h for the fields,
+// which are shared with the shaders and the D3D input layout. The gathers here write packed
+// vertices straight from the particle columns into a PackedVertexSpan - the mapped vertex
+// buffer in the app, or any memory - so the render data is written once, with no Firework
+// array in between. The particle pool and burst instances have gathers that use these
+// Code in .cpp file, apart from the packing of a single vertex, which is inline for the gathers
+
+#ifndef _PACKED_FIREWORK_H_INCLUDED_
+#define _PACKED_FIREWORK_H_INCLUDED_
+
+#include "FireworkTypes.h"
+#include "ParticleStore.h"
+#include "PackedFireworkLayout.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+// Bytes taken by each DXGI format used in the layout, by the name used in PackedFireworkLayout.h. Kept here so the sizes
+// can be checked without the D3D headers. A new format in the layout must be added here too
+const int PackedFormatSize_R32_UINT       = 4;
+const int PackedFormatSize_R8G8B8A8_UNORM = 4;
+
+
+// Packed firework vertex, one member per field of the layout
+struct PackedFirework
+{
+#define PACKED_FIREWORK_FIELD(cppType, hlslType, name, format)  cppType name;
+	PACKED_FIREWORK_FIELDS
+#undef PACKED_FIREWORK_FIELD
+};
+
+// Each member must be the size of its format, and the members must fill the struct with no padding, so the offsets of
+// the members (given to D3D) are the offsets the formats imply
+#define PACKED_FIREWORK_FIELD(cppType, hlslType, name, format) \
+	static_assert(sizeof(PackedFirework::name) == PackedFormatSize_##format, "PackedFirework::" #name " is not the size of DXGI_FORMAT_" #format);
+PACKED_FIREWORK_FIELDS
+#undef PACKED_FIREWORK_FIELD
+
+#define PACKED_FIREWORK_FIELD(cppType, hlslType, name, format)  + PackedFormatSize_##format
+static_assert(sizeof(PackedFirework) == 0 PACKED_FIREWORK_FIELDS, "PackedFirework has padding between its fields");
+#undef PACKED_FIREWORK_FIELD
+
+// Number of fields, for the D3D input layout
+#define PACKED_FIREWORK_FIELD(cppType, hlslType, name, format)  + 1
+const int NumPackedFireworkFields = 0 PACKED_FIREWORK_FIELDS;
+#undef PACKED_FIREWORK_FIELD
+
+const float MaxPackedScale = PACKED_FIREWORK_MAX_SCALE;
+
+
+// Where packed vertices are written: usually mapped GPU memory, which is write-combined, so each vertex is written in
+// full and in order
+struct PackedVertexSpan
+{
+	PackedFirework* vertices;
+	int             size;   // Space for this many vertices
+	CVector3        origin; // Positions are packed relative to this
+
+	// The rest of the span after the first n vertices
+	PackedVertexSpan Skip(int n) const { return { vertices + n, size - n, origin }; }
+};
+
+
+//--------------------------------------------------------------------------------------
+// Packing
+//--------------------------------------------------------------------------------------
+
+// Half float conversion. Floats too big for a half are clamped to the largest half, and round to nearest even
+inline uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign     = static_cast<uint16_t>((bits >> 16) & 0x8000);
+	uint32_t absBits  = bits & 0x7fffffff;
+	int      exponent = static_cast<int>(absBits >> 23) - 127 + 15;
+	uint32_t mantissa = absBits & 0x7fffff;
+
+	if (absBits > 0x7f800000)  return sign | 0x7e00; // NaN
+	if (exponent >= 31)        return sign | 0x7bff; // Too big (or infinite), clamp to the largest half
+	if (exponent <= 0)
+	{
+		// Denormal half, or zero if too small even for that
+		if (exponent < -10)  return sign;
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		uint32_t half      = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway   = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1)))  ++half;
+		return sign | static_cast<uint16_t>(half);
+	}
+
+	// Rounding up can carry into the exponent, which gives the right result unless it reaches infinity
+	uint32_t half      = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1fff;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))  ++half;
+	return sign | static_cast<uint16_t>(std::min(half, 0x7bffu));
+}
+
+float HalfToFloat(uint16_t half);
+
+// Values in [0, 1] to 8 bits, rounded
+inline uint32_t PackUnorm8(float value)
+{
+	value = std::min(std::max(value, 0.0f), 1.0f); // Also turns NaN into 0
+	return static_cast<uint32_t>(value * 255.0f + 0.5f);
+}
+
+// Pack one vertex with its position relative to the given origin. Colours are clamped to [0, 1], scales are packed by
+// size (a negative scale draws the same quad) and clamped to MaxPackedScale
+inline PackedFirework PackFirework(float x, float y, float z, float scale, float r, float g, float b, float a, float rotation,
+                                   const CVector3& origin)
+{
+	uint32_t packedX = FloatToHalf(x - origin.x);
+	uint32_t packedY = FloatToHalf(y - origin.y);
+	uint32_t packedZ = FloatToHalf(z - origin.z);
+	uint32_t packedScale = PackUnorm8(std::sqrt(std::min(std::fabs(scale), MaxPackedScale) / MaxPackedScale));
+	float    turns = rotation / 360.0f;
+	uint32_t packedRotation = static_cast<uint32_t>(static_cast<int>(std::floor((turns - std::floor(turns)) * 256.0f + 0.5f)) & 0xff);
+
+	PackedFirework packed;
+	packed.positionXY    = packedX | (packedY << 16);
+	packed.positionZSize = packedZ | (packedScale << 16) | (packedRotation << 24);
+	packed.colour        = PackUnorm8(r) | (PackUnorm8(g) << 8) | (PackUnorm8(b) << 16) | (PackUnorm8(a) << 24);
+	return packed;
+}
+
+inline PackedFirework PackFirework(const Firework& vertex, const CVector3& origin)
+{
+	return PackFirework(vertex.position.x, vertex.position.y, vertex.position.z, vertex.scale,
+	                    vertex.colour.r, vertex.colour.g, vertex.colour.b, vertex.colour.a, vertex.rotation, origin);
+}
+
+// Pack an array of vertices into the start of the span
+void PackFireworks(const Firework* vertices, int count, const PackedVertexSpan& packed);
+
+// Unpack a vertex as the vertex shader does, for checking the precision of the packing
+Firework UnpackFirework(const PackedFirework& packed, const CVector3& origin);
+
+
+//--------------------------------------------------------------------------------------
+// Gathers
+//--------------------------------------------------------------------------------------
+
+// Write the render data of the particles packed into the start of the span, which must have space for them all. As
+// GatherVertices in ParticleStore.h otherwise
+void GatherPackedVertices(const ParticleSpan& particles, float interpolation, const PackedVertexSpan& vertices);
+
+// As above for just the visible particles, see GatherVisibleVertices in ParticleCulling.h. Returns the number written
+int GatherVisiblePackedVertices(const ParticleSpan& particles, const uint8_t* visible, float interpolation,
+                                const PackedVertexSpan& vertices);
+
+
+#endif //_PACKED_FIREWORK_H_INCLUDED_
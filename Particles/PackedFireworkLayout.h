@@ -0,0 +1,29 @@
+//--------------------------------------------------------------------------------------
+// Layout of the packed firework vertex - the one definition shared by C++ and the shaders
+//--------------------------------------------------------------------------------------
+// Each field of the vertex sent to the GPU is listed once below, with its C++ type, its
+// HLSL type, its name (also used as the shader semantic) and its DXGI format. The C++
+// PackedFirework struct (PackedFirework.h), the D3D input layout (ParticleElts in Scene.cpp)
+// and the HLSL PackedFirework struct (Common.hlsli) are all built from this list, so they
+// can't get out of step, and PackedFirework.h checks each C++ field against the size of its
+// format at compile time. This file is included by the shader compiler as well as the C++
+// compiler, so it must only contain preprocessor definitions
+//
+// Positions are half floats relative to an origin set each frame (gFireworkOrigin), so
+// they are most precise near the camera. Scale is 8 bits, stored as the square root of
+// scale / PACKED_FIREWORK_MAX_SCALE so small particles get the finer steps, and rotation
+// is 8 bits over a full turn (in degrees, as the Firework struct)
+
+#ifndef _PACKED_FIREWORK_LAYOUT_H_INCLUDED_
+#define _PACKED_FIREWORK_LAYOUT_H_INCLUDED_
+
+// PACKED_FIREWORK_FIELD(C++ type, HLSL type, name and semantic, DXGI format without the DXGI_FORMAT_ prefix)
+#define PACKED_FIREWORK_FIELDS \
+	PACKED_FIREWORK_FIELD(uint32_t, uint,   positionXY,    R32_UINT)       /* Half float x in the low 16 bits, y in the high */ \
+	PACKED_FIREWORK_FIELD(uint32_t, uint,   positionZSize, R32_UINT)       /* Half float z, then 8-bit scale, then 8-bit rotation */ \
+	PACKED_FIREWORK_FIELD(uint32_t, float4, colour,        R8G8B8A8_UNORM) /* RGBA colour, 8 bits each */
+
+// Largest scale that can be packed, bigger scales are clamped to it
+#define PACKED_FIREWORK_MAX_SCALE 8.0f
+
+#endif //_PACKED_FIREWORK_LAYOUT_H_INCLUDED_
@@ -0,0 +1,253 @@
+//--------------------------------------------------------------------------------------
+// Particle culling before upload - skip particles that cannot be seen
+//--------------------------------------------------------------------------------------
+
+#include "ParticleCulling.h"
+#include "ParticleKernels.h"
+
+#include <cmath>
+#include <bit>
+
+#if SIMD_X86_AVAILABLE
+	#include <immintrin.h>
+#endif
+
+
+CullView MakeCullView(const CMatrix4x4& viewMatrix, const CMatrix4x4& projectionMatrix, float viewportWidth)
+{
+	// With row vectors the clip space position is p * viewProjection, so x, y, z and w come from the matrix columns.
+	// The D3D frustum is -w <= x <= w, -w <= y <= w and 0 <= z <= w, which gives the planes w+x, w-x, w+y, w-y, z, w-z
+	CMatrix4x4 m = viewMatrix * projectionMatrix;
+	const float x[4] = { m.e00, m.e10, m.e20, m.e30 };
+	const float y[4] = { m.e01, m.e11, m.e21, m.e31 };
+	const float z[4] = { m.e02, m.e12, m.e22, m.e32 };
+	const float w[4] = { m.e03, m.e13, m.e23, m.e33 };
+
+	CullView view;
+	for (int i = 0; i < 4; ++i)
+	{
+		view.planes[0][i] = w[i] + x[i];
+		view.planes[1][i] = w[i] - x[i];
+		view.planes[2][i] = w[i] + y[i];
+		view.planes[3][i] = w[i] - y[i];
+		view.planes[4][i] = z[i];
+		view.planes[5][i] = w[i] - z[i];
+		view.depth[i]     = w[i];
+	}
+
+	// Normalise the planes so the tests give distances in world units, which can be compared with the particle size
+	for (auto& plane : view.planes)
+	{
+		float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		for (float& value : plane)  value /= length;
+	}
+
+	view.pixelsPerUnit = projectionMatrix.e00 * viewportWidth * 0.5f;
+	return view;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Visibility mask
+//--------------------------------------------------------------------------------------
+// A particle is outside if its sphere is entirely behind any frustum plane. A particle inside is drawn if its alpha is
+// positive and alpha * size in pixels (scale * pixelsPerUnit / depth) is over the threshold - the test is multiplied
+// through by the depth to avoid a divide. Each version does the same operations in the same order as the scalar one
+
+// Scalar test of particles [begin, end) - also used for the tail of the SIMD versions
+static void BuildVisibleMaskScalar(const ParticleSpan& p, float t, const CullView& view, uint8_t* visible,
+                                   int begin, int end, CullCounts& counts)
+{
+	for (int i = begin; i < end; ++i)
+	{
+		float x = p.prevX[i] + (p.posX[i] - p.prevX[i]) * t;
+		float y = p.prevY[i] + (p.posY[i] - p.prevY[i]) * t;
+		float z = p.prevZ[i] + (p.posZ[i] - p.prevZ[i]) * t;
+		float size = std::fabs(p.scale[i]);
+		float radius = size * QuadRadius;
+
+		bool outside = false;
+		for (const auto& plane : view.planes)
+		{
+			outside |= plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < -radius;
+		}
+
+		float depth = view.depth[0] * x + view.depth[1] * y + view.depth[2] * z + view.depth[3];
+		float alpha = p.colourA[i];
+		bool  shows = alpha > 0 && alpha * size * view.pixelsPerUnit > view.minContribution * std::fmax(depth, 0.0f);
+
+		visible[i] = !outside && shows ? 1 : 0;
+		counts.numOutside += outside ? 1 : 0;
+		counts.numFaded   += !outside && !shows ? 1 : 0;
+	}
+}
+
+#if SIMD_X86_AVAILABLE
+
+// Masks (all bits set = true) for whether each of 4 particles from i is outside the frustum and whether it is drawn
+static inline void VisibleSSE2(const ParticleSpan& p, int i, __m128 t, const CullView& view, __m128& outside, __m128& draw)
+{
+	const __m128 zero    = _mm_setzero_ps();
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+	__m128 prevX = _mm_loadu_ps(p.prevX + i), prevY = _mm_loadu_ps(p.prevY + i), prevZ = _mm_loadu_ps(p.prevZ + i);
+	__m128 x = _mm_add_ps(prevX, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p.posX + i), prevX), t));
+	__m128 y = _mm_add_ps(prevY, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p.posY + i), prevY), t));
+	__m128 z = _mm_add_ps(prevZ, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p.posZ + i), prevZ), t));
+	__m128 size = _mm_and_ps(_mm_loadu_ps(p.scale + i), absMask);
+	__m128 negRadius = _mm_sub_ps(zero, _mm_mul_ps(size, _mm_set1_ps(QuadRadius)));
+
+	outside = zero;
+	for (const auto& plane : view.planes)
+	{
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), x), _mm_mul_ps(_mm_set1_ps(plane[1]), y)),
+		                                        _mm_mul_ps(_mm_set1_ps(plane[2]), z)), _mm_set1_ps(plane[3]));
+		outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negRadius));
+	}
+
+	__m128 depth = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(view.depth[0]), x), _mm_mul_ps(_mm_set1_ps(view.depth[1]), y)),
+	                                     _mm_mul_ps(_mm_set1_ps(view.depth[2]), z)), _mm_set1_ps(view.depth[3]));
+	__m128 alpha = _mm_loadu_ps(p.colourA + i);
+	__m128 contribution = _mm_mul_ps(_mm_mul_ps(alpha, size), _mm_set1_ps(view.pixelsPerUnit));
+	__m128 threshold    = _mm_mul_ps(_mm_set1_ps(view.minContribution), _mm_max_ps(depth, zero));
+	__m128 shows = _mm_and_ps(_mm_cmpgt_ps(alpha, zero), _mm_cmpgt_ps(contribution, threshold));
+	draw = _mm_andnot_ps(outside, shows);
+}
+
+// 16 particles at a time, packed to bytes as in BuildAliveMask
+static void BuildVisibleMaskSSE2(const ParticleSpan& p, float interpolation, const CullView& view, uint8_t* visible,
+                                 CullCounts& counts)
+{
+	const __m128  t   = _mm_set1_ps(interpolation);
+	const __m128i one = _mm_set1_epi8(1);
+
+	int i = 0;
+	for (; i + 16 <= p.count; i += 16)
+	{
+		__m128 outside[4], draw[4];
+		for (int quad = 0; quad < 4; ++quad)  VisibleSSE2(p, i + quad * 4, t, view, outside[quad], draw[quad]);
+
+		__m128i bytes = _mm_packs_epi16(_mm_packs_epi32(_mm_castps_si128(draw[0]), _mm_castps_si128(draw[1])),
+		                                _mm_packs_epi32(_mm_castps_si128(draw[2]), _mm_castps_si128(draw[3])));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(visible + i), _mm_and_si128(bytes, one));
+
+		int numDrawn = std::popcount(static_cast<uint32_t>(_mm_movemask_epi8(bytes)));
+		int numOutside = 0;
+		for (int quad = 0; quad < 4; ++quad)  numOutside += std::popcount(static_cast<uint32_t>(_mm_movemask_ps(outside[quad])));
+		counts.numOutside += numOutside;
+		counts.numFaded   += 16 - numOutside - numDrawn;
+	}
+	BuildVisibleMaskScalar(p, interpolation, view, visible, i, p.count, counts);
+}
+
+
+SIMD_TARGET_AVX2 static inline void VisibleAVX2(const ParticleSpan& p, int i, __m256 t, const CullView& view,
+                                                __m256& outside, __m256& draw)
+{
+	const __m256 zero    = _mm256_setzero_ps();
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+	__m256 prevX = _mm256_loadu_ps(p.prevX + i), prevY = _mm256_loadu_ps(p.prevY + i), prevZ = _mm256_loadu_ps(p.prevZ + i);
+	__m256 x = _mm256_add_ps(prevX, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p.posX + i), prevX), t));
+	__m256 y = _mm256_add_ps(prevY, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p.posY + i), prevY), t));
+	__m256 z = _mm256_add_ps(prevZ, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p.posZ + i), prevZ), t));
+	__m256 size = _mm256_and_ps(_mm256_loadu_ps(p.scale + i), absMask);
+	__m256 negRadius = _mm256_sub_ps(zero, _mm256_mul_ps(size, _mm256_set1_ps(QuadRadius)));
+
+	outside = zero;
+	for (const auto& plane : view.planes)
+	{
+		__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[0]), x),
+		                                                            _mm256_mul_ps(_mm256_set1_ps(plane[1]), y)),
+		                                              _mm256_mul_ps(_mm256_set1_ps(plane[2]), z)), _mm256_set1_ps(plane[3]));
+		outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, negRadius, _CMP_LT_OQ));
+	}
+
+	__m256 depth = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(view.depth[0]), x),
+	                                                         _mm256_mul_ps(_mm256_set1_ps(view.depth[1]), y)),
+	                                           _mm256_mul_ps(_mm256_set1_ps(view.depth[2]), z)), _mm256_set1_ps(view.depth[3]));
+	__m256 alpha = _mm256_loadu_ps(p.colourA + i);
+	__m256 contribution = _mm256_mul_ps(_mm256_mul_ps(alpha, size), _mm256_set1_ps(view.pixelsPerUnit));
+	__m256 threshold    = _mm256_mul_ps(_mm256_set1_ps(view.minContribution), _mm256_max_ps(depth, zero));
+	__m256 shows = _mm256_and_ps(_mm256_cmp_ps(alpha, zero, _CMP_GT_OQ), _mm256_cmp_ps(contribution, threshold, _CMP_GT_OQ));
+	draw = _mm256_andnot_ps(outside, shows);
+}
+
+// 32 particles at a time, packed to bytes and permuted back into order as in BuildAliveMask
+SIMD_TARGET_AVX2 static void BuildVisibleMaskAVX2(const ParticleSpan& p, float interpolation, const CullView& view,
+                                                  uint8_t* visible, CullCounts& counts)
+{
+	const __m256  t     = _mm256_set1_ps(interpolation);
+	const __m256i one   = _mm256_set1_epi8(1);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	int i = 0;
+	for (; i + 32 <= p.count; i += 32)
+	{
+		__m256 outside[4], draw[4];
+		for (int oct = 0; oct < 4; ++oct)  VisibleAVX2(p, i + oct * 8, t, view, outside[oct], draw[oct]);
+
+		__m256i bytes = _mm256_packs_epi16(_mm256_packs_epi32(_mm256_castps_si256(draw[0]), _mm256_castps_si256(draw[1])),
+		                                   _mm256_packs_epi32(_mm256_castps_si256(draw[2]), _mm256_castps_si256(draw[3])));
+		bytes = _mm256_permutevar8x32_epi32(bytes, order);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(visible + i), _mm256_and_si256(bytes, one));
+
+		int numDrawn = std::popcount(static_cast<uint32_t>(_mm256_movemask_epi8(bytes)));
+		int numOutside = 0;
+		for (int oct = 0; oct < 4; ++oct)  numOutside += std::popcount(static_cast<uint32_t>(_mm256_movemask_ps(outside[oct])));
+		counts.numOutside += numOutside;
+		counts.numFaded   += 32 - numOutside - numDrawn;
+	}
+	BuildVisibleMaskScalar(p, interpolation, view, visible, i, p.count, counts);
+}
+
+#endif
+
+
+int BuildVisibleMask(const ParticleSpan& particles, float interpolation, const CullView& view, uint8_t* visible,
+                     CullCounts& counts)
+{
+	CullCounts spanCounts;
+	spanCounts.numTested = particles.count;
+
+#if SIMD_X86_AVAILABLE
+	switch (ParticleKernelLevel())
+	{
+		case SimdLevel::AVX2: BuildVisibleMaskAVX2(particles, interpolation, view, visible, spanCounts);  break;
+		case SimdLevel::SSE2: BuildVisibleMaskSSE2(particles, interpolation, view, visible, spanCounts);  break;
+		default:              BuildVisibleMaskScalar(particles, interpolation, view, visible, 0, particles.count, spanCounts);  break;
+	}
+#else
+	BuildVisibleMaskScalar(particles, interpolation, view, visible, 0, particles.count, spanCounts);
+#endif
+
+	counts.Add(spanCounts);
+	return spanCounts.NumVisible();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Gather
+//--------------------------------------------------------------------------------------
+
+int GatherVisibleVertices(const ParticleSpan& p, const uint8_t* visible, float interpolation, Firework* vertices)
+{
+	// Reads skip the culled particles, writes stay sequential
+	int numWritten = 0;
+	for (int i = 0; i < p.count; ++i)
+	{
+		if (!visible[i])  continue;
+
+		Firework& vertex = vertices[numWritten++];
+		vertex.position.x = p.prevX[i] + (p.posX[i] - p.prevX[i]) * interpolation;
+		vertex.position.y = p.prevY[i] + (p.posY[i] - p.prevY[i]) * interpolation;
+		vertex.position.z = p.prevZ[i] + (p.posZ[i] - p.prevZ[i]) * interpolation;
+		vertex.scale      = p.scale[i];
+		vertex.colour.r   = p.colourR[i];
+		vertex.colour.g   = p.colourG[i];
+		vertex.colour.b   = p.colourB[i];
+		vertex.colour.a   = p.colourA[i];
+		vertex.rotation   = p.rotation[i];
+	}
+	return numWritten;
+}
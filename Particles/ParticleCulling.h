@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// Particle culling before upload - skip particles that cannot be seen
+//--------------------------------------------------------------------------------------
+// Before the vertex buffer is filled each particle is tested against the camera frustum
+// and for whether it still contributes anything to the image: faded stars (alpha at or
+// below zero) and particles so dim and small on screen they would add nothing visible.
+// Only the survivors are written, so fewer bytes are uploaded and the geometry shader is
+// run for fewer points. The test is done 4 (SSE2) or 8 (AVX2) particles at a time at the
+// same SIMD level as the other particle kernels (see ParticleKernels.h)
+// Code in .cpp file
+
+#ifndef _PARTICLE_CULLING_H_INCLUDED_
+#define _PARTICLE_CULLING_H_INCLUDED_
+
+#include "ParticleStore.h"
+#include "CMatrix4x4.h"
+
+
+// Particle quads are 2 * scale across, so a sphere of this times the scale contains the quad whatever its rotation
+const float QuadRadius = 1.41421356f;
+
+
+// The camera view particles are culled against, plus the contribution threshold
+struct CullView
+{
+	float planes[6][4];  // Frustum planes (a, b, c, d) with unit normals facing in: inside when a*x + b*y + c*z + d >= 0
+	float depth[4];      // Distance in front of the camera: a*x + b*y + c*z + d (w of the clip space position)
+	float pixelsPerUnit; // Size in pixels of one world unit at a depth of 1
+
+	// Particles whose alpha times quad size in pixels is no more than this are not drawn. The default removes particles
+	// that would add less than a tenth of a pixel of full brightness. 0 culls only fully faded particles
+	float minContribution = 0.1f;
+};
+
+// Make a view from a camera's matrices (row vector convention, as Camera.h) and the viewport width in pixels
+CullView MakeCullView(const CMatrix4x4& viewMatrix, const CMatrix4x4& projectionMatrix, float viewportWidth);
+
+
+// Number of particles tested and why those not drawn were culled
+struct CullCounts
+{
+	int numTested  = 0;
+	int numOutside = 0; // Outside the frustum
+	int numFaded   = 0; // Inside the frustum but contribute nothing (see CullView::minContribution)
+
+	int  NumVisible() const                { return numTested - numOutside - numFaded; }
+	void Add(const CullCounts& counts)     { numTested += counts.numTested;  numOutside += counts.numOutside;  numFaded += counts.numFaded; }
+};
+
+
+// Set visible[i] to 1 if particle i should be drawn, or 0 if not, and add to the counts. Positions are interpolated as
+// for ParticleStore::GatherVertices. A particle's quad is treated as a sphere of radius scale * sqrt(2). Returns the
+// number visible
+int BuildVisibleMask(const ParticleSpan& particles, float interpolation, const CullView& view, uint8_t* visible,
+                     CullCounts& counts);
+
+// Write the render data of the visible particles into the given array in the Firework vertex layout, strictly in order
+// (the array is usually write-combined GPU memory). Returns the number written
+int GatherVisibleVertices(const ParticleSpan& particles, const uint8_t* visible, float interpolation, Firework* vertices);
+
+
+#endif //_PARTICLE_CULLING_H_INCLUDED_
@@ -0,0 +1,689 @@
+//--------------------------------------------------------------------------------------
+// Vectorised particle update kernels
+//--------------------------------------------------------------------------------------
+
+#include "ParticleKernels.h"
+#include "ParticleMotion.h"
+
+#include <cmath>
+#include <cstring>
+#include <bit>
+
+#if SIMD_X86_AVAILABLE
+	#include <immintrin.h>
+#endif
+
+
+// Each kernel is a template on the fade mode, so the Always / Never versions contain no type test at all
+
+
+//--------------------------------------------------------------------------------------
+// Scalar version
+//--------------------------------------------------------------------------------------
+
+// True if the particle fades, shrinks and slows down like a star
+template <ParticleFade Fade>
+static inline bool IsFadingStar(uint8_t type)
+{
+	if (Fade == ParticleFade::Always)  return true;
+	if (Fade == ParticleFade::Never)   return false;
+	return type == static_cast<uint8_t>(FireworkType::StarSimple) ||
+	       type == static_cast<uint8_t>(FireworkType::StarSmallTrail);
+}
+
+// Scalar update of particles [begin, end) - also used for the tail of the SIMD versions
+template <ParticleFade Fade>
+static void IntegrateRangeScalar(const ParticleSpan& p, int begin, int end, float frameTime, float gravity, float drag)
+{
+	for (int i = begin; i < end; ++i)
+	{
+		p.prevX[i] = p.posX[i];
+		p.prevY[i] = p.posY[i];
+		p.prevZ[i] = p.posZ[i];
+		p.posX[i] += p.velX[i] * frameTime;
+		p.posY[i] += p.velY[i] * frameTime;
+		p.posZ[i] += p.velZ[i] * frameTime;
+		p.velY[i] += gravity * frameTime;
+		p.life[i] -= frameTime;
+
+		if (IsFadingStar<Fade>(p.type[i]))
+		{
+			p.colourA[i] -= StarFadeRate   * frameTime;
+			p.scale[i]   -= StarShrinkRate * frameTime;
+			p.velX[i] *= drag;
+			p.velY[i] *= drag;
+			p.velZ[i] *= drag;
+		}
+	}
+}
+
+template <ParticleFade Fade>
+static void IntegrateScalar(const ParticleSpan& p, float frameTime, float gravity)
+{
+	IntegrateRangeScalar<Fade>(p, 0, p.count, frameTime, gravity, powf(StarDragBase, frameTime));
+}
+
+
+#if SIMD_X86_AVAILABLE
+
+//--------------------------------------------------------------------------------------
+// SSE2 version - 4 particles at a time
+//--------------------------------------------------------------------------------------
+
+// Lane mask of the fading stars among the four particles starting at "types"
+template <ParticleFade Fade>
+static inline __m128 StarMaskSSE2(const uint8_t* types)
+{
+	if (Fade == ParticleFade::Always)  return _mm_castsi128_ps(_mm_set1_epi32(-1));
+	if (Fade == ParticleFade::Never)   return _mm_setzero_ps();
+
+	// Widen four type bytes to 32-bit lanes and compare against the star types
+	int32_t types4;
+	memcpy(&types4, types, sizeof(types4));
+	const __m128i zero = _mm_setzero_si128();
+	__m128i lanes = _mm_cvtsi32_si128(types4);
+	lanes = _mm_unpacklo_epi8 (lanes, zero);
+	lanes = _mm_unpacklo_epi16(lanes, zero);
+	return _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(lanes, _mm_set1_epi32(static_cast<int>(FireworkType::StarSimple))),
+	                                     _mm_cmpeq_epi32(lanes, _mm_set1_epi32(static_cast<int>(FireworkType::StarSmallTrail)))));
+}
+
+template <ParticleFade Fade>
+static void IntegrateSSE2(const ParticleSpan& p, float frameTime, float gravity)
+{
+	const float drag = powf(StarDragBase, frameTime);
+
+	const __m128 dt        = _mm_set1_ps(frameTime);
+	const __m128 gravityDt = _mm_set1_ps(gravity * frameTime);
+	const __m128 fadeDt    = _mm_set1_ps(StarFadeRate   * frameTime);
+	const __m128 shrinkDt  = _mm_set1_ps(StarShrinkRate * frameTime);
+	const __m128 dragV     = _mm_set1_ps(drag);
+	const __m128 one       = _mm_set1_ps(1.0f);
+
+	int i = 0;
+	for (; i + 4 <= p.count; i += 4)
+	{
+		__m128 vx = _mm_loadu_ps(p.velX + i);
+		__m128 vy = _mm_loadu_ps(p.velY + i);
+		__m128 vz = _mm_loadu_ps(p.velZ + i);
+
+		__m128 px = _mm_loadu_ps(p.posX + i);
+		__m128 py = _mm_loadu_ps(p.posY + i);
+		__m128 pz = _mm_loadu_ps(p.posZ + i);
+		_mm_storeu_ps(p.prevX + i, px);
+		_mm_storeu_ps(p.prevY + i, py);
+		_mm_storeu_ps(p.prevZ + i, pz);
+		_mm_storeu_ps(p.posX + i, _mm_add_ps(px, _mm_mul_ps(vx, dt)));
+		_mm_storeu_ps(p.posY + i, _mm_add_ps(py, _mm_mul_ps(vy, dt)));
+		_mm_storeu_ps(p.posZ + i, _mm_add_ps(pz, _mm_mul_ps(vz, dt)));
+		vy = _mm_add_ps(vy, gravityDt);
+		_mm_storeu_ps(p.life + i, _mm_sub_ps(_mm_loadu_ps(p.life + i), dt));
+
+		if (Fade != ParticleFade::Never)
+		{
+			// Stars only: fade and shrink (masked amounts), drag (masked select between drag and 1)
+			__m128 starMask = StarMaskSSE2<Fade>(p.type + i);
+			_mm_storeu_ps(p.colourA + i, _mm_sub_ps(_mm_loadu_ps(p.colourA + i), _mm_and_ps(starMask, fadeDt)));
+			_mm_storeu_ps(p.scale   + i, _mm_sub_ps(_mm_loadu_ps(p.scale   + i), _mm_and_ps(starMask, shrinkDt)));
+			__m128 laneDrag = _mm_or_ps(_mm_and_ps(starMask, dragV), _mm_andnot_ps(starMask, one));
+			vx = _mm_mul_ps(vx, laneDrag);
+			vy = _mm_mul_ps(vy, laneDrag);
+			vz = _mm_mul_ps(vz, laneDrag);
+		}
+		_mm_storeu_ps(p.velX + i, vx);
+		_mm_storeu_ps(p.velY + i, vy);
+		_mm_storeu_ps(p.velZ + i, vz);
+	}
+	IntegrateRangeScalar<Fade>(p, i, p.count, frameTime, gravity, drag);
+}
+
+
+//--------------------------------------------------------------------------------------
+// AVX2 version - 8 particles at a time
+//--------------------------------------------------------------------------------------
+
+template <ParticleFade Fade>
+SIMD_TARGET_AVX2 static inline __m256 StarMaskAVX2(const uint8_t* types)
+{
+	if (Fade == ParticleFade::Always)  return _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+	if (Fade == ParticleFade::Never)   return _mm256_setzero_ps();
+
+	__m256i lanes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(types)));
+	return _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(lanes, _mm256_set1_epi32(static_cast<int>(FireworkType::StarSimple))),
+	                                           _mm256_cmpeq_epi32(lanes, _mm256_set1_epi32(static_cast<int>(FireworkType::StarSmallTrail)))));
+}
+
+template <ParticleFade Fade>
+SIMD_TARGET_AVX2 static void IntegrateAVX2(const ParticleSpan& p, float frameTime, float gravity)
+{
+	const float drag = powf(StarDragBase, frameTime);
+
+	const __m256 dt        = _mm256_set1_ps(frameTime);
+	const __m256 gravityDt = _mm256_set1_ps(gravity * frameTime);
+	const __m256 fadeDt    = _mm256_set1_ps(StarFadeRate   * frameTime);
+	const __m256 shrinkDt  = _mm256_set1_ps(StarShrinkRate * frameTime);
+	const __m256 dragV     = _mm256_set1_ps(drag);
+	const __m256 one       = _mm256_set1_ps(1.0f);
+
+	int i = 0;
+	for (; i + 8 <= p.count; i += 8)
+	{
+		__m256 vx = _mm256_loadu_ps(p.velX + i);
+		__m256 vy = _mm256_loadu_ps(p.velY + i);
+		__m256 vz = _mm256_loadu_ps(p.velZ + i);
+
+		__m256 px = _mm256_loadu_ps(p.posX + i);
+		__m256 py = _mm256_loadu_ps(p.posY + i);
+		__m256 pz = _mm256_loadu_ps(p.posZ + i);
+		_mm256_storeu_ps(p.prevX + i, px);
+		_mm256_storeu_ps(p.prevY + i, py);
+		_mm256_storeu_ps(p.prevZ + i, pz);
+		_mm256_storeu_ps(p.posX + i, _mm256_add_ps(px, _mm256_mul_ps(vx, dt)));
+		_mm256_storeu_ps(p.posY + i, _mm256_add_ps(py, _mm256_mul_ps(vy, dt)));
+		_mm256_storeu_ps(p.posZ + i, _mm256_add_ps(pz, _mm256_mul_ps(vz, dt)));
+		vy = _mm256_add_ps(vy, gravityDt);
+		_mm256_storeu_ps(p.life + i, _mm256_sub_ps(_mm256_loadu_ps(p.life + i), dt));
+
+		if (Fade != ParticleFade::Never)
+		{
+			__m256 starMask = StarMaskAVX2<Fade>(p.type + i);
+			_mm256_storeu_ps(p.colourA + i, _mm256_sub_ps(_mm256_loadu_ps(p.colourA + i), _mm256_and_ps(starMask, fadeDt)));
+			_mm256_storeu_ps(p.scale   + i, _mm256_sub_ps(_mm256_loadu_ps(p.scale   + i), _mm256_and_ps(starMask, shrinkDt)));
+			__m256 laneDrag = _mm256_blendv_ps(one, dragV, starMask);
+			vx = _mm256_mul_ps(vx, laneDrag);
+			vy = _mm256_mul_ps(vy, laneDrag);
+			vz = _mm256_mul_ps(vz, laneDrag);
+		}
+		_mm256_storeu_ps(p.velX + i, vx);
+		_mm256_storeu_ps(p.velY + i, vy);
+		_mm256_storeu_ps(p.velZ + i, vz);
+	}
+	IntegrateRangeScalar<Fade>(p, i, p.count, frameTime, gravity, drag);
+}
+
+#endif // SIMD_X86_AVAILABLE
+
+
+//--------------------------------------------------------------------------------------
+// Spawn kernels
+//--------------------------------------------------------------------------------------
+// Plain loops over whole columns - the compiler vectorises the fills and copies
+
+// Set every particle in the span to the given firework, including type and payload
+void InitParticles(const ParticleSpan& p, const Firework& firework, const FireworkUpdate& fireworkUpdate)
+{
+	const FireworkPayload payload = { fireworkUpdate.payloadTypeA,   fireworkUpdate.payloadTypeB,
+	                                  fireworkUpdate.payloadIntA,    fireworkUpdate.payloadIntB,
+	                                  fireworkUpdate.payloadColourA, fireworkUpdate.payloadColourB };
+	const uint8_t type = static_cast<uint8_t>(fireworkUpdate.type);
+
+	for (int i = 0; i < p.count; ++i)
+	{
+		p.posX[i] = p.prevX[i] = firework.position.x;
+		p.posY[i] = p.prevY[i] = firework.position.y;
+		p.posZ[i] = p.prevZ[i] = firework.position.z;
+		p.velX[i] = fireworkUpdate.velocity.x;
+		p.velY[i] = fireworkUpdate.velocity.y;
+		p.velZ[i] = fireworkUpdate.velocity.z;
+		p.life[i]  = fireworkUpdate.life;
+		p.timer[i] = fireworkUpdate.timer;
+		p.scale[i] = firework.scale;
+		p.colourR[i] = firework.colour.r;
+		p.colourG[i] = firework.colour.g;
+		p.colourB[i] = firework.colour.b;
+		p.colourA[i] = firework.colour.a;
+		p.rotation[i] = firework.rotation;
+		p.type[i] = type;
+		p.id[i]   = fireworkUpdate.id;
+	}
+	for (int i = 0; i < p.count; ++i)  p.payload[i] = payload;
+}
+
+// Set the position and colour of each particle in the span to those of the matching particle in "sources"
+void CopyPositionAndColour(const ParticleSpan& p, const ParticleSpan& sources)
+{
+	const size_t bytes = p.count * sizeof(float);
+	memcpy(p.posX, sources.posX, bytes);
+	memcpy(p.posY, sources.posY, bytes);
+	memcpy(p.posZ, sources.posZ, bytes);
+	memcpy(p.prevX, sources.posX, bytes); // New particles have not moved yet
+	memcpy(p.prevY, sources.posY, bytes);
+	memcpy(p.prevZ, sources.posZ, bytes);
+	memcpy(p.colourR, sources.colourR, bytes);
+	memcpy(p.colourG, sources.colourG, bytes);
+	memcpy(p.colourB, sources.colourB, bytes);
+	memcpy(p.colourA, sources.colourA, bytes);
+}
+
+// Velocity of each particle = scale * velocity of the matching particle in "sources"
+void ScaleVelocity(const ParticleSpan& p, const ParticleSpan& sources, float scale)
+{
+	for (int i = 0; i < p.count; ++i)
+	{
+		p.velX[i] = sources.velX[i] * scale;
+		p.velY[i] = sources.velY[i] * scale;
+		p.velZ[i] = sources.velZ[i] * scale;
+	}
+}
+
+// Give the particles in the span ids made from their parent's id, the frame and their index in the span
+void AssignChildIds(const ParticleSpan& p, uint32_t parentId, uint32_t frame)
+{
+	uint32_t parentKey = HashSeed(parentId, frame);
+	for (int i = 0; i < p.count; ++i)  p.id[i] = HashSeed(parentKey, i);
+}
+
+// Give each particle in the span an id made from the id of the matching particle in "parents" and the frame
+void InheritIds(const ParticleSpan& p, const ParticleSpan& parents, uint32_t frame)
+{
+	for (int i = 0; i < p.count; ++i)  p.id[i] = HashSeed(HashSeed(parents.id[i], frame), 0);
+}
+
+// Add a random amount in the range [-spread, spread] to each component of each particle's velocity
+void AddRandomVelocity(const ParticleSpan& p, float spread, uint32_t frame)
+{
+	// Generate in batches on the stack, then add
+	const int batchSize = 256;
+	float randomX[batchSize], randomY[batchSize], randomZ[batchSize];
+	for (int begin = 0; begin < p.count; begin += batchSize)
+	{
+		int count = p.count - begin < batchSize ? p.count - begin : batchSize;
+		RandomFloat3PerId(p.id + begin, frame, 0, randomX, randomY, randomZ, count, -spread, spread);
+		for (int i = 0; i < count; ++i)
+		{
+			p.velX[begin + i] += randomX[i];
+			p.velY[begin + i] += randomY[i];
+			p.velZ[begin + i] += randomZ[i];
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Dispatch
+//--------------------------------------------------------------------------------------
+
+static SimdLevel gKernelLevel = DetectSimdLevel();
+
+SimdLevel ParticleKernelLevel()
+{
+	return gKernelLevel;
+}
+
+void SetParticleKernelLevel(SimdLevel level)
+{
+	SimdLevel supported = DetectSimdLevel();
+	gKernelLevel = level > supported ? supported : level;
+}
+
+
+// Select the version for the current SIMD level
+template <ParticleFade Fade>
+static void IntegrateDispatch(const ParticleSpan& particles, float frameTime, float gravity)
+{
+#if SIMD_X86_AVAILABLE
+	switch (gKernelLevel)
+	{
+		case SimdLevel::AVX2: IntegrateAVX2<Fade>(particles, frameTime, gravity); return;
+		case SimdLevel::SSE2: IntegrateSSE2<Fade>(particles, frameTime, gravity); return;
+		default: break;
+	}
+#endif
+	IntegrateScalar<Fade>(particles, frameTime, gravity);
+}
+
+
+void IntegrateParticles(const ParticleSpan& particles, float frameTime, float gravity, ParticleFade fade)
+{
+	switch (fade)
+	{
+		case ParticleFade::Always: IntegrateDispatch<ParticleFade::Always>(particles, frameTime, gravity); break;
+		case ParticleFade::Never:  IntegrateDispatch<ParticleFade::Never >(particles, frameTime, gravity); break;
+		default:                   IntegrateDispatch<ParticleFade::ByType>(particles, frameTime, gravity); break;
+	}
+}
+
+void IntegrateParticlesScalar(const ParticleSpan& particles, float frameTime, float gravity, ParticleFade fade)
+{
+	switch (fade)
+	{
+		case ParticleFade::Always: IntegrateScalar<ParticleFade::Always>(particles, frameTime, gravity); break;
+		case ParticleFade::Never:  IntegrateScalar<ParticleFade::Never >(particles, frameTime, gravity); break;
+		default:                   IntegrateScalar<ParticleFade::ByType>(particles, frameTime, gravity); break;
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Several steps at once
+//--------------------------------------------------------------------------------------
+
+// How a particle moves over a number of steps of the integration above: from velocity v it ends up at position
+// + v * move + gravityMove (y only), with velocity v * velocityScale + gravityVelocity (y only). The position one step
+// before the end, which becomes the previous position, uses prevMove and prevGravityMove instead
+struct StepCoefficients
+{
+	float move,     gravityMove;
+	float prevMove, prevGravityMove;
+	float velocityScale, gravityVelocity;
+};
+
+// Coefficients from the closed form of the per-step motion (see ParticleMotion.h), so the cost doesn't depend on the
+// number of steps (drag base of 1 for particles that don't slow down)
+static StepCoefficients MakeStepCoefficients(float frameTime, int numSteps, float gravity, float dragBase)
+{
+	MotionCoefficients last = MotionOverAge(frameTime * numSteps,       frameTime, gravity, dragBase);
+	MotionCoefficients prev = MotionOverAge(frameTime * (numSteps - 1), frameTime, gravity, dragBase);
+	StepCoefficients c;
+	c.move            = last.move;
+	c.gravityMove     = last.gravityMove;
+	c.prevMove        = prev.move;
+	c.prevGravityMove = prev.gravityMove;
+	c.velocityScale   = last.velocityScale;
+	c.gravityVelocity = last.gravityVelocity;
+	return c;
+}
+
+// Scalar update of particles [begin, end) - also used for the tail of the SIMD versions
+template <ParticleFade Fade>
+static void IntegrateStepsRangeScalar(const ParticleSpan& p, int begin, int end, const StepCoefficients& star,
+                                      const StepCoefficients& plain, float time)
+{
+	for (int i = begin; i < end; ++i)
+	{
+		bool fades = IsFadingStar<Fade>(p.type[i]);
+		const StepCoefficients& c = fades ? star : plain;
+
+		float vx = p.velX[i], vy = p.velY[i], vz = p.velZ[i];
+		float x  = p.posX[i], y  = p.posY[i], z  = p.posZ[i];
+		p.prevX[i] = x + vx * c.prevMove;
+		p.prevY[i] = y + vy * c.prevMove + c.prevGravityMove;
+		p.prevZ[i] = z + vz * c.prevMove;
+		p.posX[i]  = x + vx * c.move;
+		p.posY[i]  = y + vy * c.move + c.gravityMove;
+		p.posZ[i]  = z + vz * c.move;
+		p.velX[i]  = vx * c.velocityScale;
+		p.velY[i]  = vy * c.velocityScale + c.gravityVelocity;
+		p.velZ[i]  = vz * c.velocityScale;
+		p.life[i] -= time;
+
+		if (fades)
+		{
+			p.colourA[i] -= StarFadeRate   * time;
+			p.scale[i]   -= StarShrinkRate * time;
+		}
+	}
+}
+
+
+#if SIMD_X86_AVAILABLE
+
+// SSE2 version - 4 particles at a time. Star and non-star lanes pick their coefficients with the star mask
+template <ParticleFade Fade>
+static void IntegrateStepsSSE2(const ParticleSpan& p, const StepCoefficients& star, const StepCoefficients& plain, float time)
+{
+	const __m128 moveS            = _mm_set1_ps(star.move),            moveP            = _mm_set1_ps(plain.move);
+	const __m128 gravityMoveS     = _mm_set1_ps(star.gravityMove),     gravityMoveP     = _mm_set1_ps(plain.gravityMove);
+	const __m128 prevMoveS        = _mm_set1_ps(star.prevMove),        prevMoveP        = _mm_set1_ps(plain.prevMove);
+	const __m128 prevGravityMoveS = _mm_set1_ps(star.prevGravityMove), prevGravityMoveP = _mm_set1_ps(plain.prevGravityMove);
+	const __m128 velocityScaleS   = _mm_set1_ps(star.velocityScale),   velocityScaleP   = _mm_set1_ps(plain.velocityScale);
+	const __m128 gravityVelocityS = _mm_set1_ps(star.gravityVelocity), gravityVelocityP = _mm_set1_ps(plain.gravityVelocity);
+	const __m128 timeV   = _mm_set1_ps(time);
+	const __m128 fadeV   = _mm_set1_ps(StarFadeRate   * time);
+	const __m128 shrinkV = _mm_set1_ps(StarShrinkRate * time);
+
+	auto select = [](__m128 mask, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); };
+
+	int i = 0;
+	for (; i + 4 <= p.count; i += 4)
+	{
+		__m128 starMask        = StarMaskSSE2<Fade>(p.type + i);
+		__m128 move            = select(starMask, moveS,            moveP);
+		__m128 gravityMove     = select(starMask, gravityMoveS,     gravityMoveP);
+		__m128 prevMove        = select(starMask, prevMoveS,        prevMoveP);
+		__m128 prevGravityMove = select(starMask, prevGravityMoveS, prevGravityMoveP);
+		__m128 velocityScale   = select(starMask, velocityScaleS,   velocityScaleP);
+		__m128 gravityVelocity = select(starMask, gravityVelocityS, gravityVelocityP);
+
+		__m128 vx = _mm_loadu_ps(p.velX + i), vy = _mm_loadu_ps(p.velY + i), vz = _mm_loadu_ps(p.velZ + i);
+		__m128 px = _mm_loadu_ps(p.posX + i), py = _mm_loadu_ps(p.posY + i), pz = _mm_loadu_ps(p.posZ + i);
+		_mm_storeu_ps(p.prevX + i, _mm_add_ps(px, _mm_mul_ps(vx, prevMove)));
+		_mm_storeu_ps(p.prevY + i, _mm_add_ps(_mm_add_ps(py, _mm_mul_ps(vy, prevMove)), prevGravityMove));
+		_mm_storeu_ps(p.prevZ + i, _mm_add_ps(pz, _mm_mul_ps(vz, prevMove)));
+		_mm_storeu_ps(p.posX  + i, _mm_add_ps(px, _mm_mul_ps(vx, move)));
+		_mm_storeu_ps(p.posY  + i, _mm_add_ps(_mm_add_ps(py, _mm_mul_ps(vy, move)), gravityMove));
+		_mm_storeu_ps(p.posZ  + i, _mm_add_ps(pz, _mm_mul_ps(vz, move)));
+		_mm_storeu_ps(p.velX  + i, _mm_mul_ps(vx, velocityScale));
+		_mm_storeu_ps(p.velY  + i, _mm_add_ps(_mm_mul_ps(vy, velocityScale), gravityVelocity));
+		_mm_storeu_ps(p.velZ  + i, _mm_mul_ps(vz, velocityScale));
+		_mm_storeu_ps(p.life  + i, _mm_sub_ps(_mm_loadu_ps(p.life + i), timeV));
+
+		if (Fade != ParticleFade::Never)
+		{
+			_mm_storeu_ps(p.colourA + i, _mm_sub_ps(_mm_loadu_ps(p.colourA + i), _mm_and_ps(starMask, fadeV)));
+			_mm_storeu_ps(p.scale   + i, _mm_sub_ps(_mm_loadu_ps(p.scale   + i), _mm_and_ps(starMask, shrinkV)));
+		}
+	}
+	IntegrateStepsRangeScalar<Fade>(p, i, p.count, star, plain, time);
+}
+
+// AVX2 version - 8 particles at a time
+template <ParticleFade Fade>
+SIMD_TARGET_AVX2 static void IntegrateStepsAVX2(const ParticleSpan& p, const StepCoefficients& star,
+                                                const StepCoefficients& plain, float time)
+{
+	const __m256 moveS            = _mm256_set1_ps(star.move),            moveP            = _mm256_set1_ps(plain.move);
+	const __m256 gravityMoveS     = _mm256_set1_ps(star.gravityMove),     gravityMoveP     = _mm256_set1_ps(plain.gravityMove);
+	const __m256 prevMoveS        = _mm256_set1_ps(star.prevMove),        prevMoveP        = _mm256_set1_ps(plain.prevMove);
+	const __m256 prevGravityMoveS = _mm256_set1_ps(star.prevGravityMove), prevGravityMoveP = _mm256_set1_ps(plain.prevGravityMove);
+	const __m256 velocityScaleS   = _mm256_set1_ps(star.velocityScale),   velocityScaleP   = _mm256_set1_ps(plain.velocityScale);
+	const __m256 gravityVelocityS = _mm256_set1_ps(star.gravityVelocity), gravityVelocityP = _mm256_set1_ps(plain.gravityVelocity);
+	const __m256 timeV   = _mm256_set1_ps(time);
+	const __m256 fadeV   = _mm256_set1_ps(StarFadeRate   * time);
+	const __m256 shrinkV = _mm256_set1_ps(StarShrinkRate * time);
+
+	int i = 0;
+	for (; i + 8 <= p.count; i += 8)
+	{
+		__m256 starMask        = StarMaskAVX2<Fade>(p.type + i);
+		__m256 move            = _mm256_blendv_ps(moveP,            moveS,            starMask);
+		__m256 gravityMove     = _mm256_blendv_ps(gravityMoveP,     gravityMoveS,     starMask);
+		__m256 prevMove        = _mm256_blendv_ps(prevMoveP,        prevMoveS,        starMask);
+		__m256 prevGravityMove = _mm256_blendv_ps(prevGravityMoveP, prevGravityMoveS, starMask);
+		__m256 velocityScale   = _mm256_blendv_ps(velocityScaleP,   velocityScaleS,   starMask);
+		__m256 gravityVelocity = _mm256_blendv_ps(gravityVelocityP, gravityVelocityS, starMask);
+
+		__m256 vx = _mm256_loadu_ps(p.velX + i), vy = _mm256_loadu_ps(p.velY + i), vz = _mm256_loadu_ps(p.velZ + i);
+		__m256 px = _mm256_loadu_ps(p.posX + i), py = _mm256_loadu_ps(p.posY + i), pz = _mm256_loadu_ps(p.posZ + i);
+		_mm256_storeu_ps(p.prevX + i, _mm256_add_ps(px, _mm256_mul_ps(vx, prevMove)));
+		_mm256_storeu_ps(p.prevY + i, _mm256_add_ps(_mm256_add_ps(py, _mm256_mul_ps(vy, prevMove)), prevGravityMove));
+		_mm256_storeu_ps(p.prevZ + i, _mm256_add_ps(pz, _mm256_mul_ps(vz, prevMove)));
+		_mm256_storeu_ps(p.posX  + i, _mm256_add_ps(px, _mm256_mul_ps(vx, move)));
+		_mm256_storeu_ps(p.posY  + i, _mm256_add_ps(_mm256_add_ps(py, _mm256_mul_ps(vy, move)), gravityMove));
+		_mm256_storeu_ps(p.posZ  + i, _mm256_add_ps(pz, _mm256_mul_ps(vz, move)));
+		_mm256_storeu_ps(p.velX  + i, _mm256_mul_ps(vx, velocityScale));
+		_mm256_storeu_ps(p.velY  + i, _mm256_add_ps(_mm256_mul_ps(vy, velocityScale), gravityVelocity));
+		_mm256_storeu_ps(p.velZ  + i, _mm256_mul_ps(vz, velocityScale));
+		_mm256_storeu_ps(p.life  + i, _mm256_sub_ps(_mm256_loadu_ps(p.life + i), timeV));
+
+		if (Fade != ParticleFade::Never)
+		{
+			_mm256_storeu_ps(p.colourA + i, _mm256_sub_ps(_mm256_loadu_ps(p.colourA + i), _mm256_and_ps(starMask, fadeV)));
+			_mm256_storeu_ps(p.scale   + i, _mm256_sub_ps(_mm256_loadu_ps(p.scale   + i), _mm256_and_ps(starMask, shrinkV)));
+		}
+	}
+	IntegrateStepsRangeScalar<Fade>(p, i, p.count, star, plain, time);
+}
+
+#endif // SIMD_X86_AVAILABLE
+
+
+template <ParticleFade Fade>
+static void IntegrateStepsDispatch(const ParticleSpan& p, float frameTime, int numSteps, float gravity)
+{
+	const StepCoefficients star  = MakeStepCoefficients(frameTime, numSteps, gravity, StarDragBase);
+	const StepCoefficients plain = MakeStepCoefficients(frameTime, numSteps, gravity, 1.0f);
+	const float time = frameTime * numSteps;
+#if SIMD_X86_AVAILABLE
+	switch (gKernelLevel)
+	{
+		case SimdLevel::AVX2: IntegrateStepsAVX2<Fade>(p, star, plain, time); return;
+		case SimdLevel::SSE2: IntegrateStepsSSE2<Fade>(p, star, plain, time); return;
+		default: break;
+	}
+#endif
+	IntegrateStepsRangeScalar<Fade>(p, 0, p.count, star, plain, time);
+}
+
+
+void IntegrateParticleSteps(const ParticleSpan& particles, float frameTime, int numSteps, float gravity, ParticleFade fade)
+{
+	// A single step goes through the usual kernel, so full rate particles are updated exactly as before
+	if (numSteps == 1)
+	{
+		IntegrateParticles(particles, frameTime, gravity, fade);
+		return;
+	}
+	switch (fade)
+	{
+		case ParticleFade::Always: IntegrateStepsDispatch<ParticleFade::Always>(particles, frameTime, numSteps, gravity); break;
+		case ParticleFade::Never:  IntegrateStepsDispatch<ParticleFade::Never >(particles, frameTime, numSteps, gravity); break;
+		default:                   IntegrateStepsDispatch<ParticleFade::ByType>(particles, frameTime, numSteps, gravity); break;
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Removal kernels
+//--------------------------------------------------------------------------------------
+
+// Mask: alive[i] = 1 if life > 0, else 0. Returns the number of dead particles
+
+static int BuildAliveMaskScalar(const float* life, uint8_t* alive, int begin, int end)
+{
+	int numAlive = 0;
+	for (int i = begin; i < end; ++i)
+	{
+		alive[i] = life[i] > 0 ? 1 : 0;
+		numAlive += alive[i];
+	}
+	return (end - begin) - numAlive;
+}
+
+#if SIMD_X86_AVAILABLE
+
+// 16 particles at a time: four compares packed down to 16 bytes of 0 / -1, then masked to 0 / 1
+static int BuildAliveMaskSSE2(const ParticleSpan& p, uint8_t* alive)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128i one = _mm_set1_epi8(1);
+
+	int numDead = 0;
+	int i = 0;
+	for (; i + 16 <= p.count; i += 16)
+	{
+		__m128i a = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(p.life + i     ), zero));
+		__m128i b = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(p.life + i +  4), zero));
+		__m128i c = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(p.life + i +  8), zero));
+		__m128i d = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(p.life + i + 12), zero));
+		__m128i bytes = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(alive + i), _mm_and_si128(bytes, one));
+		numDead += 16 - std::popcount(static_cast<uint32_t>(_mm_movemask_epi8(bytes)));
+	}
+	return numDead + BuildAliveMaskScalar(p.life, alive, i, p.count);
+}
+
+// 32 particles at a time. The packs work within 128-bit lanes, so a final permute puts the bytes back in order
+SIMD_TARGET_AVX2 static int BuildAliveMaskAVX2(const ParticleSpan& p, uint8_t* alive)
+{
+	const __m256  zero  = _mm256_setzero_ps();
+	const __m256i one   = _mm256_set1_epi8(1);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	int numDead = 0;
+	int i = 0;
+	for (; i + 32 <= p.count; i += 32)
+	{
+		__m256i a = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(p.life + i     ), zero, _CMP_GT_OQ));
+		__m256i b = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(p.life + i +  8), zero, _CMP_GT_OQ));
+		__m256i c = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(p.life + i + 16), zero, _CMP_GT_OQ));
+		__m256i d = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(p.life + i + 24), zero, _CMP_GT_OQ));
+		__m256i bytes = _mm256_packs_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+		bytes = _mm256_permutevar8x32_epi32(bytes, order);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(alive + i), _mm256_and_si256(bytes, one));
+		numDead += 32 - std::popcount(static_cast<uint32_t>(_mm256_movemask_epi8(bytes)));
+	}
+	return numDead + BuildAliveMaskScalar(p.life, alive, i, p.count);
+}
+
+#endif
+
+
+int BuildAliveMask(const ParticleSpan& particles, uint8_t* alive)
+{
+#if SIMD_X86_AVAILABLE
+	switch (gKernelLevel)
+	{
+		case SimdLevel::AVX2: return BuildAliveMaskAVX2(particles, alive);
+		case SimdLevel::SSE2: return BuildAliveMaskSSE2(particles, alive);
+		default: break;
+	}
+#endif
+	return BuildAliveMaskScalar(particles.life, alive, 0, particles.count);
+}
+
+
+// Compaction: the holes left by dead particles before the new end of the span are filled with the live particles after
+// it. Only as many particles move as died, wherever they are in the span. The moves are planned once from the mask and
+// then applied to each column separately
+
+int PlanCompaction(const uint8_t* alive, int count, int numDead, int* from, int* to)
+{
+	const int newCount = count - numDead;
+
+	int numMoves = 0;
+	int source = count;
+	int hole = 0;
+	while (true)
+	{
+		// Next dead particle before the new end. memchr skips runs of live particles many bytes at a time
+		const uint8_t* nextHole = static_cast<const uint8_t*>(memchr(alive + hole, 0, newCount - hole));
+		if (nextHole == nullptr)  break;
+		hole = static_cast<int>(nextHole - alive);
+
+		// Previous live particle after the new end - there is one for every hole
+		do  --source;  while (alive[source] == 0);
+
+		from[numMoves] = source;
+		to  [numMoves] = hole;
+		++numMoves;
+		++hole;
+	}
+	return numMoves;
+}
+
+
+template <class T>
+static void MoveColumn(T* column, const int* from, const int* to, int numMoves)
+{
+	for (int move = 0; move < numMoves; ++move)  column[to[move]] = column[from[move]];
+}
+
+void CompactParticleColumn(const ParticleSpan& p, const int* from, const int* to, int numMoves, int column)
+{
+	float* floats[] = { p.posX, p.posY, p.posZ, p.prevX, p.prevY, p.prevZ, p.velX, p.velY, p.velZ, p.life, p.timer,
+	                    p.scale, p.colourR, p.colourG, p.colourB, p.colourA, p.rotation };
+	const int numFloats = sizeof(floats) / sizeof(floats[0]);
+
+	if      (column < numFloats)      MoveColumn(floats[column], from, to, numMoves);
+	else if (column == numFloats)     MoveColumn(p.id,           from, to, numMoves);
+	else if (column == numFloats + 1) MoveColumn(p.type,         from, to, numMoves);
+	else                              MoveColumn(p.payload,      from, to, numMoves);
+}
+
+int CompactParticles(const ParticleSpan& particles, const uint8_t* alive, int numDead, int* from, int* to)
+{
+	int numMoves = PlanCompaction(alive, particles.count, numDead, from, to);
+	for (int column = 0; column < NumParticleColumns; ++column)  CompactParticleColumn(particles, from, to, numMoves, column);
+	return particles.count - numDead;
+}
@@ -0,0 +1,102 @@
+//--------------------------------------------------------------------------------------
+// Vectorised particle update kernels
+//--------------------------------------------------------------------------------------
+// The per-frame motion of every particle (position, gravity, life, star fading and drag) done
+// 4 (SSE2) or 8 (AVX2) particles per instruction. The instruction set is chosen at runtime,
+// with a scalar version as fallback and as the reference the SIMD versions must agree with
+// Code in .cpp file
+
+#ifndef _PARTICLE_KERNELS_H_INCLUDED_
+#define _PARTICLE_KERNELS_H_INCLUDED_
+
+#include "ParticleStore.h"
+#include "CpuFeatures.h"
+#include "MathHelpers.h"
+#include "CounterRandom.h"
+
+
+// Star behaviour constants (StarSimple and StarSmallTrail)
+const float StarFadeRate   = 0.5f; // Alpha lost per second
+const float StarShrinkRate = 1.0f; // Scale lost per second
+const float StarDragBase   = 0.5f; // Velocity is multiplied by StarDragBase^frameTime each frame
+
+
+// Which particles in a span fade, shrink and slow down like stars. When a span is known to hold a single type
+// (e.g. a type bucket of the ParticlePool) use Always or Never, which removes the per-particle type test entirely
+enum class ParticleFade { ByType, Always, Never };
+
+
+// Integrate all particles in the span by frameTime:
+//   previous position = position (for render interpolation)
+//   position += velocity * frameTime, velocity.y += gravity * frameTime, life -= frameTime
+//   stars also fade, shrink and slow down by the constants above (which particles count as stars is set by "fade")
+// Uses the SIMD level selected below
+void IntegrateParticles(const ParticleSpan& particles, float frameTime, float gravity, ParticleFade fade = ParticleFade::ByType);
+
+// Scalar reference version of the above - always available, the SIMD versions must match it
+void IntegrateParticlesScalar(const ParticleSpan& particles, float frameTime, float gravity, ParticleFade fade = ParticleFade::ByType);
+
+// Integrate all particles in the span by numSteps steps of frameTime in one pass, with the same result as calling
+// IntegrateParticles numSteps times (up to rounding): motion, gravity and drag over several steps have a closed form.
+// The previous position is the one a step before the end, as it would be after the last of the single steps.
+// Used for particles that are updated less often (see UpdateLod.h)
+void IntegrateParticleSteps(const ParticleSpan& particles, float frameTime, int numSteps, float gravity,
+                            ParticleFade fade = ParticleFade::ByType);
+
+
+//--------------------------------------------------------------------------------------
+// Spawn kernels - fill a range of new particles (see SpawnBuffer::Reserve) a column at a time
+//--------------------------------------------------------------------------------------
+
+// Set every particle in the span to the given firework, including type and payload
+void InitParticles(const ParticleSpan& particles, const Firework& firework, const FireworkUpdate& fireworkUpdate);
+
+// Set the position and colour of each particle in the span to those of the matching particle in "sources" (same count)
+void CopyPositionAndColour(const ParticleSpan& particles, const ParticleSpan& sources);
+
+// Velocity of each particle = scale * velocity of the matching particle in "sources" (same count)
+void ScaleVelocity(const ParticleSpan& particles, const ParticleSpan& sources, float scale);
+
+// Give the particles in the span ids made from their parent's id, the frame and their index in the span
+void AssignChildIds(const ParticleSpan& particles, uint32_t parentId, uint32_t frame);
+
+// Give each particle in the span an id made from the id of the matching particle in "parents" (same count) and the frame
+void InheritIds(const ParticleSpan& particles, const ParticleSpan& parents, uint32_t frame);
+
+// Add a random amount in the range [-spread, spread] to each component of each particle's velocity. The random
+// numbers are keyed by particle id and frame (see CounterRandom.h), so set the ids first
+void AddRandomVelocity(const ParticleSpan& particles, float spread, uint32_t frame);
+
+
+//--------------------------------------------------------------------------------------
+// Removal kernels - dead particles are removed in a separate pass after the update
+//--------------------------------------------------------------------------------------
+// The update marks which particles are still alive, then the holes left by the dead ones are filled with live particles
+// from the end of the span, one column at a time. Only as many particles move as died, and the columns are independent
+// so they can be compacted on different threads. Like swap-remove, particle order is not preserved
+
+// Number of columns in a ParticleSpan (17 float columns, id, type and payload)
+const int NumParticleColumns = 20;
+
+// Set alive[i] to 1 if particle i has life > 0, or 0 if not. Returns the number of dead particles
+int BuildAliveMask(const ParticleSpan& particles, uint8_t* alive);
+
+// Work out the moves that compact a span of "count" particles with the given alive mask and number of dead: particle
+// from[i] moves to to[i]. The arrays need space for numDead entries. Returns the number of moves
+int PlanCompaction(const uint8_t* alive, int count, int numDead, int* from, int* to);
+
+// Apply the moves to one column (0 to NumParticleColumns - 1) of the span
+void CompactParticleColumn(const ParticleSpan& particles, const int* from, const int* to, int numMoves, int column);
+
+// Plan and apply the moves to every column. Returns the number of live particles, which are now at the start of the span
+int CompactParticles(const ParticleSpan& particles, const uint8_t* alive, int numDead, int* from, int* to);
+
+
+// SIMD level used by IntegrateParticles and the removal kernels. Defaults to the best the CPU supports
+SimdLevel ParticleKernelLevel();
+
+// Override the SIMD level (e.g. to compare against the scalar version). Levels above what the CPU supports are clamped
+void SetParticleKernelLevel(SimdLevel level);
+
+
+#endif //_PARTICLE_KERNELS_H_INCLUDED_
@@ -0,0 +1,82 @@
+//--------------------------------------------------------------------------------------
+// Closed-form particle motion - the state at any age worked out from the state at spawn
+//--------------------------------------------------------------------------------------
+
+#include "ParticleMotion.h"
+#include "ParticleKernels.h"
+
+#include <cmath>
+
+
+// Each step of the integrator moves by the velocity, then adds gravity and multiplies the velocity by the per-step drag
+// d = dragBase^stepTime. After n steps (k = ln dragBase, so d^n = e^(k * age)):
+//   velocityScale   = d^n
+//   move            = stepTime * (1 + d + ... + d^(n-1))     = q * (1 - d^n),  with q = stepTime / (1 - d)
+//   gravityVelocity = gravity * stepTime * (d + ... + d^n)  = gravity * d * move
+//   gravityMove     = stepTime * sum of gravityVelocity over the first n steps = gravity * d * q * (age - move)
+// As the step time goes to 0, d goes to 1 and q to -1 / k, which gives the continuous motion. With no drag the sums are
+// plain arithmetic series instead. Worked in double as 1 - d is small
+MotionCoefficients MotionOverAge(float age, float stepTime, float gravity, float dragBase)
+{
+	MotionCoefficients c;
+	if (dragBase == 1.0f)
+	{
+		c.move            = age;
+		c.gravityMove     = static_cast<float>(0.5 * gravity * age * (static_cast<double>(age) - stepTime));
+		c.velocityScale   = 1.0f;
+		c.gravityVelocity = gravity * age;
+		return c;
+	}
+
+	double k = std::log(static_cast<double>(dragBase));
+	double d = stepTime > 0 ? std::exp(k * stepTime) : 1.0;
+	double q = stepTime > 0 ? stepTime / (1.0 - d) : -1.0 / k;
+	double velocityScale = std::exp(k * age);
+	double move          = q * (1.0 - velocityScale);
+	c.move            = static_cast<float>(move);
+	c.gravityMove     = static_cast<float>(gravity * d * q * (age - move));
+	c.velocityScale   = static_cast<float>(velocityScale);
+	c.gravityVelocity = static_cast<float>(gravity * d * move);
+	return c;
+}
+
+
+void EvaluateParticles(const ParticleSpan& particles, const ParticleSpan& spawned, float age, float stepTime, float gravity)
+{
+	// Coefficients for stars and for everything else, at the age and one step before it (the previous position). A new
+	// particle's previous position is its position, as set when it is spawned
+	float prevAge = age > stepTime ? age - stepTime : 0.0f;
+	const MotionCoefficients star      = MotionOverAge(age,     stepTime, gravity, StarDragBase);
+	const MotionCoefficients plain     = MotionOverAge(age,     stepTime, gravity, 1.0f);
+	const MotionCoefficients starPrev  = MotionOverAge(prevAge, stepTime, gravity, StarDragBase);
+	const MotionCoefficients plainPrev = MotionOverAge(prevAge, stepTime, gravity, 1.0f);
+
+	if (particles.posX != spawned.posX)  CopyParticles(particles, spawned);
+	const ParticleSpan& p = particles;
+	for (int i = 0; i < p.count; ++i)
+	{
+		bool fades = p.type[i] == static_cast<uint8_t>(FireworkType::StarSimple) ||
+		             p.type[i] == static_cast<uint8_t>(FireworkType::StarSmallTrail);
+		const MotionCoefficients& c    = fades ? star     : plain;
+		const MotionCoefficients& prev = fades ? starPrev : plainPrev;
+
+		float vx = p.velX[i], vy = p.velY[i], vz = p.velZ[i];
+		float x  = p.posX[i], y  = p.posY[i], z  = p.posZ[i];
+		p.prevX[i] = x + vx * prev.move;
+		p.prevY[i] = y + vy * prev.move + prev.gravityMove;
+		p.prevZ[i] = z + vz * prev.move;
+		p.posX[i]  = x + vx * c.move;
+		p.posY[i]  = y + vy * c.move + c.gravityMove;
+		p.posZ[i]  = z + vz * c.move;
+		p.velX[i]  = vx * c.velocityScale;
+		p.velY[i]  = vy * c.velocityScale + c.gravityVelocity;
+		p.velZ[i]  = vz * c.velocityScale;
+		p.life[i] -= age;
+
+		if (fades)
+		{
+			p.colourA[i] -= StarFadeRate   * age;
+			p.scale[i]   -= StarShrinkRate * age;
+		}
+	}
+}
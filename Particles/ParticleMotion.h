@@ -0,0 +1,38 @@
+//--------------------------------------------------------------------------------------
+// Closed-form particle motion - the state at any age worked out from the state at spawn
+//--------------------------------------------------------------------------------------
+// Once spawned, a particle only moves under constant gravity, and stars also fade, shrink
+// and slow down by a fixed factor per second (see ParticleKernels.h). Each of these has a
+// closed form, so a particle's state at any age comes straight from its spawn state with no
+// integration, and the cost doesn't depend on the age. Given the step time of the integrator
+// the result is the one the step by step update reaches after age / stepTime steps (exactly
+// at whole steps, up to rounding, and smoothly in between). With a step time of 0 it is the
+// continuous motion those steps approach, which is the same at any frame rate
+// Code in .cpp file
+
+#ifndef _PARTICLE_MOTION_H_INCLUDED_
+#define _PARTICLE_MOTION_H_INCLUDED_
+
+#include "ParticleStore.h"
+
+
+// How a particle moves over an age: from position p and velocity v it ends up at p + v * move + gravityMove (y only),
+// with velocity v * velocityScale + gravityVelocity (y only)
+struct MotionCoefficients
+{
+	float move,          gravityMove;
+	float velocityScale, gravityVelocity;
+};
+
+// Coefficients for the given age. dragBase is the factor velocity is multiplied by each second: StarDragBase for stars,
+// 1 for particles that don't slow down. A step time of 0 gives the continuous motion (see above)
+MotionCoefficients MotionOverAge(float age, float stepTime, float gravity, float dragBase);
+
+
+// Set the particles in "particles" to the state of the matching particles in "spawned" (same count) at the given age
+// since spawning, including the previous position (one step earlier, for render interpolation), life, and fading for
+// star types. Other columns are copied. The two spans may be the same to move particles forward in place
+void EvaluateParticles(const ParticleSpan& particles, const ParticleSpan& spawned, float age, float stepTime, float gravity);
+
+
+#endif //_PARTICLE_MOTION_H_INCLUDED_
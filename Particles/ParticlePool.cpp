@@ -0,0 +1,215 @@
+//--------------------------------------------------------------------------------------
+// All firework particles, kept in one SoA store per firework type
+//--------------------------------------------------------------------------------------
+
+#include "ParticlePool.h"
+#include "ParticleKernels.h"
+
+#include <vector>
+
+
+ParticlePool::ParticlePool(int maxParticles)
+	: mMaxParticles(maxParticles)
+{
+}
+
+
+int ParticlePool::Size() const
+{
+	int size = 0;
+	for (const auto& bucket : mBuckets)  size += bucket.Size();
+	for (const auto& ring   : mRings)    size += ring.Size();
+	return size;
+}
+
+void ParticlePool::Clear()
+{
+	for (auto& bucket : mBuckets)  bucket.Clear();
+	for (auto& ring   : mRings)    ring.Clear();
+}
+
+
+int ParticlePool::StreamSize(int stream) const
+{
+	return stream < NumFireworkTypes ? mBuckets[stream].Size() : mRings[stream - NumFireworkTypes].Size();
+}
+
+int ParticlePool::AddRange(int stream, int count)
+{
+	return stream < NumFireworkTypes ? mBuckets[stream].AddRange(count) : mRings[stream - NumFireworkTypes].AddRange(count);
+}
+
+
+bool ParticlePool::Add(const Firework& firework, const FireworkUpdate& fireworkUpdate)
+{
+	if (Full())  return false;
+	int stream = ParticleStream(fireworkUpdate.type, fireworkUpdate.life);
+	if (stream < NumFireworkTypes)
+	{
+		mBuckets[stream].Add(firework, fireworkUpdate);
+	}
+	else
+	{
+		// Build the particle in a one-particle store, then copy it into place
+		ParticleStore single(1);
+		single.Add(firework, fireworkUpdate);
+		ForEachSpan(stream, AddRange(stream, 1), StreamSize(stream), [&](const ParticleSpan& span, int)
+		{
+			CopyParticles(span, single.Span());
+		});
+	}
+	return true;
+}
+
+
+// Remove dead particles in one pass, building the alive masks here rather than during an update
+int ParticlePool::RemoveDead(int* deadByType, WorkerPool* pool)
+{
+	PrepareAliveMasks();
+
+	int dead[NumFireworkTypes];
+	for (int t = 0; t < NumFireworkTypes; ++t)
+	{
+		dead[t] = BuildAliveMask(mBuckets[t].Span(), mAlive[t].data());
+		if (deadByType != nullptr)  deadByType[t] = dead[t];
+	}
+	int numRemoved = CompactDead(dead, pool);
+
+	for (int c = 0; c < NumLifetimeClasses; ++c)
+	{
+		int expired = mRings[c].CountExpired(0);
+		mRings[c].PopFront(expired);
+		if (deadByType != nullptr)  deadByType[static_cast<int>(GetLifetimeClass(c).type)] += expired;
+		numRemoved += expired;
+	}
+	return numRemoved;
+}
+
+
+void ParticlePool::PrepareAliveMasks()
+{
+	for (int t = 0; t < NumFireworkTypes; ++t)
+	{
+		if (static_cast<int>(mAlive[t].size()) < mBuckets[t].Size())  mAlive[t].resize(mBuckets[t].Capacity());
+	}
+}
+
+
+int ParticlePool::CompactDead(const int* deadByType, WorkerPool* pool)
+{
+	// Plan the moves for each bucket that has dead particles, then apply them with one task per column of each bucket
+	struct CompactTask
+	{
+		int type;
+		int column;
+	};
+	std::vector<CompactTask> tasks;
+	int numMoves[NumFireworkTypes] = {};
+
+	int removed = 0;
+	for (int t = 0; t < NumFireworkTypes; ++t)
+	{
+		if (deadByType[t] == 0)  continue;
+
+		if (static_cast<int>(mMoveFrom[t].size()) < deadByType[t])
+		{
+			mMoveFrom[t].resize(deadByType[t]);
+			mMoveTo  [t].resize(deadByType[t]);
+		}
+		numMoves[t] = PlanCompaction(mAlive[t].data(), mBuckets[t].Size(), deadByType[t], mMoveFrom[t].data(), mMoveTo[t].data());
+		for (int column = 0; column < NumParticleColumns; ++column)  tasks.push_back({ t, column });
+		removed += deadByType[t];
+	}
+
+	auto compact = [&](int task)
+	{
+		int t = tasks[task].type;
+		CompactParticleColumn(mBuckets[t].Span(), mMoveFrom[t].data(), mMoveTo[t].data(), numMoves[t], tasks[task].column);
+	};
+	if (pool != nullptr)  pool->ParallelFor(static_cast<int>(tasks.size()), compact);
+	else                  for (int task = 0; task < static_cast<int>(tasks.size()); ++task)  compact(task);
+
+	for (int t = 0; t < NumFireworkTypes; ++t)  mBuckets[t].Truncate(mBuckets[t].Size() - deadByType[t]);
+	return removed;
+}
+
+
+// Call f(span, lag) for each run of neighbouring LOD groups in a block of a ring that are the same number of steps behind
+template <class F>
+static void ForEachLagRun(ParticleRing& ring, int block, F&& f)
+{
+	ParticleSpan run = {};
+	int runLag = 0;
+	ring.ForEachLodGroup(block, [&](const ParticleSpan& group, const ParticleRing::GroupLod& lod, bool)
+	{
+		if (run.count > 0 && lod.lag == runLag)
+		{
+			run.count += group.count;
+			return;
+		}
+		if (run.count > 0)  f(run, runLag);
+		run    = group;
+		runLag = lod.lag;
+	});
+	if (run.count > 0)  f(run, runLag);
+}
+
+
+template <class F>
+void ParticlePool::ForEachGatherSpan(F&& f)
+{
+	for (auto& bucket : mBuckets)
+	{
+		if (bucket.Size() > 0)  f(bucket.Span(), 0);
+	}
+	for (auto& ring : mRings)
+	{
+		for (int block = 0; block < ring.NumBlocks(); ++block)  ForEachLagRun(ring, block, f);
+	}
+}
+
+
+void ParticlePool::GatherVertices(Firework* vertices, float interpolation)
+{
+	ForEachGatherSpan([&](const ParticleSpan& span, int lag)
+	{
+		::GatherVertices(span, vertices, interpolation + lag);
+		vertices += span.count;
+	});
+}
+
+void ParticlePool::GatherVertices(const PackedVertexSpan& vertices, float interpolation)
+{
+	int numWritten = 0;
+	ForEachGatherSpan([&](const ParticleSpan& span, int lag)
+	{
+		GatherPackedVertices(span, interpolation + lag, vertices.Skip(numWritten));
+		numWritten += span.count;
+	});
+}
+
+
+// Span by span: one pass to test every particle, then a second to write just the visible ones
+int ParticlePool::GatherVisibleVertices(Firework* vertices, float interpolation, const CullView& view, CullCounts& counts)
+{
+	int numWritten = 0;
+	ForEachGatherSpan([&](const ParticleSpan& span, int lag)
+	{
+		if (static_cast<int>(mVisible.size()) < span.count)  mVisible.resize(span.count);
+		if (BuildVisibleMask(span, interpolation + lag, view, mVisible.data(), counts) == 0)  return;
+		numWritten += ::GatherVisibleVertices(span, mVisible.data(), interpolation + lag, vertices + numWritten);
+	});
+	return numWritten;
+}
+
+int ParticlePool::GatherVisibleVertices(const PackedVertexSpan& vertices, float interpolation, const CullView& view, CullCounts& counts)
+{
+	int numWritten = 0;
+	ForEachGatherSpan([&](const ParticleSpan& span, int lag)
+	{
+		if (static_cast<int>(mVisible.size()) < span.count)  mVisible.resize(span.count);
+		if (BuildVisibleMask(span, interpolation + lag, view, mVisible.data(), counts) == 0)  return;
+		numWritten += GatherVisiblePackedVertices(span, mVisible.data(), interpolation + lag, vertices.Skip(numWritten));
+	});
+	return numWritten;
+}
@@ -0,0 +1,149 @@
+//--------------------------------------------------------------------------------------
+// All firework particles, kept in one SoA store per firework type
+//--------------------------------------------------------------------------------------
+// Every particle in a bucket has the same type, so the update can run one specialised loop
+// per type (e.g. stars: integrate and fade only, rockets: integrate and burst on death)
+// instead of testing the type of each particle. Buckets are concatenated when rendering.
+// Particles in a lifetime class (see FireworkTypes.h) are kept in a FIFO ring per class
+// instead of their type's bucket, and are removed from the front rather than compacted
+// Code in .cpp file
+
+#ifndef _PARTICLE_POOL_H_INCLUDED_
+#define _PARTICLE_POOL_H_INCLUDED_
+
+#include "ParticleStore.h"
+#include "ParticleCulling.h"
+#include "ParticleRing.h"
+#include "PackedFirework.h"
+#include "WorkerPool.h"
+#include "AlignedAllocator.h"
+
+#include <vector>
+
+
+// Streams - everywhere particles go: the type buckets, then the lifetime class rings
+const int NumParticleStreams = NumFireworkTypes + NumLifetimeClasses;
+
+// Stream for particles of the given type spawned with the given life - its lifetime class ring if it has one, or else
+// its type bucket
+inline int ParticleStream(FireworkType type, float life)
+{
+	int lifetimeClass = FindLifetimeClass(type, life);
+	return lifetimeClass >= 0 ? NumFireworkTypes + lifetimeClass : static_cast<int>(type);
+}
+
+// Type of the particles in a stream
+inline FireworkType StreamType(int stream)
+{
+	return stream < NumFireworkTypes ? static_cast<FireworkType>(stream) : GetLifetimeClass(stream - NumFireworkTypes).type;
+}
+
+
+class ParticlePool
+{
+public:
+	// Construction //
+
+	// The pool will not hold more than maxParticles in total over all buckets
+	ParticlePool(int maxParticles = 0);
+
+	void SetMaxParticles(int maxParticles) { mMaxParticles = maxParticles; }
+	int  MaxParticles() const              { return mMaxParticles; }
+
+
+	// Size //
+
+	// Total number of particles in all buckets and rings
+	int  Size()  const;
+	bool Full()  const { return Size() >= mMaxParticles; }
+	bool Empty() const { return Size() == 0; }
+
+	// Remove all particles from all buckets and rings (keeps capacity)
+	void Clear();
+
+
+	// Buckets //
+
+	ParticleStore&       Bucket(FireworkType type)       { return mBuckets[static_cast<int>(type)]; }
+	const ParticleStore& Bucket(FireworkType type) const { return mBuckets[static_cast<int>(type)]; }
+
+	// Lifetime class rings
+	ParticleRing&       Ring(int lifetimeClass)       { return mRings[lifetimeClass]; }
+	const ParticleRing& Ring(int lifetimeClass) const { return mRings[lifetimeClass]; }
+
+	// Number of particles in a stream (see ParticleStream above)
+	int StreamSize(int stream) const;
+
+	// Add space for "count" uninitialised particles at the end of a stream, returns the index of the first
+	int AddRange(int stream, int count);
+
+	// Call f(span, offset) for each contiguous piece of the particles [begin, end) of a stream, where offset is the index
+	// of the piece's first particle minus begin. Buckets are a single piece, rings may be split at block boundaries
+	template <class F>
+	void ForEachSpan(int stream, int begin, int end, F&& f)
+	{
+		if (stream < NumFireworkTypes)  f(mBuckets[stream].Span(begin, end), 0);
+		else                            mRings[stream - NumFireworkTypes].ForEachSpan(begin, end, f);
+	}
+
+
+	// Adding / removing //
+
+	// Add a particle to the stream for its type and life. Returns false if the pool is full
+	bool Add(const Firework& firework, const FireworkUpdate& fireworkUpdate);
+
+	// Remove every particle with life <= 0 from all buckets and rings. Particle order in buckets is not preserved. Returns
+	// the number removed, and the number of each type removed in deadByType if given
+	int RemoveDead(int* deadByType = nullptr, WorkerPool* pool = nullptr);
+
+
+	// Removal in two phases //
+	// The update fills in each bucket's alive mask as it goes (see BuildAliveMask in ParticleKernels.h), then all the
+	// buckets are compacted in one pass: the holes left by dead particles are filled from the end of the bucket, spread
+	// over the worker threads a column at a time
+
+	// Size the alive masks to match the buckets. Call before the update, the masks are then written by the update
+	void PrepareAliveMasks();
+
+	// Alive mask for a bucket - one byte per particle, 1 = alive, 0 = dead
+	uint8_t* AliveMask(FireworkType type) { return mAlive[static_cast<int>(type)].data(); }
+
+	// Compact every bucket using its alive mask. deadByType holds the number of dead particles in each bucket (as
+	// returned by BuildAliveMask), buckets with none are skipped. Returns the total number removed
+	int CompactDead(const int* deadByType, WorkerPool* pool = nullptr);
+
+
+	// Rendering //
+
+	// Write the render data of every particle into the given array, bucket after bucket then ring after ring.
+	// The array must have space for Size() elements. See ParticleStore::GatherVertices for interpolation. Ring blocks
+	// that are behind because of update LOD (see UpdateLod.h) are extrapolated by the steps they missed: interpolating
+	// past 1 carries on along the line from the previous position through the current one
+	void GatherVertices(Firework* vertices, float interpolation = 1.0f);
+
+	// As above but only the particles that pass the culling tests of the view (see ParticleCulling.h). The array must
+	// still have space for Size() elements. Adds to counts and returns the number of vertices written
+	int GatherVisibleVertices(Firework* vertices, float interpolation, const CullView& view, CullCounts& counts);
+
+	// As the two above, but written packed straight into the span (usually the mapped vertex buffer), see PackedFirework.h
+	void GatherVertices(const PackedVertexSpan& vertices, float interpolation = 1.0f);
+	int  GatherVisibleVertices(const PackedVertexSpan& vertices, float interpolation, const CullView& view, CullCounts& counts);
+
+
+private:
+	// Call f(span, lag) for each run of particles in gather order: each bucket, then runs of ring blocks with the same
+	// update LOD lag (see UpdateLod.h), which is added to the interpolation
+	template <class F>
+	void ForEachGatherSpan(F&& f);
+
+	ParticleStore mBuckets[NumFireworkTypes];
+	ParticleRing  mRings[NumLifetimeClasses];
+	AlignedVector<uint8_t> mAlive[NumFireworkTypes];
+	std::vector<int>       mMoveFrom[NumFireworkTypes]; // Compaction moves, see PlanCompaction
+	std::vector<int>       mMoveTo  [NumFireworkTypes];
+	AlignedVector<uint8_t> mVisible; // Visibility mask of one bucket at a time, see GatherVisibleVertices
+	int mMaxParticles;
+};
+
+
+#endif //_PARTICLE_POOL_H_INCLUDED_
@@ -0,0 +1,107 @@
+//--------------------------------------------------------------------------------------
+// FIFO ring of particles - for particles that die in the order they were added
+//--------------------------------------------------------------------------------------
+
+#include "ParticleRing.h"
+
+
+void ParticleRing::Clear()
+{
+	for (int block = 0; block < mNumUsed; ++block)  Block(block).Clear();
+	mNumUsed = 0;
+	mHead    = 0;
+	mSize    = 0;
+}
+
+
+int ParticleRing::AddRange(int count)
+{
+	int first = mSize;
+	while (count > 0)
+	{
+		// Start a new block when the back one is full (or there are none in use)
+		if (mNumUsed == 0 || Block(mNumUsed - 1).Size() == BlockSize)
+		{
+			if (mNumUsed == static_cast<int>(mBlocks.size()))
+			{
+				// No free blocks - insert one at the free end. When the used blocks wrap round the end of the array that is
+				// just before the first one, so it moves up a place
+				int freeEnd = mBlocks.empty() ? 0 : (mFirst + mNumUsed) % static_cast<int>(mBlocks.size());
+				if (mNumUsed > 0 && freeEnd <= mFirst)  freeEnd = mFirst++;
+				mBlocks.insert(mBlocks.begin() + freeEnd, BlockSlot{ std::make_unique<ParticleStore>(BlockSize), {} });
+			}
+			++mNumUsed;
+			for (GroupLod& lod : Slot(mNumUsed - 1).lods)  lod = GroupLod();
+		}
+
+		ParticleStore& back = Block(mNumUsed - 1);
+		int added = BlockSize - back.Size() < count ? BlockSize - back.Size() : count;
+		back.AddRange(added);
+		count -= added;
+		mSize += added;
+	}
+	return first;
+}
+
+
+void ParticleRing::PopFront(int count)
+{
+	mSize -= count;
+	if (mSize <= 0)
+	{
+		Clear();
+		return;
+	}
+
+	// Hand back blocks that have been emptied - all but the last are full, so the front has passed the end of a block
+	mHead += count;
+	while (mHead >= BlockSize)
+	{
+		Block(0).Clear();
+		mFirst = (mFirst + 1) % static_cast<int>(mBlocks.size());
+		--mNumUsed;
+		mHead -= BlockSize;
+	}
+}
+
+
+int ParticleRing::CountExpired(float stepTime)
+{
+	int numExpired = 0;
+	for (int block = 0; block < mNumUsed; ++block)
+	{
+		BlockSlot& slot = Slot(block);
+		const float* life = slot.store->Span().life;
+		for (int i = block == 0 ? mHead : 0; i < slot.store->Size(); ++i)
+		{
+			if (life[i] > slot.lods[i / LodGroupSize].lag * stepTime)  return numExpired;
+			++numExpired;
+		}
+	}
+	return numExpired;
+}
+
+
+void ParticleRing::BlockRange(int block, int& begin, int& end) const
+{
+	begin = block == 0 ? 0 : block * BlockSize - mHead;
+	end   = block * BlockSize - mHead + Block(block).Size();
+}
+
+
+ParticleSpan ParticleRing::Span(int begin, int end)
+{
+	int block = (mHead + begin) / BlockSize;
+	int index = (mHead + begin) % BlockSize;
+	return Block(block).Span(index, index + (end - begin));
+}
+
+
+ParticleSpan ParticleRing::Locate(int position, int& index)
+{
+	int block = (mHead + position) / BlockSize;
+	int blockBegin, blockEnd;
+	BlockRange(block, blockBegin, blockEnd);
+	index = position - blockBegin;
+	return Span(blockBegin, blockEnd);
+}
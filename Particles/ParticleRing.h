@@ -0,0 +1,136 @@
+//--------------------------------------------------------------------------------------
+// FIFO ring of particles - for particles that die in the order they were added
+//--------------------------------------------------------------------------------------
+// Particles are added at the back and removed from the front, so nothing is ever moved
+// or reordered. The ring is made of fixed-size blocks, each a small SoA ParticleStore:
+// a block is taken from the free end of the ring when the back one fills up, and handed
+// back when everything in it has been removed. Every block is a contiguous span so the
+// particle kernels work on it unchanged, and the blocks double as the update chunks.
+// Particles are addressed by their position from the front (0 = oldest)
+// Code in .cpp file
+
+#ifndef _PARTICLE_RING_H_INCLUDED_
+#define _PARTICLE_RING_H_INCLUDED_
+
+#include "ParticleStore.h"
+
+#include <vector>
+#include <memory>
+
+
+class ParticleRing
+{
+public:
+	// Particles per block
+	static constexpr int BlockSize = 4096;
+
+
+	// Size //
+
+	int  Size()  const { return mSize; }
+	bool Empty() const { return mSize == 0; }
+
+	// Remove all particles. Keeps the blocks for reuse
+	void Clear();
+
+
+	// Adding / removing //
+
+	// Add space for the given number of particles at the back in one step, returns the position of the first. The new
+	// particles are uninitialised, fill them in through the spans from ForEachSpan
+	int AddRange(int count);
+
+	// Remove the given number of particles from the front. Blocks that are emptied go back to the free end of the ring
+	void PopFront(int count);
+
+	// Number of particles at the front with life <= 0. Only counts the leading run, which is all of the dead when the
+	// particles die in order. Particles in LOD groups that are behind (see below) count the steps of stepTime they missed
+	int CountExpired(float stepTime);
+
+
+	// Access //
+
+	// Blocks in use, front first, as ranges of positions. The first may start part way through its block and the last
+	// may not be full, the others are exactly BlockSize long
+	int  NumBlocks() const { return mNumUsed; }
+	void BlockRange(int block, int& begin, int& end) const;
+
+	// Column pointers for the positions [begin, end), which must be in a single block (see BlockRange)
+	ParticleSpan Span(int begin, int end);
+
+	// Block holding the particle at the given position, and the particle's index within the returned span
+	ParticleSpan Locate(int position, int& index);
+
+
+	// Update LOD (see UpdateLod.h) //
+
+	// Each block is split into groups of LodGroupSize particles, at fixed places in the block, and each group has its own
+	// update rate. Particles spawned together are next to each other (e.g. the stars of one burst), so the particles of a
+	// group are usually close together. The state is reset when a block is started
+	static constexpr int LodGroupSize = 64;
+	static constexpr int NumLodGroups = BlockSize / LodGroupSize;
+
+	struct GroupLod
+	{
+		int period  = 1; // Steps between updates
+		int lag     = 0; // Steps since the last update - the group has not been integrated for them and is drawn extrapolated
+		int recheck = 0; // Steps until the period is worked out again, for groups updated every step
+	};
+
+	// Call f(span, lod, full) for each group of the block in use, front to back, with the part of the group in use. "full"
+	// is true if no more particles will be added to the group
+	template <class F>
+	void ForEachLodGroup(int block, F&& f)
+	{
+		BlockSlot& slot = Slot(block);
+		int first = block == 0 ? mHead : 0;
+		int size  = slot.store->Size();
+		for (int group = first / LodGroupSize; group * LodGroupSize < size; ++group)
+		{
+			int groupEnd = (group + 1) * LodGroupSize;
+			int begin    = group * LodGroupSize > first ? group * LodGroupSize : first;
+			int end      = groupEnd < size ? groupEnd : size;
+			f(slot.store->Span(begin, end), slot.lods[group], end == groupEnd);
+		}
+	}
+
+	// Call f(span, offset) for each block-sized piece of the positions [begin, end), where offset is the position of the
+	// piece's first particle minus begin
+	template <class F>
+	void ForEachSpan(int begin, int end, F&& f)
+	{
+		for (int piece = begin; piece < end; )
+		{
+			int blockBegin, blockEnd;
+			BlockRange((mHead + piece) / BlockSize, blockBegin, blockEnd);
+			int pieceEnd = end < blockEnd ? end : blockEnd;
+			f(Span(piece, pieceEnd), piece - begin);
+			piece = pieceEnd;
+		}
+	}
+
+
+private:
+	struct BlockSlot
+	{
+		std::unique_ptr<ParticleStore> store;
+		GroupLod                       lods[NumLodGroups];
+	};
+
+	// Slot and store of the nth block in use from the front
+	BlockSlot&           Slot (int block)       { return mBlocks[(mFirst + block) % mBlocks.size()]; }
+	const BlockSlot&     Slot (int block) const { return mBlocks[(mFirst + block) % mBlocks.size()]; }
+	ParticleStore&       Block(int block)       { return *Slot(block).store; }
+	const ParticleStore& Block(int block) const { return *Slot(block).store; }
+
+	// Circular array of blocks: mNumUsed of them from mFirst are in use, the rest are free. Blocks are held by pointer so
+	// a new one can be inserted at the free end without moving any particles
+	std::vector<BlockSlot> mBlocks;
+	int mFirst   = 0;
+	int mNumUsed = 0;
+	int mHead    = 0; // Index of the front particle in the first block
+	int mSize    = 0;
+};
+
+
+#endif //_PARTICLE_RING_H_INCLUDED_
@@ -0,0 +1,422 @@
+//--------------------------------------------------------------------------------------
+// Structure-of-arrays storage for firework particles
+//--------------------------------------------------------------------------------------
+
+#include "ParticleStore.h"
+
+#include <cstring>
+
+
+// Round a particle count up to a whole number of SIMD lanes
+static int PadToLaneWidth(int count)
+{
+	return (count + ParticleLaneWidth - 1) / ParticleLaneWidth * ParticleLaneWidth;
+}
+
+
+// Copy every column of the particles in "source" to "destination"
+void CopyParticles(const ParticleSpan& destination, const ParticleSpan& source)
+{
+	const size_t floatBytes = source.count * sizeof(float);
+	memcpy(destination.posX,     source.posX,     floatBytes);
+	memcpy(destination.posY,     source.posY,     floatBytes);
+	memcpy(destination.posZ,     source.posZ,     floatBytes);
+	memcpy(destination.prevX,    source.prevX,    floatBytes);
+	memcpy(destination.prevY,    source.prevY,    floatBytes);
+	memcpy(destination.prevZ,    source.prevZ,    floatBytes);
+	memcpy(destination.velX,     source.velX,     floatBytes);
+	memcpy(destination.velY,     source.velY,     floatBytes);
+	memcpy(destination.velZ,     source.velZ,     floatBytes);
+	memcpy(destination.life,     source.life,     floatBytes);
+	memcpy(destination.timer,    source.timer,    floatBytes);
+	memcpy(destination.scale,    source.scale,    floatBytes);
+	memcpy(destination.colourR,  source.colourR,  floatBytes);
+	memcpy(destination.colourG,  source.colourG,  floatBytes);
+	memcpy(destination.colourB,  source.colourB,  floatBytes);
+	memcpy(destination.colourA,  source.colourA,  floatBytes);
+	memcpy(destination.rotation, source.rotation, floatBytes);
+	memcpy(destination.type,     source.type,     source.count * sizeof(uint8_t));
+	memcpy(destination.id,       source.id,       source.count * sizeof(uint32_t));
+	memcpy(destination.payload,  source.payload,  source.count * sizeof(FireworkPayload));
+}
+
+
+void GatherVertices(const ParticleSpan& p, Firework* vertices, float interpolation)
+{
+	for (int i = 0; i < p.count; ++i)
+	{
+		Firework& vertex = vertices[i];
+		vertex.position.x = p.prevX[i] + (p.posX[i] - p.prevX[i]) * interpolation;
+		vertex.position.y = p.prevY[i] + (p.posY[i] - p.prevY[i]) * interpolation;
+		vertex.position.z = p.prevZ[i] + (p.posZ[i] - p.prevZ[i]) * interpolation;
+		vertex.scale      = p.scale[i];
+		vertex.colour.r   = p.colourR[i];
+		vertex.colour.g   = p.colourG[i];
+		vertex.colour.b   = p.colourB[i];
+		vertex.colour.a   = p.colourA[i];
+		vertex.rotation   = p.rotation[i];
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// SoA particle store
+//--------------------------------------------------------------------------------------
+
+ParticleStore::ParticleStore(int capacity)
+	: mSize(0), mCapacity(0)
+{
+	Reserve(capacity);
+}
+
+
+// Ensure space for at least the given number of particles without reallocating
+void ParticleStore::Reserve(int capacity)
+{
+	capacity = PadToLaneWidth(capacity);
+	if (capacity <= mCapacity)  return;
+
+	// New elements, including the padding, start zeroed. Remove and Truncate leave old particles past the end, so loops
+	// must stop at the size - the SIMD kernels do the last few particles with scalar code rather than read past it
+	mPosX.resize(capacity, 0.0f);     mPosY.resize(capacity, 0.0f);     mPosZ.resize(capacity, 0.0f);
+	mPrevX.resize(capacity, 0.0f);    mPrevY.resize(capacity, 0.0f);    mPrevZ.resize(capacity, 0.0f);
+	mVelX.resize(capacity, 0.0f);     mVelY.resize(capacity, 0.0f);     mVelZ.resize(capacity, 0.0f);
+	mLife.resize(capacity, 0.0f);     mTimer.resize(capacity, 0.0f);    mScale.resize(capacity, 0.0f);
+	mColourR.resize(capacity, 0.0f);  mColourG.resize(capacity, 0.0f);  mColourB.resize(capacity, 0.0f);
+	mColourA.resize(capacity, 0.0f);  mRotation.resize(capacity, 0.0f);
+	mType.resize(capacity, 0);
+	mId.resize(capacity, 0);
+	mPayload.resize(capacity);
+	mCapacity = capacity;
+}
+
+
+// Add a particle to the end of the store, returns its index
+int ParticleStore::Add(const Firework& firework, const FireworkUpdate& fireworkUpdate)
+{
+	int i = AddRange(1);
+	Set(i, firework, fireworkUpdate);
+	return i;
+}
+
+
+// Add space for the given number of particles to the end of the store in one step, returns the index of the first
+int ParticleStore::AddRange(int count)
+{
+	if (mSize + count > mCapacity)
+	{
+		int newCapacity = mCapacity < 64 ? 64 : mCapacity * 2;
+		Reserve(newCapacity < mSize + count ? mSize + count : newCapacity);
+	}
+
+	int first = mSize;
+	mSize += count;
+	return first;
+}
+
+
+// Overwrite the particle at the given index
+void ParticleStore::Set(int i, const Firework& firework, const FireworkUpdate& fireworkUpdate)
+{
+	mPosX[i] = mPrevX[i] = firework.position.x;
+	mPosY[i] = mPrevY[i] = firework.position.y;
+	mPosZ[i] = mPrevZ[i] = firework.position.z;
+	mVelX[i] = fireworkUpdate.velocity.x;
+	mVelY[i] = fireworkUpdate.velocity.y;
+	mVelZ[i] = fireworkUpdate.velocity.z;
+	mLife[i]  = fireworkUpdate.life;
+	mTimer[i] = fireworkUpdate.timer;
+	mScale[i] = firework.scale;
+	mColourR[i] = firework.colour.r;
+	mColourG[i] = firework.colour.g;
+	mColourB[i] = firework.colour.b;
+	mColourA[i] = firework.colour.a;
+	mRotation[i] = firework.rotation;
+	mType[i] = static_cast<uint8_t>(fireworkUpdate.type);
+	mId[i]   = fireworkUpdate.id;
+	mPayload[i] = { fireworkUpdate.payloadTypeA,   fireworkUpdate.payloadTypeB,
+	                fireworkUpdate.payloadIntA,    fireworkUpdate.payloadIntB,
+	                fireworkUpdate.payloadColourA, fireworkUpdate.payloadColourB };
+}
+
+
+// Remove the particle at the given index by copying the last particle over it. Particle order is not preserved
+void ParticleStore::Remove(int index)
+{
+	--mSize;
+	if (index != mSize)  Move(mSize, index);
+}
+
+
+// Copy all columns of particle "from" over particle "to"
+void ParticleStore::Move(int from, int to)
+{
+	mPosX[to] = mPosX[from];  mPosY[to] = mPosY[from];  mPosZ[to] = mPosZ[from];
+	mPrevX[to] = mPrevX[from];  mPrevY[to] = mPrevY[from];  mPrevZ[to] = mPrevZ[from];
+	mVelX[to] = mVelX[from];  mVelY[to] = mVelY[from];  mVelZ[to] = mVelZ[from];
+	mLife[to]  = mLife[from];
+	mTimer[to] = mTimer[from];
+	mScale[to] = mScale[from];
+	mColourR[to] = mColourR[from];  mColourG[to] = mColourG[from];
+	mColourB[to] = mColourB[from];  mColourA[to] = mColourA[from];
+	mRotation[to] = mRotation[from];
+	mType[to]     = mType[from];
+	mId[to]       = mId[from];
+	mPayload[to]  = mPayload[from];
+}
+
+
+// Reconstruct the AoS form of a single particle (slow - debugging and tools only)
+Firework ParticleStore::GetFirework(int index) const
+{
+	Firework firework;
+	firework.position = { mPosX[index], mPosY[index], mPosZ[index] };
+	firework.scale    = mScale[index];
+	firework.colour   = { mColourR[index], mColourG[index], mColourB[index], mColourA[index] };
+	firework.rotation = mRotation[index];
+	return firework;
+}
+
+FireworkUpdate ParticleStore::GetFireworkUpdate(int index) const
+{
+	const FireworkPayload& payload = mPayload[index];
+
+	FireworkUpdate fireworkUpdate;
+	fireworkUpdate.type           = static_cast<FireworkType>(mType[index]);
+	fireworkUpdate.id             = mId[index];
+	fireworkUpdate.velocity       = { mVelX[index], mVelY[index], mVelZ[index] };
+	fireworkUpdate.life           = mLife[index];
+	fireworkUpdate.timer          = mTimer[index];
+	fireworkUpdate.payloadTypeA   = payload.typeA;
+	fireworkUpdate.payloadTypeB   = payload.typeB;
+	fireworkUpdate.payloadIntA    = payload.intA;
+	fireworkUpdate.payloadIntB    = payload.intB;
+	fireworkUpdate.payloadColourA = payload.colourA;
+	fireworkUpdate.payloadColourB = payload.colourB;
+	return fireworkUpdate;
+}
+
+
+// Column pointers for the given range of particles [begin, end)
+ParticleSpan ParticleStore::Span(int begin, int end)
+{
+	ParticleSpan span;
+	span.posX     = mPosX.data()     + begin;
+	span.prevX    = mPrevX.data()    + begin;
+	span.prevY    = mPrevY.data()    + begin;
+	span.prevZ    = mPrevZ.data()    + begin;
+	span.posY     = mPosY.data()     + begin;
+	span.posZ     = mPosZ.data()     + begin;
+	span.velX     = mVelX.data()     + begin;
+	span.velY     = mVelY.data()     + begin;
+	span.velZ     = mVelZ.data()     + begin;
+	span.life     = mLife.data()     + begin;
+	span.timer    = mTimer.data()    + begin;
+	span.scale    = mScale.data()    + begin;
+	span.colourR  = mColourR.data()  + begin;
+	span.colourG  = mColourG.data()  + begin;
+	span.colourB  = mColourB.data()  + begin;
+	span.colourA  = mColourA.data()  + begin;
+	span.rotation = mRotation.data() + begin;
+	span.type     = mType.data()     + begin;
+	span.id       = mId.data()       + begin;
+	span.payload  = mPayload.data()  + begin;
+	span.count    = end - begin;
+	return span;
+}
+
+
+// Write the render data of every particle into the given array in the Firework vertex layout
+void ParticleStore::GatherVertices(Firework* vertices, float interpolation) const
+{
+	// Simple loop over the columns - each column is read sequentially so this streams well,
+	// and the destination (usually write-combined GPU memory) is written strictly in order
+	for (int i = 0; i < mSize; ++i)
+	{
+		Firework& vertex = vertices[i];
+		vertex.position.x = mPrevX[i] + (mPosX[i] - mPrevX[i]) * interpolation;
+		vertex.position.y = mPrevY[i] + (mPosY[i] - mPrevY[i]) * interpolation;
+		vertex.position.z = mPrevZ[i] + (mPosZ[i] - mPrevZ[i]) * interpolation;
+		vertex.scale      = mScale[i];
+		vertex.colour.r   = mColourR[i];
+		vertex.colour.g   = mColourG[i];
+		vertex.colour.b   = mColourB[i];
+		vertex.colour.a   = mColourA[i];
+		vertex.rotation   = mRotation[i];
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// AoSoA particle store
+//--------------------------------------------------------------------------------------
+
+ParticleBlockStore::ParticleBlockStore(int capacity)
+	: mSize(0)
+{
+	Reserve(capacity);
+}
+
+
+void ParticleBlockStore::Reserve(int capacity)
+{
+	int numBlocks = (capacity + ParticleLaneWidth - 1) / ParticleLaneWidth;
+	if (numBlocks <= static_cast<int>(mBlocks.size()))  return;
+
+	mBlocks.resize(numBlocks, ParticleBlock{});
+	mPayload.resize(numBlocks * ParticleLaneWidth);
+}
+
+
+int ParticleBlockStore::Add(const Firework& firework, const FireworkUpdate& fireworkUpdate)
+{
+	int capacity = static_cast<int>(mBlocks.size()) * ParticleLaneWidth;
+	if (mSize == capacity)  Reserve(capacity < 64 ? 64 : capacity * 2);
+
+	int i = mSize++;
+	ParticleBlock& block = mBlocks[i / ParticleLaneWidth];
+	int lane = i % ParticleLaneWidth;
+	block.posX[lane] = block.prevX[lane] = firework.position.x;
+	block.posY[lane] = block.prevY[lane] = firework.position.y;
+	block.posZ[lane] = block.prevZ[lane] = firework.position.z;
+	block.velX[lane] = fireworkUpdate.velocity.x;
+	block.velY[lane] = fireworkUpdate.velocity.y;
+	block.velZ[lane] = fireworkUpdate.velocity.z;
+	block.life[lane]  = fireworkUpdate.life;
+	block.timer[lane] = fireworkUpdate.timer;
+	block.scale[lane] = firework.scale;
+	block.colourR[lane] = firework.colour.r;
+	block.colourG[lane] = firework.colour.g;
+	block.colourB[lane] = firework.colour.b;
+	block.colourA[lane] = firework.colour.a;
+	block.rotation[lane] = firework.rotation;
+	block.type[lane] = static_cast<uint8_t>(fireworkUpdate.type);
+	block.id[lane]   = fireworkUpdate.id;
+	mPayload[i] = { fireworkUpdate.payloadTypeA,   fireworkUpdate.payloadTypeB,
+	                fireworkUpdate.payloadIntA,    fireworkUpdate.payloadIntB,
+	                fireworkUpdate.payloadColourA, fireworkUpdate.payloadColourB };
+	return i;
+}
+
+
+void ParticleBlockStore::Remove(int index)
+{
+	--mSize;
+	if (index != mSize)  Move(mSize, index);
+}
+
+
+void ParticleBlockStore::Move(int from, int to)
+{
+	const ParticleBlock& src = mBlocks[from / ParticleLaneWidth];
+	ParticleBlock&       dst = mBlocks[to   / ParticleLaneWidth];
+	int s = from % ParticleLaneWidth;
+	int d = to   % ParticleLaneWidth;
+	dst.posX[d] = src.posX[s];  dst.posY[d] = src.posY[s];  dst.posZ[d] = src.posZ[s];
+	dst.prevX[d] = src.prevX[s];  dst.prevY[d] = src.prevY[s];  dst.prevZ[d] = src.prevZ[s];
+	dst.velX[d] = src.velX[s];  dst.velY[d] = src.velY[s];  dst.velZ[d] = src.velZ[s];
+	dst.life[d]  = src.life[s];
+	dst.timer[d] = src.timer[s];
+	dst.scale[d] = src.scale[s];
+	dst.colourR[d] = src.colourR[s];  dst.colourG[d] = src.colourG[s];
+	dst.colourB[d] = src.colourB[s];  dst.colourA[d] = src.colourA[s];
+	dst.rotation[d] = src.rotation[s];
+	dst.type[d]     = src.type[s];
+	dst.id[d]       = src.id[s];
+	mPayload[to] = mPayload[from];
+}
+
+
+Firework ParticleBlockStore::GetFirework(int index) const
+{
+	const ParticleBlock& block = mBlocks[index / ParticleLaneWidth];
+	int lane = index % ParticleLaneWidth;
+
+	Firework firework;
+	firework.position = { block.posX[lane], block.posY[lane], block.posZ[lane] };
+	firework.scale    = block.scale[lane];
+	firework.colour   = { block.colourR[lane], block.colourG[lane], block.colourB[lane], block.colourA[lane] };
+	firework.rotation = block.rotation[lane];
+	return firework;
+}
+
+FireworkUpdate ParticleBlockStore::GetFireworkUpdate(int index) const
+{
+	const ParticleBlock&   block   = mBlocks[index / ParticleLaneWidth];
+	const FireworkPayload& payload = mPayload[index];
+	int lane = index % ParticleLaneWidth;
+
+	FireworkUpdate fireworkUpdate;
+	fireworkUpdate.type           = static_cast<FireworkType>(block.type[lane]);
+	fireworkUpdate.id             = block.id[lane];
+	fireworkUpdate.velocity       = { block.velX[lane], block.velY[lane], block.velZ[lane] };
+	fireworkUpdate.life           = block.life[lane];
+	fireworkUpdate.timer          = block.timer[lane];
+	fireworkUpdate.payloadTypeA   = payload.typeA;
+	fireworkUpdate.payloadTypeB   = payload.typeB;
+	fireworkUpdate.payloadIntA    = payload.intA;
+	fireworkUpdate.payloadIntB    = payload.intB;
+	fireworkUpdate.payloadColourA = payload.colourA;
+	fireworkUpdate.payloadColourB = payload.colourB;
+	return fireworkUpdate;
+}
+
+
+FireworkType ParticleBlockStore::Type(int index) const
+{
+	return static_cast<FireworkType>(mBlocks[index / ParticleLaneWidth].type[index % ParticleLaneWidth]);
+}
+
+
+// Column pointers for one block, count is the number of used particles in the block
+ParticleSpan ParticleBlockStore::Block(int blockIndex)
+{
+	ParticleBlock& block = mBlocks[blockIndex];
+
+	ParticleSpan span;
+	span.posX     = block.posX;
+	span.prevX    = block.prevX;
+	span.prevY    = block.prevY;
+	span.prevZ    = block.prevZ;
+	span.posY     = block.posY;
+	span.posZ     = block.posZ;
+	span.velX     = block.velX;
+	span.velY     = block.velY;
+	span.velZ     = block.velZ;
+	span.life     = block.life;
+	span.timer    = block.timer;
+	span.scale    = block.scale;
+	span.colourR  = block.colourR;
+	span.colourG  = block.colourG;
+	span.colourB  = block.colourB;
+	span.colourA  = block.colourA;
+	span.rotation = block.rotation;
+	span.type     = block.type;
+	span.id       = block.id;
+	span.payload  = mPayload.data() + blockIndex * ParticleLaneWidth;
+
+	int remaining = mSize - blockIndex * ParticleLaneWidth;
+	span.count = remaining < ParticleLaneWidth ? remaining : ParticleLaneWidth;
+	return span;
+}
+
+
+void ParticleBlockStore::GatherVertices(Firework* vertices, float interpolation) const
+{
+	for (int i = 0; i < mSize; ++i)
+	{
+		const ParticleBlock& block = mBlocks[i / ParticleLaneWidth];
+		int lane = i % ParticleLaneWidth;
+
+		Firework& vertex = vertices[i];
+		vertex.position.x = block.prevX[lane] + (block.posX[lane] - block.prevX[lane]) * interpolation;
+		vertex.position.y = block.prevY[lane] + (block.posY[lane] - block.prevY[lane]) * interpolation;
+		vertex.position.z = block.prevZ[lane] + (block.posZ[lane] - block.prevZ[lane]) * interpolation;
+		vertex.scale      = block.scale[lane];
+		vertex.colour.r   = block.colourR[lane];
+		vertex.colour.g   = block.colourG[lane];
+		vertex.colour.b   = block.colourB[lane];
+		vertex.colour.a   = block.colourA[lane];
+		vertex.rotation   = block.rotation[lane];
+	}
+}
@@ -0,0 +1,223 @@
+//--------------------------------------------------------------------------------------
+// Structure-of-arrays storage for firework particles
+//--------------------------------------------------------------------------------------
+// Each particle value is held in its own aligned column (all x positions together, all
+// y positions together etc.), so update loops only pull the data they actually use into
+// the cache and can process several particles per SIMD instruction. The Firework render
+// structure is rebuilt from the columns when uploading to the GPU (GatherVertices)
+// Code in .cpp file
+
+#ifndef _PARTICLE_STORE_H_INCLUDED_
+#define _PARTICLE_STORE_H_INCLUDED_
+
+#include "FireworkTypes.h"
+#include "AlignedAllocator.h"
+
+#include <stdint.h>
+#include <cstddef>
+
+
+// Columns are padded to a multiple of this many particles so SIMD loops can always work in whole registers
+const int ParticleLaneWidth = 8;
+
+
+// A view of a range of particles: one pointer per column plus a count. Update kernels work on these
+// rather than on a particular container so they can be used on the SoA store, one AoSoA block, or a sub-range
+struct ParticleSpan
+{
+	float*   posX;
+	float*   posY;
+	float*   posZ;
+	float*   prevX;    // Position before the last update, for interpolating when rendering between updates
+	float*   prevY;
+	float*   prevZ;
+	float*   velX;
+	float*   velY;
+	float*   velZ;
+	float*   life;
+	float*   timer;
+	float*   scale;
+	float*   colourR;
+	float*   colourG;
+	float*   colourB;
+	float*   colourA;
+	float*   rotation;
+	uint8_t* type;     // FireworkType stored as a byte
+	uint32_t* id;      // Keys the particle's random numbers
+	FireworkPayload* payload; // Cold - only read when a rocket bursts
+
+	int count;
+};
+
+// Copy every column of the particles in "source" to "destination", which must have space for source.count particles.
+// One memcpy per column, so this is the fast way to move many particles between stores
+void CopyParticles(const ParticleSpan& destination, const ParticleSpan& source);
+
+// Write the render data of the particles in the span into the given array in the Firework vertex layout, see
+// ParticleStore::GatherVertices
+void GatherVertices(const ParticleSpan& particles, Firework* vertices, float interpolation = 1.0f);
+
+
+//--------------------------------------------------------------------------------------
+// SoA particle store
+//--------------------------------------------------------------------------------------
+
+class ParticleStore
+{
+public:
+	// Construction //
+
+	// Optionally reserve space for the given number of particles (the store grows if needed)
+	ParticleStore(int capacity = 0);
+
+
+	// Size //
+
+	int  Size()     const { return mSize; }
+	int  Capacity() const { return mCapacity; }
+	bool Empty()    const { return mSize == 0; }
+
+	// Ensure space for at least the given number of particles without reallocating
+	void Reserve(int capacity);
+
+	// Remove all particles (keeps capacity)
+	void Clear() { mSize = 0; }
+
+
+	// Adding / removing //
+
+	// Add a particle to the end of the store, returns its index
+	int Add(const Firework& firework, const FireworkUpdate& fireworkUpdate);
+
+	// Add space for the given number of particles to the end of the store in one step, returns the index of the first.
+	// The new particles are uninitialised, fill them in with Set
+	int AddRange(int count);
+
+	// Overwrite the particle at the given index
+	void Set(int index, const Firework& firework, const FireworkUpdate& fireworkUpdate);
+
+	// Remove the particle at the given index by copying the last particle over it. Particle order is not preserved
+	void Remove(int index);
+
+	// Drop the particles from the given index onwards, e.g. after compacting the columns (see CompactParticles)
+	void Truncate(int size) { if (size < mSize)  mSize = size; }
+
+
+	// Access //
+
+	// Reconstruct the AoS form of a single particle (slow - debugging and tools only)
+	Firework       GetFirework      (int index) const;
+	FireworkUpdate GetFireworkUpdate(int index) const;
+
+	FireworkType           Type   (int index) const { return static_cast<FireworkType>(mType[index]); }
+	const FireworkPayload& Payload(int index) const { return mPayload[index]; }
+
+	// Column pointers for the given range of particles [begin, end), or the whole store
+	ParticleSpan Span(int begin, int end);
+	ParticleSpan Span() { return Span(0, mSize); }
+
+
+	// Rendering //
+
+	// Write the render data of every particle into the given array in the Firework vertex layout. The array
+	// must have space for Size() elements - typically it is a mapped GPU vertex buffer. Positions are interpolated
+	// between the previous and current update: 0 = previous position, 1 = current position
+	void GatherVertices(Firework* vertices, float interpolation = 1.0f) const;
+
+
+private:
+	// Copy all columns of particle "from" over particle "to"
+	void Move(int from, int to);
+
+	int mSize;
+	int mCapacity;
+
+	// Hot columns - updated every frame
+	AlignedVector<float> mPosX, mPosY, mPosZ;
+	AlignedVector<float> mPrevX, mPrevY, mPrevZ;
+	AlignedVector<float> mVelX, mVelY, mVelZ;
+	AlignedVector<float> mLife;
+	AlignedVector<float> mTimer;
+
+	// Warm columns - updated for some types only
+	AlignedVector<float> mScale;
+	AlignedVector<float> mColourR, mColourG, mColourB, mColourA;
+
+	// Cold columns - set at spawn time
+	AlignedVector<float>   mRotation;
+	AlignedVector<uint8_t> mType;
+	AlignedVector<uint32_t> mId;
+	AlignedVector<FireworkPayload> mPayload;
+};
+
+
+//--------------------------------------------------------------------------------------
+// AoSoA particle store
+//--------------------------------------------------------------------------------------
+// Alternative layout: particles are grouped in blocks of ParticleLaneWidth, and each block holds its own
+// short columns. All the data for a group of particles sits in a few adjacent cache lines, which suits
+// spawning and removal better than SoA while still allowing full-width SIMD within a block
+
+struct alignas(DefaultColumnAlignment) ParticleBlock
+{
+	float   posX[ParticleLaneWidth];
+	float   posY[ParticleLaneWidth];
+	float   posZ[ParticleLaneWidth];
+	float   prevX[ParticleLaneWidth];
+	float   prevY[ParticleLaneWidth];
+	float   prevZ[ParticleLaneWidth];
+	float   velX[ParticleLaneWidth];
+	float   velY[ParticleLaneWidth];
+	float   velZ[ParticleLaneWidth];
+	float   life[ParticleLaneWidth];
+	float   timer[ParticleLaneWidth];
+	float   scale[ParticleLaneWidth];
+	float   colourR[ParticleLaneWidth];
+	float   colourG[ParticleLaneWidth];
+	float   colourB[ParticleLaneWidth];
+	float   colourA[ParticleLaneWidth];
+	float    rotation[ParticleLaneWidth];
+	uint32_t id[ParticleLaneWidth];
+	uint8_t  type[ParticleLaneWidth]; // Last, as it is the only column shorter than a SIMD register
+};
+
+// Every 4-byte column must start on a SIMD register boundary, like the columns of the SoA store
+static_assert(offsetof(ParticleBlock, id) % DefaultColumnAlignment == 0, "ParticleBlock columns must be aligned");
+static_assert(sizeof(float) * ParticleLaneWidth % DefaultColumnAlignment == 0, "ParticleBlock columns must be aligned");
+
+class ParticleBlockStore
+{
+public:
+	ParticleBlockStore(int capacity = 0);
+
+	int  Size()      const { return mSize; }
+	int  NumBlocks() const { return (mSize + ParticleLaneWidth - 1) / ParticleLaneWidth; }
+	bool Empty()     const { return mSize == 0; }
+
+	void Reserve(int capacity);
+	void Clear() { mSize = 0; }
+
+	int  Add(const Firework& firework, const FireworkUpdate& fireworkUpdate);
+	void Remove(int index);
+
+	Firework       GetFirework      (int index) const;
+	FireworkUpdate GetFireworkUpdate(int index) const;
+
+	FireworkType           Type   (int index) const;
+	const FireworkPayload& Payload(int index) const { return mPayload[index]; }
+
+	// Column pointers for one block, count is the number of used particles in the block (the last block may be partial)
+	ParticleSpan Block(int blockIndex);
+
+	void GatherVertices(Firework* vertices, float interpolation = 1.0f) const;
+
+private:
+	void Move(int from, int to);
+
+	int mSize;
+	AlignedVector<ParticleBlock>   mBlocks;
+	AlignedVector<FireworkPayload> mPayload;
+};
+
+
+#endif //_PARTICLE_STORE_H_INCLUDED_
@@ -0,0 +1,90 @@
+//--------------------------------------------------------------------------------------
+// Particle timeline - a show stored as spawn states, evaluated at any time in closed form
+//--------------------------------------------------------------------------------------
+
+#include "ParticleTimeline.h"
+#include "ParticleMotion.h"
+
+#include <algorithm>
+
+
+void ParticleTimeline::Clear()
+{
+	mSpawned.Clear();
+	mBatches.clear();
+	mMaxLife = 0;
+}
+
+
+void ParticleTimeline::Record(const ParticleSpan& spawned, double time)
+{
+	if (spawned.count == 0)  return;
+
+	// Particles spawned at the same time as the last batch join it
+	int begin = mSpawned.AddRange(spawned.count);
+	if (mBatches.empty() || mBatches.back().time != time)  mBatches.push_back({ time, begin });
+	CopyParticles(mSpawned.Span(begin, begin + spawned.count), spawned);
+	for (int i = 0; i < spawned.count; ++i)  mMaxLife = spawned.life[i] > mMaxLife ? spawned.life[i] : mMaxLife;
+}
+
+
+// Batches spawned more than the longest life ago are all dead, so the search starts from the first batch after that
+template <class F>
+void ParticleTimeline::ForEachLiveBatch(double time, F&& f)
+{
+	auto first = std::upper_bound(mBatches.begin(), mBatches.end(), time - mMaxLife,
+	                              [](double t, const Batch& batch) { return t < batch.time; });
+	for (auto batch = first; batch != mBatches.end() && batch->time <= time; ++batch)
+	{
+		int end = batch + 1 != mBatches.end() ? (batch + 1)->begin : mSpawned.Size();
+		f(batch->begin, end, static_cast<float>(time - batch->time));
+	}
+}
+
+
+int ParticleTimeline::CountAlive(double time)
+{
+	int numAlive = 0;
+	ForEachLiveBatch(time, [&](int begin, int end, float age)
+	{
+		const float* life = mSpawned.Span().life;
+		for (int i = begin; i < end; ++i)  numAlive += life[i] > age ? 1 : 0;
+	});
+	return numAlive;
+}
+
+
+void ParticleTimeline::Evaluate(double time, ParticleStore& particles)
+{
+	ForEachLiveBatch(time, [&](int begin, int end, float age)
+	{
+		// Copy each run of records still alive across, then move them all to their age in place
+		const float* life = mSpawned.Span().life;
+		int first = particles.Size();
+		for (int run = begin; run < end; )
+		{
+			if (life[run] <= age)
+			{
+				++run;
+				continue;
+			}
+			int runEnd = run + 1;
+			while (runEnd < end && life[runEnd] > age)  ++runEnd;
+			int to = particles.AddRange(runEnd - run);
+			CopyParticles(particles.Span(to, to + (runEnd - run)), mSpawned.Span(run, runEnd));
+			run = runEnd;
+		}
+		ParticleSpan live = particles.Span(first, particles.Size());
+		EvaluateParticles(live, live, age, mStepTime, mGravity);
+	});
+}
+
+
+int ParticleTimeline::GatherVertices(double time, Firework* vertices)
+{
+	// Evaluated exactly at the time, so there is nothing to interpolate
+	mScratch.Clear();
+	Evaluate(time, mScratch);
+	::GatherVertices(mScratch.Span(), vertices);
+	return mScratch.Size();
+}
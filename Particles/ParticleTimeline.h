@@ -0,0 +1,80 @@
+//--------------------------------------------------------------------------------------
+// Particle timeline - a show stored as spawn states, evaluated at any time in closed form
+//--------------------------------------------------------------------------------------
+// Every particle is recorded once, in its state when it was spawned, with the time it was
+// spawned. The particles alive at any time are then worked out directly from those records
+// (see ParticleMotion.h), with nothing integrated, so the show can be played at any rate,
+// backwards, or seeked to any point. Records are kept in spawn time order in batches that
+// share a spawn time, so only the batches spawned within the longest life before the time
+// are looked at. Particles only die of old age here - particles evicted from the simulation
+// to make room for others (see EvictForSpawnBuffers) stay in the timeline
+// Code in .cpp file
+
+#ifndef _PARTICLE_TIMELINE_H_INCLUDED_
+#define _PARTICLE_TIMELINE_H_INCLUDED_
+
+#include "ParticleStore.h"
+
+#include <vector>
+
+
+class ParticleTimeline
+{
+public:
+	// Construction //
+
+	// Records are evaluated with the given step time and gravity - use the simulation's to match it (see
+	// ParticleMotion.h). A step time of 0 evaluates the continuous motion instead
+	ParticleTimeline(float stepTime, float gravity) : mStepTime(stepTime), mGravity(gravity) {}
+
+	// Remove all records
+	void Clear();
+
+
+	// Recording //
+
+	// Add particles spawned at the given time, in their state at spawn. Times must not go down from one call to the next
+	void Record(const ParticleSpan& spawned, double time);
+
+	// Number of particles recorded, and the time of the last spawn
+	int    Size()    const { return mSpawned.Size(); }
+	double EndTime() const { return mBatches.empty() ? 0.0 : mBatches.back().time; }
+
+
+	// Evaluation //
+
+	// Number of particles alive at the given time
+	int CountAlive(double time);
+
+	// Put the full state of every particle alive at the given time at the end of "particles", in spawn order
+	void Evaluate(double time, ParticleStore& particles);
+
+	// Write the render data of every particle alive at the given time into the array in the Firework vertex layout, in
+	// spawn order. The array must have space for CountAlive(time) elements. Returns the number written
+	int GatherVertices(double time, Firework* vertices);
+
+
+private:
+	// Particles [begin, next batch's begin) were spawned at the time
+	struct Batch
+	{
+		double time;
+		int    begin;
+	};
+
+	// Call f(begin, end, age) for each batch that may have particles alive at the given time, with its range of records
+	// and its age then
+	template <class F>
+	void ForEachLiveBatch(double time, F&& f);
+
+	ParticleStore      mSpawned;
+	std::vector<Batch> mBatches;
+	float mStepTime;
+	float mGravity;
+	float mMaxLife = 0; // Longest life of any particle recorded
+
+	ParticleStore mScratch; // Space to evaluate a batch in
+};
+
+
+#endif //_PARTICLE_TIMELINE_H_INCLUDED_
@@ -0,0 +1,188 @@
+//--------------------------------------------------------------------------------------
+// Buffers that collect new particles during a parallel update, merged into the store afterwards
+//--------------------------------------------------------------------------------------
+
+#include "SpawnBuffer.h"
+
+#include <algorithm>
+
+
+// Append the contents of all the given buffers to the pool streams, in buffer order, then clear the buffers
+int CommitSpawnBuffers(ParticlePool& particles, std::vector<SpawnBuffer>& buffers, WorkerPool* pool)
+{
+	const int numBuffers = static_cast<int>(buffers.size());
+
+	// Number of particles of each stream that fit from each buffer, taking buffers in order until the pool is full
+	std::vector<int> counts(numBuffers * NumParticleStreams);
+	int space = particles.MaxParticles() - particles.Size();
+	if (space < 0)  space = 0;
+	int requested = 0;
+	for (int b = 0; b < numBuffers; ++b)
+	{
+		for (int s = 0; s < NumParticleStreams; ++s)
+		{
+			int size = buffers[b].Size(s);
+			int fits = size < space ? size : space;
+			counts[b * NumParticleStreams + s] = fits;
+			space     -= fits;
+			requested += size;
+		}
+	}
+
+	// Exclusive prefix sum of the counts gives the offset of each buffer within each stream's new range
+	std::vector<int> offsets(numBuffers * NumParticleStreams);
+	int first[NumParticleStreams];
+	int added = 0;
+	for (int s = 0; s < NumParticleStreams; ++s)
+	{
+		int total = 0;
+		for (int b = 0; b < numBuffers; ++b)
+		{
+			offsets[b * NumParticleStreams + s] = total;
+			total += counts[b * NumParticleStreams + s];
+		}
+
+		// Reserve the whole range of each stream in one step, then each buffer fills its own part of it
+		first[s] = particles.AddRange(s, total);
+		added += total;
+	}
+
+	auto copyBuffer = [&](int b)
+	{
+		for (int s = 0; s < NumParticleStreams; ++s)
+		{
+			int count = counts[b * NumParticleStreams + s];
+			if (count == 0)  continue;
+
+			// A ring may split the range at block boundaries
+			int begin = first[s] + offsets[b * NumParticleStreams + s];
+			particles.ForEachSpan(s, begin, begin + count, [&](const ParticleSpan& span, int offset)
+			{
+				CopyParticles(span, buffers[b].staged[s].Span(offset, offset + span.count));
+			});
+		}
+	};
+
+	if (pool != nullptr)  pool->ParallelFor(numBuffers, copyBuffer);
+	else                  for (int b = 0; b < numBuffers; ++b)  copyBuffer(b);
+
+	for (auto& buffer : buffers)  buffer.Clear();
+	return requested - added;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Eviction
+//--------------------------------------------------------------------------------------
+
+int EvictionClass(FireworkType type)
+{
+	switch (type)
+	{
+		case FireworkType::StarSimple:     return 0; // Burst stars and trail sparks
+		case FireworkType::StarSmallTrail: return 1; // Stars that still have a trail to emit
+		default:                           return RocketEvictionClass;
+	}
+}
+
+
+// Worth of one particle, compared by class, then visibility. Stream and index make the order strict, so ties between
+// ring fronts always go the same way
+struct EvictionKey
+{
+	int   evictionClass;
+	float visibility;
+	int   stream; // Type bucket or lifetime class ring, see ParticleStream
+	int   index;
+
+	bool operator<(const EvictionKey& other) const
+	{
+		if (evictionClass != other.evictionClass)  return evictionClass < other.evictionClass;
+		if (visibility    != other.visibility)     return visibility    < other.visibility;
+		if (stream        != other.stream)         return stream        < other.stream;
+		return index < other.index;
+	}
+};
+
+// True if a is worth less than b - tie-breaks don't count
+static bool WorthLess(const EvictionKey& a, const EvictionKey& b)
+{
+	if (a.evictionClass != b.evictionClass)  return a.evictionClass < b.evictionClass;
+	return a.visibility < b.visibility;
+}
+
+// Key of particle i of the span, which is in the given stream at the given index
+static EvictionKey KeyOf(const ParticleSpan& p, int i, int stream, int index)
+{
+	return { EvictionClass(StreamType(stream)), p.life[i] * p.colourA[i] * p.scale[i], stream, index };
+}
+
+
+int EvictForSpawnBuffers(ParticlePool& particles, std::vector<SpawnBuffer>& buffers, const int* deadByType, int* popByClass,
+                         int* evictedByType)
+{
+	for (int t = 0; t < NumFireworkTypes; ++t)  evictedByType[t] = 0;
+
+	// Space after the dead are removed, as CommitSpawnBuffers will see it
+	int numLive = particles.Size();
+	for (int t = 0; t < NumFireworkTypes;   ++t)  numLive -= deadByType[t];
+	for (int c = 0; c < NumLifetimeClasses; ++c)  numLive -= popByClass[c];
+	int space = particles.MaxParticles() - numLive;
+	if (space < 0)  space = 0;
+
+	int numStaged = 0;
+	for (auto& buffer : buffers)  numStaged += buffer.Size();
+	if (numStaged <= space)  return 0;
+
+	// Key of the particle at the front of a ring once the ones already leaving it have gone, if it can be evicted
+	auto ringFront = [&](int c, EvictionKey& key)
+	{
+		ParticleRing& ring = particles.Ring(c);
+		int stream = NumFireworkTypes + c;
+		if (EvictionClass(StreamType(stream)) >= RocketEvictionClass || popByClass[c] >= ring.Size())  return false;
+
+		int i;
+		ParticleSpan p = ring.Locate(popByClass[c], i);
+		key = KeyOf(p, i, stream, popByClass[c]);
+		return true;
+	};
+
+	// The commit takes particles in order, so pair each particle that would be dropped, in commit order (buffers in order,
+	// streams in order within a buffer), with the cheapest ring front and stop at the first one that isn't worth more. The
+	// ones after it would not be committed anyway. Each pairing looks at one particle per ring, so the cost is O(1) per
+	// particle evicted however full the pool is
+	int numEvicted = 0;
+	int position = 0;
+	for (auto& buffer : buffers)
+	{
+		for (int s = 0; s < NumParticleStreams; ++s)
+		{
+			ParticleStore& staged = buffer.staged[s];
+			int first = std::max(space - position, 0);
+			position += staged.Size();
+
+			ParticleSpan p = staged.Span();
+			for (int i = first; i < p.count; ++i)
+			{
+				EvictionKey newcomer = KeyOf(p, i, s, i);
+				bool found = false;
+				EvictionKey cheapest = {};
+				for (int c = 0; c < NumLifetimeClasses; ++c)
+				{
+					EvictionKey front;
+					if (ringFront(c, front) && (!found || front < cheapest))
+					{
+						cheapest = front;
+						found = true;
+					}
+				}
+				if (!found || !WorthLess(cheapest, newcomer))  return numEvicted;
+
+				++popByClass[cheapest.stream - NumFireworkTypes];
+				++evictedByType[static_cast<int>(StreamType(cheapest.stream))];
+				++numEvicted;
+			}
+		}
+	}
+	return numEvicted;
+}
@@ -0,0 +1,99 @@
+//--------------------------------------------------------------------------------------
+// Buffers that collect new particles during a parallel update, merged into the store afterwards
+//--------------------------------------------------------------------------------------
+// Emitters cannot add to the ParticlePool while it is being updated by several threads.
+// Instead each update task writes the particles it spawns into its own SpawnBuffer, and all
+// buffers are committed to the pool in one step after the update, in task order. Since the
+// tasks are fixed ranges of particles the result is the same whatever the number of threads
+//
+// Spawning is done in bulk: an emitter reserves a contiguous range of N particles of one type
+// with Reserve, then fills the returned columns in one go (see the spawn kernels in ParticleKernels.h).
+// The buffer holds one small SoA store per stream of the pool (type bucket or lifetime class
+// ring, see ParticlePool.h), so committing is a column copy per stream. Instanced bursts (see
+// BurstInstances.h) are collected alongside and committed by the simulation
+// Code in .cpp file
+
+#ifndef _SPAWN_BUFFER_H_INCLUDED_
+#define _SPAWN_BUFFER_H_INCLUDED_
+
+#include "ParticlePool.h"
+#include "BurstInstances.h"
+#include "WorkerPool.h"
+
+#include <vector>
+
+
+struct SpawnBuffer
+{
+	ParticleStore staged[NumParticleStreams]; // Spawned particles waiting to be committed, one store per stream
+	std::vector<BurstInstance> bursts;        // Instanced bursts waiting to be committed, not counted in Size()
+
+	// Scratch space for RunEmitters (see Emitter.h), one entry per emitter of the span being run. Kept here so each
+	// worker's buffer keeps its capacity from step to step
+	std::vector<float> emitterRates;
+	std::vector<int>   emitterEmissions;
+
+	// Add space for "count" new particles of the given type in one step and return their columns for the caller to fill.
+	// They must be given the life passed here, which chooses their stream. The span is only valid until the next Reserve
+	// or Add to the same stream
+	ParticleSpan Reserve(FireworkType type, int count, float life)
+	{
+		ParticleStore& store = staged[ParticleStream(type, life)];
+		int first = store.AddRange(count);
+		return store.Span(first, first + count);
+	}
+
+	// Add a single particle (for occasional spawns, e.g. launches from the UI)
+	void Add(const Firework& firework, const FireworkUpdate& fireworkUpdate)
+	{
+		staged[ParticleStream(fireworkUpdate.type, fireworkUpdate.life)].Add(firework, fireworkUpdate);
+	}
+
+	int Size(int stream) const { return staged[stream].Size(); }
+	int Size() const
+	{
+		int size = 0;
+		for (const auto& store : staged)  size += store.Size();
+		return size;
+	}
+
+	void Clear() // Keeps capacity, so no allocations after the first few frames
+	{
+		for (auto& store : staged)  store.Clear();
+		bursts.clear();
+	}
+};
+
+
+// Append the contents of all the given buffers to the streams of the particle pool, in buffer order,
+// then clear the buffers. The pool will not be allowed to grow past its MaxParticles - particles from later
+// buffers are dropped first (and within a buffer, later streams first). A prefix sum over the per-type sizes
+// of the buffers gives each buffer its own range in each bucket, so the copies can run in parallel on the
+// given worker pool (pass nullptr to copy on the calling thread). Returns the number of particles dropped
+int CommitSpawnBuffers(ParticlePool& particles, std::vector<SpawnBuffer>& buffers, WorkerPool* pool);
+
+
+
+//--------------------------------------------------------------------------------------
+// Eviction
+//--------------------------------------------------------------------------------------
+// When the pool is full, a new particle can take the place of an existing one that is worth less. A particle's worth
+// is its eviction class, then its visibility (life x alpha x scale), so nearly invisible stars go first. Rockets are
+// never evicted, and never dropped in favour of stars since launches and bursts are committed first
+
+// Eviction class of a type - higher is more important. Rockets are the highest class and are never evicted
+int EvictionClass(FireworkType type);
+const int RocketEvictionClass = 2;
+
+// Make room for new particles in the buffers that CommitSpawnBuffers would drop. Run after the update has found the
+// dead (deadByType for the buckets, the first popByClass[c] of each ring) and before they are removed. Each particle that
+// would be dropped, in commit order, evicts the least valuable particle at the front of a lifetime class ring if that is
+// worth less than it, by adding one to popByClass[c]. The rings are the priority structure: their particles all age at
+// the same rate, so each ring is in order of remaining life and its front is the cheapest to lose, and finding the
+// one to evict is O(1). Stars in the type buckets (only those spawned with a life outside the lifetime classes, which
+// the simulation's own bursts and trails never are) are not evicted, as finding the cheapest of them would mean a search
+// of the buckets every step. Returns the number evicted, and the number of each type in evictedByType
+int EvictForSpawnBuffers(ParticlePool& particles, std::vector<SpawnBuffer>& buffers, const int* deadByType, int* popByClass,
+                         int* evictedByType);
+
+#endif //_SPAWN_BUFFER_H_INCLUDED_
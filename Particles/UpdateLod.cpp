@@ -0,0 +1,123 @@
+//--------------------------------------------------------------------------------------
+// Update level of detail - distant and off-screen particles updated less often
+//--------------------------------------------------------------------------------------
+
+#include "UpdateLod.h"
+#include "ParticleKernels.h"
+
+#include <cmath>
+
+#if SIMD_X86_AVAILABLE
+	#include <immintrin.h>
+#endif
+
+
+UpdateLodView MakeUpdateLodView(const CMatrix4x4& viewMatrix, const CMatrix4x4& projectionMatrix, float viewportWidth)
+{
+	UpdateLodView view;
+	view.cull = MakeCullView(viewMatrix, projectionMatrix, viewportWidth);
+	return view;
+}
+
+
+// Bounds of a group: box round the positions, largest particle and fastest particle (|x| + |y| + |z| is never less than
+// the speed)
+struct GroupBounds
+{
+	float minX, minY, minZ;
+	float maxX, maxY, maxZ;
+	float maxSize, maxSpeed;
+};
+
+static void AddToBoundsScalar(const ParticleSpan& p, int begin, int end, GroupBounds& b)
+{
+	for (int i = begin; i < end; ++i)
+	{
+		float x = p.posX[i], y = p.posY[i], z = p.posZ[i];
+		float size  = std::fabs(p.scale[i]);
+		float speed = std::fabs(p.velX[i]) + std::fabs(p.velY[i]) + std::fabs(p.velZ[i]);
+		b.minX = x < b.minX ? x : b.minX;  b.maxX = x > b.maxX ? x : b.maxX;
+		b.minY = y < b.minY ? y : b.minY;  b.maxY = y > b.maxY ? y : b.maxY;
+		b.minZ = z < b.minZ ? z : b.minZ;  b.maxZ = z > b.maxZ ? z : b.maxZ;
+		b.maxSize  = size  > b.maxSize  ? size  : b.maxSize;
+		b.maxSpeed = speed > b.maxSpeed ? speed : b.maxSpeed;
+	}
+}
+
+#if SIMD_X86_AVAILABLE
+
+// SSE2 version - 4 particles at a time into lane-wise bounds, then the lanes are combined
+static void AddToBoundsSSE2(const ParticleSpan& p, GroupBounds& b)
+{
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 minX = _mm_set1_ps(b.minX), minY = _mm_set1_ps(b.minY), minZ = _mm_set1_ps(b.minZ);
+	__m128 maxX = _mm_set1_ps(b.maxX), maxY = _mm_set1_ps(b.maxY), maxZ = _mm_set1_ps(b.maxZ);
+	__m128 maxSize = _mm_set1_ps(b.maxSize), maxSpeed = _mm_set1_ps(b.maxSpeed);
+
+	int i = 0;
+	for (; i + 4 <= p.count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(p.posX + i), y = _mm_loadu_ps(p.posY + i), z = _mm_loadu_ps(p.posZ + i);
+		minX = _mm_min_ps(minX, x);  maxX = _mm_max_ps(maxX, x);
+		minY = _mm_min_ps(minY, y);  maxY = _mm_max_ps(maxY, y);
+		minZ = _mm_min_ps(minZ, z);  maxZ = _mm_max_ps(maxZ, z);
+		maxSize = _mm_max_ps(maxSize, _mm_and_ps(absMask, _mm_loadu_ps(p.scale + i)));
+		__m128 speed = _mm_add_ps(_mm_add_ps(_mm_and_ps(absMask, _mm_loadu_ps(p.velX + i)),
+		                                     _mm_and_ps(absMask, _mm_loadu_ps(p.velY + i))),
+		                          _mm_and_ps(absMask, _mm_loadu_ps(p.velZ + i)));
+		maxSpeed = _mm_max_ps(maxSpeed, speed);
+	}
+
+	alignas(16) float lanes[8][4];
+	_mm_store_ps(lanes[0], minX);  _mm_store_ps(lanes[1], minY);  _mm_store_ps(lanes[2], minZ);
+	_mm_store_ps(lanes[3], maxX);  _mm_store_ps(lanes[4], maxY);  _mm_store_ps(lanes[5], maxZ);
+	_mm_store_ps(lanes[6], maxSize);  _mm_store_ps(lanes[7], maxSpeed);
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		b.minX = lanes[0][lane] < b.minX ? lanes[0][lane] : b.minX;
+		b.minY = lanes[1][lane] < b.minY ? lanes[1][lane] : b.minY;
+		b.minZ = lanes[2][lane] < b.minZ ? lanes[2][lane] : b.minZ;
+		b.maxX = lanes[3][lane] > b.maxX ? lanes[3][lane] : b.maxX;
+		b.maxY = lanes[4][lane] > b.maxY ? lanes[4][lane] : b.maxY;
+		b.maxZ = lanes[5][lane] > b.maxZ ? lanes[5][lane] : b.maxZ;
+		b.maxSize  = lanes[6][lane] > b.maxSize  ? lanes[6][lane] : b.maxSize;
+		b.maxSpeed = lanes[7][lane] > b.maxSpeed ? lanes[7][lane] : b.maxSpeed;
+	}
+	AddToBoundsScalar(p, i, p.count, b);
+}
+
+#endif // SIMD_X86_AVAILABLE
+
+
+int UpdatePeriod(const UpdateLodView& view, const ParticleSpan& p, float stepTime)
+{
+	if (p.count == 0)  return 1;
+
+	GroupBounds b = { p.posX[0], p.posY[0], p.posZ[0], p.posX[0], p.posY[0], p.posZ[0], 0, 0 };
+#if SIMD_X86_AVAILABLE
+	if (ParticleKernelLevel() != SimdLevel::Scalar)  AddToBoundsSSE2(p, b);
+	else
+#endif
+	AddToBoundsScalar(p, 0, p.count, b);
+	float radius = b.maxSize * QuadRadius;
+
+	// Out of view if the box, grown by the particle size and how far they can move before the next update, is entirely
+	// behind one frustum plane. The box corner furthest along the plane normal is the one to test
+	float outsideReach = radius + b.maxSpeed * stepTime * view.outsidePeriod;
+	for (const auto& plane : view.cull.planes)
+	{
+		float distance = plane[0] * (plane[0] > 0 ? b.maxX : b.minX) + plane[1] * (plane[1] > 0 ? b.maxY : b.minY) +
+		                 plane[2] * (plane[2] > 0 ? b.maxZ : b.minZ) + plane[3];
+		if (distance < -outsideReach)  return view.outsidePeriod;
+	}
+
+	// Far if the largest particle is still under farPixels across at the nearest the group can come before its next
+	// update. The depth is not normalised, so the reach is scaled by the length of its direction
+	const float* depth = view.cull.depth;
+	float depthScale = std::sqrt(depth[0] * depth[0] + depth[1] * depth[1] + depth[2] * depth[2]);
+	float nearest = depth[0] * (depth[0] > 0 ? b.minX : b.maxX) + depth[1] * (depth[1] > 0 ? b.minY : b.maxY) +
+	                depth[2] * (depth[2] > 0 ? b.minZ : b.maxZ) + depth[3] - b.maxSpeed * stepTime * view.farPeriod * depthScale;
+	if (nearest > 0 && 2 * radius * view.cull.pixelsPerUnit < view.farPixels * nearest)  return view.farPeriod;
+
+	return 1;
+}
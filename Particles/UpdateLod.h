@@ -0,0 +1,40 @@
+//--------------------------------------------------------------------------------------
+// Update level of detail - distant and off-screen particles updated less often
+//--------------------------------------------------------------------------------------
+// Particles are updated in small groups of neighbours in a lifetime class ring (see
+// ParticleRing.h). Each time a group is updated it is put in a tier from its bounds and the
+// camera: groups that may be seen up close are updated every step, groups whose particles
+// are all tiny on screen every farPeriod steps, and groups entirely out of view every
+// outsidePeriod steps. A group that is updated late catches up in one exact larger step
+// (IntegrateParticleSteps) and is drawn extrapolated from its last two positions in between,
+// so it is still drawn where it should be. Only used for types whose update is pure motion,
+// with no trails or bursts to emit along the way
+// Code in .cpp file
+
+#ifndef _UPDATE_LOD_H_INCLUDED_
+#define _UPDATE_LOD_H_INCLUDED_
+
+#include "ParticleCulling.h"
+
+
+// The camera view used to choose update tiers, plus the LOD settings
+struct UpdateLodView
+{
+	CullView cull; // Frustum and pixel scale, as used for culling
+
+	float farPixels     = 16.0f; // Groups whose largest particle is less than this many pixels across are far
+	int   farPeriod     = 2;     // Steps between updates of far groups
+	int   outsidePeriod = 4;     // Steps between updates of groups entirely out of view
+	int   nearRecheck   = 4;     // Steps between checks of groups updated every step, to see if they can be updated less
+};
+
+// Make a view from a camera's matrices (row vector convention, as Camera.h) and the viewport width in pixels
+UpdateLodView MakeUpdateLodView(const CMatrix4x4& viewMatrix, const CMatrix4x4& projectionMatrix, float viewportWidth);
+
+
+// Number of steps until the particles in the span should next be updated: 1, farPeriod or outsidePeriod. Allows for
+// the particles moving at their current speed until then, so a group in view by its next update is not left out
+int UpdatePeriod(const UpdateLodView& view, const ParticleSpan& particles, float stepTime);
+
+
+#endif //_UPDATE_LOD_H_INCLUDED_
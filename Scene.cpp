@@ -18,14 +18,32 @@
 #include "MathHelpers.h"     // Helper functions for maths
 #include "GraphicsHelpers.h" // Helper functions to unclutter the code here
 #include "ColourRGBA.h" 
+#include "FireworkTypes.h"
+#include "PackedFirework.h"
+#include "FireworkQuads.h"
+#include "FireworkSimulation.h"
+#include "BudgetGovernor.h"
+#include "EmissionLod.h"
+#include "ParticleCulling.h"
+#include "UpdateLod.h"
+#include "ParticleKernels.h"
+#include "WorkerPool.h"
+#include "SimulationClock.h"
+#include "FireworkLaunch.h"
+#include "LaunchLog.h"
+#include "UploadRing.h"
 
 #include "imgui.h"
 #include "imgui_impl_win32.h"
 #include "imgui_impl_dx11.h"
 
 #include <sstream>
+#include <fstream>
+#include <chrono>
 #include <memory>
 #include <array>
+#include <vector>
+#include <cstddef>
 
 
 
@@ -78,10 +96,8 @@ const float MOVEMENT_SPEED = 50;
 // ASSIGNMENT
 
 // Particle Data
-const int MaxFireworks = 50000; // Hard cap on number of firework particle allowed at once - vertex buffer is this size and 
-                                // spawning more particles will do nothing
-
-const float Gravity = -30.0f; // Tweaked to make getting nice firework settings easier
+const int MaxFireworks = 50000; // Hard cap on number of firework particle allowed at once - vertex buffer is this size.
+                                // When full, new particles replace the least visible stars if worth more, else are dropped
 
 int numFireworksAtOnce    = 2; // Just for an example ImGui control - how many fireworks to spawn with each button press
 
@@ -107,78 +123,240 @@ float fireworkInitialVelocity = 70; // Velocity of the firework - set by the fir
 // Firework types and data
 //--------------------------------------------------------------------------------------
 
-// TODO: You will be adding more firework types here as required from the assessment brief
-enum class FireworkType { PeonyRocket, FancyPeonyRocket, StarSimple, StarSmallTrail, CometRocket, BrocadeRocket};
+// Firework types and the Firework / FireworkUpdate structures are in Particles/FireworkTypes.h
+
+// IMPORTANT: Particle data is held in structure-of-arrays stores (see ParticleStore.h), one per firework type (see ParticlePool.h).
+// Each value (x position, velocity, life etc.) has its own column, so the update code only touches the data it needs, and each
+// type has its own update loop. The pool rebuilds the Firework render structure when copying to the GPU, which minimises the
+// amount of data passed to the GPU each frame.
+// The pool, the update of each firework type and the spawning of new fireworks are in Particles/FireworkSimulation.cpp, which
+// has no Windows or DirectX code so it can also be run and profiled by the headless driver (Headless/HeadlessMain.cpp)
+FireworkSimulation Simulation(MaxFireworks);
+
+WorkerPool* gWorkerPool = nullptr;
+int         numSimulationThreads = 1; // Set to the number of hardware threads in InitGeometry, can be changed with ImGui
+
+// Emission quality is lowered when the fireworks' update and upload take longer than the target each frame (see
+// BudgetGovernor.h). Trails are thinned first, then bursts - rockets are never dropped. It is turned off while recording or
+// replaying launches, since a replay is only the same as its recording at the same quality
+BudgetGovernor gBudgetGovernor(4.0f);
+bool           adaptiveQuality  = true;
+float          fireworkUpdateMs = 0; // Measured this frame, see UpdateScene
+float          fireworkUploadMs = 0; // Measured last frame, see RenderSceneFromCamera
+
+// Distance LOD - trails and bursts that are small on screen or out of view emit fewer, bigger particles (see EmissionLod.h).
+// Like adaptive quality it is off while recording or replaying since it depends on where the camera is
+bool distanceLod = true;
+
+// Update LOD - stars that are small on screen or out of view are updated every few steps and drawn extrapolated in between
+// (see UpdateLod.h). Off while recording or replaying for the same reason as distance LOD
+bool updateLod = true;
+
+// Burst instancing - bursts of simple stars are kept as one record each and their stars worked out when drawn (see
+// BurstInstances.h). Off while recording or replaying, as the stars don't come out the same as a normal burst's
+bool instanceBursts = true;
+
+// Particles outside the view or too faded to see are skipped when filling the vertex buffer (see ParticleCulling.h)
+bool       cullParticles = true;
+CullCounts fireworkCullCounts; // From the last upload
+
+// Particles are drawn as instances of a shared quad with no geometry shader, or as points the geometry shader turns into
+// quads (see FireworkQuads.h). Both draw the same thing
+bool instancedQuads = true;
+int        numFireworkVertices = 0; // Uploaded and drawn last frame
+uint64_t   fireworkUploadBytes = 0; // Bytes written to the vertex buffer last frame, as counted by the upload ring
+uint64_t   fireworkAllBytes    = 0; // Bytes it would have taken to upload every particle last frame
+
+// Fireworks are updated in fixed steps, not once per frame (see UpdateScene)
+int             simulationRate = 60; // Steps per second, can be changed with ImGui
+SimulationClock gSimulationClock(1.0f / simulationRate, 5);
+
+
+// Helper to add new fireworks but not allowing more than the given maximum. The firework is added to the pool at the end of
+// the next simulation step. Not for use during the step - emitters there reserve ranges in their chunk's spawn buffer instead
+// If the pool is full at that point the firework takes the place of the least visible star (see EvictForSpawnBuffers)
+// Each added firework is given a new random particle id, the particles it spawns get ids made from it
+bool AddFirework(const Firework& firework, const FireworkUpdate& fireworkUpdate)
+{
+	if (Simulation.Launches().Size() >= MaxFireworks)  return false;
+
+	FireworkUpdate launch = fireworkUpdate;
+	launch.id = DefaultRandomStream().NextBits();
+	Simulation.Launches().Add(firework, launch);
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Launch recording and replay
+//--------------------------------------------------------------------------------------
+// Launches from the UI can be recorded to a file and replayed on a cleared simulation. The simulation is deterministic
+// given the same launches on the same steps, so a replay gives the same show every time - use it to compare performance
 
+const char* LaunchLogFile     = "launches.fwlog";
+const char* ReplayProfileFile = "replay_profile.csv"; // Particle count and update time for each step of a replay
 
-// IMPORTANT: We have two equal-size std::vectors of particle data, containing info to render the particle (goes to GPU) and data to update
-// the particle (stays on CPU). The update code will use both structures, the GPU rendering only the render structure. This minimises the
-// amount of data passed to the GPU each frame. E.g. when updating first particle the C++ code uses both FireworkUpdates[0] and Fireworks[0]
+LaunchLog                     gLaunchLog;
+bool                          recordingLaunches = false;
+std::unique_ptr<LaunchReplay> gLaunchReplay;    // Not null while replaying
+std::string                   launchLogStatus;  // Last recording / replay message for ImGui
 
-// Data only needed to update a firework. Enough data here already for basic fireworks. You *might* want to add other data members, but it isn't initially necessary
-// Each firework is made of parts. E.g a Peony firework starts with a single PeonyRocket particle that shoots into
-//                                 the air, when its life runs out it emits a large number of PeonyStar particles in random directions
-//                                 The number and colour of PeonyStar particles is held in the payload variables
-struct FireworkUpdate
+struct ReplaySample
 {
-	FireworkType type;     // Firework type from enum above
-	CVector3     velocity; // World velocity of particle
-
-	float        life;     // Current life of particle (seconds)
-	float        timer;    // Internal timer for triggering events in flight, can be unused (see StarSmallTrail for example of use)
-
-	FireworkType payloadTypeA;   // Information about firework payload - usage depends on firework type, can be unused
-	FireworkType payloadTypeB;   //
-	int          payloadIntA;    // 
-	int          payloadIntB;    //
-	ColourRGBA   payloadColourA; //
-	ColourRGBA   payloadColourB; //
+	uint32_t step;
+	int      numParticles;
+	float    updateMs;
 };
+std::vector<ReplaySample> replayProfile;
 
 
-// Data to render a firework, updated using data above in C++, then sent over to GPU for rendering. Unlikely to need to change this
-struct Firework
+// Remove all fireworks and restart the step count, so recordings and replays start from the same state
+void ResetSimulation()
 {
-	CVector3   position; // World position of the firework
-	float      scale;    // Scale of firework for rendering
-	ColourRGBA colour;   // RGBA colour - A is transparency
-	float      rotation; // Z rotation of particle
-};
+	Simulation.Reset();
+	gSimulationClock.Reset();
+}
 
-// Equal sized vectors, see comments above
-std::vector<FireworkUpdate> FireworkUpdates;
-std::vector<Firework>       Fireworks;
 
+// Launch fireworks of the given kind using the current ImGui settings. Ignored during a replay so the workload is unchanged
+void LaunchFromUI(LaunchKind kind)
+{
+	if (gLaunchReplay)  return;
+
+	LaunchParams params;
+	params.kind            = kind;
+	params.numFireworks    = numFireworksAtOnce;
+	params.position        = fireworkPosition;
+	params.colour          = { fireworkColour[0], fireworkColour[1], fireworkColour[2], fireworkColour[3] };
+	params.scale           = fireworkScale;
+	params.rotation        = fireworkRotation;
+	params.initialVelocity = fireworkInitialVelocity;
+	params.burstParticles  = numBurstParticles;
+	params.burstLife       = burstParticleLife;
+	params.seed            = DefaultRandomStream().NextBits();
+
+	// Launches from the UI are committed at the end of the next step
+	LaunchFireworks(params, Simulation.Launches());
+	if (recordingLaunches)  gLaunchLog.Add(Simulation.StepNumber(), params);
+}
 
-// Helper to add new fireworks but not allowing more than the given maximum
-bool AddFirework(const Firework& firework, const FireworkUpdate& fireworkUpdate)
+
+void StartRecordingLaunches()
 {
-	if (Fireworks.size() >= MaxFireworks)  return false;
-	Fireworks      .push_back(firework      );
-	FireworkUpdates.push_back(fireworkUpdate);
-	return true;
+	ResetSimulation();
+	gLaunchLog.Clear(gSimulationClock.StepTime());
+	recordingLaunches = true;
+	launchLogStatus.clear();
+}
+
+void StopRecordingLaunches()
+{
+	recordingLaunches = false;
+	if (gLaunchLog.Save(LaunchLogFile))  launchLogStatus = "Saved " + std::to_string(gLaunchLog.Size()) + " launches to " + LaunchLogFile;
+	else                                 launchLogStatus = gLaunchLog.LastError();
+}
+
+
+void StartReplay()
+{
+	if (!gLaunchLog.Load(LaunchLogFile))
+	{
+		launchLogStatus = gLaunchLog.LastError();
+		return;
+	}
+
+	// Replay at the step time the log was recorded at
+	ResetSimulation();
+	gSimulationClock.SetStepTime(gLaunchLog.StepTime());
+	simulationRate = static_cast<int>(1.0f / gLaunchLog.StepTime() + 0.5f);
+	gLaunchReplay = std::make_unique<LaunchReplay>(gLaunchLog);
+	replayProfile.clear();
+	launchLogStatus.clear();
 }
 
+// Stop a replay and write its profile
+void StopReplay()
+{
+	gLaunchReplay.reset();
 
-// An array of element descriptions to create the firework vertex buffer, If you don't change the Firework struct above this can
-// be left alone. If you do change the Firework struct then this data must be updated to match. 
-// Changing the FireworkUpdate struct has no relevance to this data.
-// Contents explained using the third line as an example: that line indicates that 16 bytes into each vertex (into the Firework
-// structure) there is a "colour" value which is four floats
+	std::ofstream profile(ReplayProfileFile);
+	profile << "step,particles,update_ms\n";
+	for (const auto& sample : replayProfile)
+	{
+		profile << sample.step << ',' << sample.numParticles << ',' << sample.updateMs << '\n';
+	}
+	launchLogStatus = profile ? "Replay profile written to " + std::string(ReplayProfileFile) : "Error writing " + std::string(ReplayProfileFile);
+}
+
+
+// An array of element descriptions to create the firework vertex buffer, which holds PackedFirework structs. The elements
+// are built from the field list in Particles/PackedFireworkLayout.h, which also builds the C++ and HLSL PackedFirework
+// structs, so to change the vertex layout change that list. Each field gives an element with the field's name as its
+// semantic, its DXGI format and the offset of the field in the C++ struct
 D3D11_INPUT_ELEMENT_DESC ParticleElts[] =
 {
-	// Semantic  &  Index,   Type (eg. 2nd one is float3),     Slot,   Byte Offset,  Instancing information (not relevant here), --"--
-	{ "position",   0,       DXGI_FORMAT_R32G32B32_FLOAT,      0,      0,            D3D11_INPUT_PER_VERTEX_DATA,    0 },
-	{ "scale",      0,       DXGI_FORMAT_R32_FLOAT,            0,      12,           D3D11_INPUT_PER_VERTEX_DATA,    0 },
-	{ "colour",     0,       DXGI_FORMAT_R32G32B32A32_FLOAT,   0,      16,           D3D11_INPUT_PER_VERTEX_DATA,    0 },
-	{ "rotation",   0,       DXGI_FORMAT_R32_FLOAT,            0,      52,           D3D11_INPUT_PER_VERTEX_DATA,    0 },
+	// Semantic  &  Index,   Type,                    Slot,   Byte Offset,                   Instancing information (not relevant here), --"--
+#define PACKED_FIREWORK_FIELD(cppType, hlslType, name, format) \
+	{ #name,        0,       DXGI_FORMAT_##format,    0,      offsetof(PackedFirework, name), D3D11_INPUT_PER_VERTEX_DATA,    0 },
+	PACKED_FIREWORK_FIELDS
+#undef PACKED_FIREWORK_FIELD
 };
 const unsigned int NumParticleElts = sizeof(ParticleElts) / sizeof(D3D11_INPUT_ELEMENT_DESC);
+static_assert(NumParticleElts == NumPackedFireworkFields, "ParticleElts must have one element per packed firework field");
+
+// Element descriptions for drawing fireworks as instanced quads. The same packed fireworks in the same slot as above, but
+// read once per instance, then the corner and UV of the shared quad read per vertex from the next slot
+const unsigned int FireworkQuadSlot = 1;
+const unsigned int NumFireworkQuadElts = NumParticleElts + 2;
+std::array<D3D11_INPUT_ELEMENT_DESC, NumFireworkQuadElts> MakeFireworkQuadElts()
+{
+	std::array<D3D11_INPUT_ELEMENT_DESC, NumFireworkQuadElts> elts;
+	for (unsigned int elt = 0; elt < NumParticleElts; ++elt)
+	{
+		elts[elt] = ParticleElts[elt];
+		elts[elt].InputSlotClass       = D3D11_INPUT_PER_INSTANCE_DATA;
+		elts[elt].InstanceDataStepRate = 1;
+	}
+	elts[NumParticleElts]     = { "quadCorner", 0, DXGI_FORMAT_R32G32_FLOAT, FireworkQuadSlot, offsetof(FireworkQuadVertex, cornerX),
+	                              D3D11_INPUT_PER_VERTEX_DATA, 0 };
+	elts[NumParticleElts + 1] = { "quadUV",     0, DXGI_FORMAT_R32G32_FLOAT, FireworkQuadSlot, offsetof(FireworkQuadVertex, u),
+	                              D3D11_INPUT_PER_VERTEX_DATA, 0 };
+	return elts;
+}
 
 
 // Variables for DirectX objects that will hold the vertex layout and buffers for fireworks
 ID3D11InputLayout* FireworkLayout;
 ID3D11Buffer*      FireworkBuffer;
+ID3D11Query*       FireworkFences[NumUploadFrames] = {}; // Event queries, used as fences by the upload ring
+ID3D11InputLayout* FireworkQuadLayout;                   // For instanced quads
+ID3D11Buffer*      FireworkQuadBuffer;                   // The shared quad, see FireworkQuads.h
+
+// The firework vertex buffer holds several frames of uploads, each put after the last by an upload ring (see UploadRing.h)
+// so the buffer only needs discarding when the GPU falls behind. This connects the ring to the buffer and fences above
+class FireworkUploadBackend : public UploadBackend
+{
+public:
+	int Capacity() const override { return NumUploadFrames * MaxFireworks * sizeof(PackedFirework); }
+
+	void* Map(UploadMap mode) override
+	{
+		D3D11_MAPPED_SUBRESOURCE mappedData;
+		D3D11_MAP mapType = mode == UploadMap::Discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+		if (FAILED(gD3DContext->Map(FireworkBuffer, 0, mapType, 0, &mappedData)))  return nullptr;
+		return mappedData.pData;
+	}
+	void Unmap() override { gD3DContext->Unmap(FireworkBuffer, 0); }
+
+	int  NumFences() const override { return NumUploadFrames; }
+	void SignalFence(int fence) override { gD3DContext->End(FireworkFences[fence]); }
+	bool FenceDone(int fence) override
+	{
+		return gD3DContext->GetData(FireworkFences[fence], nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK;
+	}
+};
+FireworkUploadBackend FireworkUpload;
+UploadRing*           FireworkUploadRing = nullptr;
 
 
 //*************************************************************************
@@ -294,12 +472,26 @@ bool InitGeometry()
 	auto signature = CreateSignatureForVertexLayout(ParticleElts, NumParticleElts);
 	gD3DDevice->CreateInputLayout(ParticleElts, NumParticleElts, signature->GetBufferPointer(), signature->GetBufferSize(), &FireworkLayout);
 
+	// And the layout for drawing them as instanced quads, with the quad itself in an immutable buffer of its own
+	auto quadElts = MakeFireworkQuadElts();
+	auto quadSignature = CreateSignatureForVertexLayout(quadElts.data(), NumFireworkQuadElts);
+	gD3DDevice->CreateInputLayout(quadElts.data(), NumFireworkQuadElts, quadSignature->GetBufferPointer(), quadSignature->GetBufferSize(),
+	                              &FireworkQuadLayout);
+	D3D11_BUFFER_DESC quadDesc = { sizeof(FireworkQuadVertices), D3D11_USAGE_IMMUTABLE, D3D11_BIND_VERTEX_BUFFER, 0, 0, 0 };
+	D3D11_SUBRESOURCE_DATA quadData = { FireworkQuadVertices, 0, 0 };
+	if (FAILED(gD3DDevice->CreateBuffer(&quadDesc, &quadData, &FireworkQuadBuffer)))
+	{
+		gLastError = "Error creating particle quad vertex buffer";
+		return false;
+	}
+
 	// Create / initialise particle vertex buffer on the GPU. Initially empty
 	// We are going to update this vertex buffer every frame, so it must be defined as "dynamic" and writable (D3D11_USAGE_DYNAMIC & D3D11_CPU_ACCESS_WRITE)
+	// It holds several frames of particles, see FireworkUploadBackend above
 	D3D11_BUFFER_DESC bufferDesc;
 	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	bufferDesc.ByteWidth = MaxFireworks * sizeof(Firework); // Buffer size
+	bufferDesc.ByteWidth = FireworkUpload.Capacity(); // Buffer size
 	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 	bufferDesc.MiscFlags = 0;
 	if (FAILED(gD3DDevice->CreateBuffer(&bufferDesc, nullptr, &FireworkBuffer)))
@@ -308,10 +500,22 @@ bool InitGeometry()
 		return false;
 	}
 
-	// Reserve space in the CPU-side vectors, so vector won't need to reallocate when we push_back new fireworks.
-	// However, reserve only sets the capacity of the vector, the sizes of these vectors at first is 0
-	FireworkUpdates.reserve(MaxFireworks);
-	Fireworks.reserve(MaxFireworks);
+	// Fences for the upload ring, which tell when the GPU has finished with each frame's particles
+	D3D11_QUERY_DESC queryDesc = { D3D11_QUERY_EVENT, 0 };
+	for (auto& fence : FireworkFences)
+	{
+		if (FAILED(gD3DDevice->CreateQuery(&queryDesc, &fence)))
+		{
+			gLastError = "Error creating particle upload fences";
+			return false;
+		}
+	}
+	FireworkUploadRing = new UploadRing(FireworkUpload);
+
+	// Worker threads for the firework update, one per hardware thread to start with
+	gWorkerPool = new WorkerPool();
+	numSimulationThreads = gWorkerPool->NumThreads();
+	Simulation.SetWorkerPool(gWorkerPool);
 
 
 	//*************************************************************************
@@ -367,6 +571,10 @@ void ReleaseResources()
 
 	if (FireworkLayout)  FireworkLayout->Release();
 	if (FireworkBuffer)  FireworkBuffer->Release();
+	if (FireworkQuadLayout)  FireworkQuadLayout->Release();
+	if (FireworkQuadBuffer)  FireworkQuadBuffer->Release();
+	for (auto fence : FireworkFences)  if (fence)  fence->Release();
+	delete FireworkUploadRing;  FireworkUploadRing = nullptr;
 
 	if (gFireworkDiffuseMapSRV)        gFireworkDiffuseMapSRV      ->Release();
 	if (gFireworkDiffuseMap)           gFireworkDiffuseMap         ->Release();
@@ -387,6 +595,8 @@ void ReleaseResources()
     {
         delete gLights[i].model;  gLights[i].model = nullptr;
     }
+    delete gWorkerPool;  gWorkerPool = nullptr;
+    Simulation.SetWorkerPool(nullptr);
     delete gCamera;  gCamera = nullptr;
     delete gGround;  gGround = nullptr;
 	delete gStars;   gStars  = nullptr;
@@ -410,6 +620,10 @@ void RenderSceneFromCamera(Camera* camera)
 	gPerFrameConstants.viewMatrix           = camera->ViewMatrix();
     gPerFrameConstants.projectionMatrix     = camera->ProjectionMatrix();
     gPerFrameConstants.viewProjectionMatrix = camera->ViewProjectionMatrix();
+	gPerFrameConstants.fireworkOrigin       = camera->Position(); // Packed firework positions are most precise near here
+	FireworkQuadBasis quadBasis = MakeFireworkQuadBasis(camera->WorldMatrix()); // Worked out once here for every quad corner
+	gPerFrameConstants.fireworkRight        = quadBasis.right;
+	gPerFrameConstants.fireworkUp           = quadBasis.up;
     UpdateConstantBuffer(gPerFrameConstantBuffer, gPerFrameConstants);
 
     // Indicate that the constant buffer we just updated is for use in the vertex shader (VS), geometry shader (GS) and pixel shader (PS)
@@ -491,26 +705,46 @@ void RenderSceneFromCamera(Camera* camera)
 
 	////--------------- Pass firework data to GPU ---------------////
 
-	// Allow CPU access to GPU-side firework vertex buffer
-	D3D11_MAPPED_SUBRESOURCE mappedData;
-	gD3DContext->Map(FireworkBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData);
-
-	// Copy current firework rendering data 
+	// Allow CPU access to space for this frame in the GPU-side firework vertex buffer, after the space used by the frames
+	// before, so the GPU can go on drawing those while we write (see UploadRing.h)
+	// Then write current firework rendering data, gathered from the particle store columns and packed relative to the camera,
+	// straight into the vertex buffer with no copy in between. Finally remove CPU access again so it can be used for rendering
 	// Keep this process as fast as possible since the GPU may stall (have to wait, doing nothing) during this period
-	Firework* vertexBufferData = (Firework*)mappedData.pData;
-	memcpy(vertexBufferData, Fireworks.data(), Fireworks.size() * sizeof(Firework));
-
-	// Remove CPU access to firework vertex buffer again so it can be used for rendering
-	gD3DContext->Unmap(FireworkBuffer, 0);
+	auto uploadStart = std::chrono::steady_clock::now();
+	uint64_t ringBytesBefore = FireworkUploadRing->Stats().numBytes;
+	int maxUploadBytes = Simulation.NumParticles() * sizeof(PackedFirework);
+	auto packedVertices = static_cast<PackedFirework*>(FireworkUploadRing->Begin(maxUploadBytes, sizeof(PackedFirework)));
+	PackedVertexSpan vertexBufferData = { packedVertices, Simulation.NumParticles(), gPerFrameConstants.fireworkOrigin };
+	fireworkCullCounts = CullCounts();
+	numFireworkVertices = 0;
+	if (packedVertices != nullptr && cullParticles)
+	{
+		CullView cullView = MakeCullView(camera->ViewMatrix(), camera->ProjectionMatrix(), static_cast<float>(gViewportWidth));
+		numFireworkVertices = Simulation.Particles().GatherVisibleVertices(vertexBufferData, gSimulationClock.Interpolation(),
+		                                                                   cullView, fireworkCullCounts);
+		numFireworkVertices += Simulation.Bursts().GatherVisibleVertices(vertexBufferData.Skip(numFireworkVertices),
+		                                                                 gSimulationClock.Interpolation(), cullView, fireworkCullCounts);
+	}
+	else if (packedVertices != nullptr)
+	{
+		Simulation.Particles().GatherVertices(vertexBufferData, gSimulationClock.Interpolation());
+		Simulation.Bursts().GatherVertices(vertexBufferData.Skip(Simulation.Particles().Size()), gSimulationClock.Interpolation());
+		numFireworkVertices = Simulation.NumParticles();
+	}
+	unsigned int uploadOffset = FireworkUploadRing->End(numFireworkVertices * sizeof(PackedFirework));
+	fireworkUploadBytes = FireworkUploadRing->Stats().numBytes - ringBytesBefore;
+	fireworkAllBytes    = maxUploadBytes;
+	fireworkUploadMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
 
 
 	////--------------- Render fireworks ---------------////
 
-	// Set shaders for firework particle rendering - the vertex shader just passes the data to the 
-	// geometry shader, which generates a camera-facing 2D quad from the particle world position 
+	// Set shaders for firework particle rendering - either the vertex shader just passes the data to the 
+	// geometry shader, which generates a camera-facing 2D quad from the particle world position, or
+	// the vertex shader places each corner of an instanced quad itself (see FireworkQuads.h)
 	// The pixel shader is very simple and just draws a tinted texture for each particle
-	gD3DContext->VSSetShader(gFireworkPassThruVertexShader, nullptr, 0);
-	gD3DContext->GSSetShader(gFireworkRenderGeometryShader, nullptr, 0);
+	gD3DContext->VSSetShader(instancedQuads ? gFireworkQuadVertexShader : gFireworkPassThruVertexShader, nullptr, 0);
+	gD3DContext->GSSetShader(instancedQuads ? nullptr : gFireworkRenderGeometryShader, nullptr, 0);
 	gD3DContext->PSSetShader(gColourTexturePixelShader,     nullptr, 0);
 
 	// Select the texture and sampler to use in the pixel shader
@@ -521,15 +755,28 @@ void RenderSceneFromCamera(Camera* camera)
 	gD3DContext->OMSetDepthStencilState(gDepthReadOnlyState, 0);
 	gD3DContext->RSSetState(gCullNoneState);
 
-	// Set up firework vertex buffer / layout
-	unsigned int particleVertexSize = sizeof(Firework);
-	unsigned int offset = 0;
-	gD3DContext->IASetVertexBuffers(0, 1, &FireworkBuffer, &particleVertexSize, &offset);
-	gD3DContext->IASetInputLayout(FireworkLayout);
+	// Set up firework vertex buffers / layout - the packed fireworks, then the shared quad (only used when instancing)
+	ID3D11Buffer* particleBuffers[]     = { FireworkBuffer, FireworkQuadBuffer };
+	unsigned int  particleVertexSizes[] = { sizeof(PackedFirework), sizeof(FireworkQuadVertex) };
+	unsigned int  particleOffsets[]     = { uploadOffset, 0 };
+	gD3DContext->IASetVertexBuffers(0, 2, particleBuffers, particleVertexSizes, particleOffsets);
 
-	// Indicate that this is a point list and render all current fireworks
-	gD3DContext->IASetPrimitiveTopology(D3D10_PRIMITIVE_TOPOLOGY_POINTLIST);
-	gD3DContext->Draw((UINT)Fireworks.size(), 0);
+	// Render all uploaded fireworks, either as one quad (a strip of two triangles) per firework, or as a point list
+	if (instancedQuads)
+	{
+		gD3DContext->IASetInputLayout(FireworkQuadLayout);
+		gD3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+		gD3DContext->DrawInstanced(NumFireworkQuadVertices, (UINT)numFireworkVertices, 0, 0);
+	}
+	else
+	{
+		gD3DContext->IASetInputLayout(FireworkLayout);
+		gD3DContext->IASetPrimitiveTopology(D3D10_PRIMITIVE_TOPOLOGY_POINTLIST);
+		gD3DContext->Draw((UINT)numFireworkVertices, 0);
+	}
+
+	// Fence after the draw so the upload ring knows when the GPU has finished with this frame's part of the buffer
+	FireworkUploadRing->EndFrame();
 
 	//*************************************************************************
 }
@@ -619,105 +866,83 @@ void RenderScene(float frameTime)
 	ImGui::SliderFloat("Firework Rotation", &fireworkRotation, 0.0f, 360.0f);  // int slider range 1-5
 	ImGui::SliderFloat("Firework Initial Velocity", &fireworkInitialVelocity, 70.0f, 100.0f);  // int slider range 1-5
 
-	if (ImGui::Button("Fire Peony"))
+	ImGui::Text("Particles: %d   Update kernel: %s", Simulation.NumParticles(), SimdLevelName(ParticleKernelLevel()));
+	const SimulationStats& stepStats = Simulation.LastStepStats();
+	ImGui::Text("Step: update %.2fms  remove %.2fms (%d died, %d evicted)  commit %.2fms", stepStats.updateMs, stepStats.removeMs,
+	            stepStats.numRemoved, stepStats.numEvicted, stepStats.commitMs);
+	ImGui::Text("Chunks with expiries due: %d of %d", stepStats.numChunksExpired, stepStats.numChunks);
+
+	// Simulation rate is independent of frame rate, see UpdateScene.
+	// It is fixed while recording or replaying launches - a log is only valid at the rate it was recorded at
+	if (recordingLaunches || gLaunchReplay)
 	{
-		for (int i = 0; i < numFireworksAtOnce; ++i)
-		{
-			// Launches in a random direction within 15 degrees of up (0,1,0)
-			// This helper function (from MathHelpers.h) is useful for various aspects of fireworks - read its comment
-			CVector3 fireworkDirection = RandomVectorInCone( CVector3{0, 1, 0}, 15 ); 
-
-			Firework firework;
-			firework.position = fireworkPosition;
-			firework.scale    = fireworkScale;
-			firework.colour   = { fireworkColour[0], fireworkColour[1], fireworkColour[2], fireworkColour[3] }; // 4th value is alpha transparency - 1.0 is not transparent
-			firework.rotation = fireworkRotation;
-
-			FireworkUpdate fireworkUpdate;
-			fireworkUpdate.type = FireworkType::PeonyRocket;
-			fireworkUpdate.velocity       = fireworkDirection * fireworkInitialVelocity; // Initial velocity of rocket (speed 70 to 100)
-			fireworkUpdate.life           = burstParticleLife;                     // How long before rocket bursts
-			fireworkUpdate.payloadTypeA   = FireworkType::StarSimple; // Payload of a peony rocket
-			fireworkUpdate.payloadIntA    = numBurstParticles;                      // How many stars the emit at the burst
-			fireworkUpdate.payloadColourA = { fireworkColour[0], fireworkColour[1], fireworkColour[2], fireworkColour[3] }; // Colour of stars when it bursts
-		
-			AddFirework(firework, fireworkUpdate);
-		}
+		ImGui::Text("Simulation Rate: %d Hz", simulationRate);
 	}
+	else if (ImGui::SliderInt("Simulation Rate (Hz)", &simulationRate, 30, 240))
+	{
+		gSimulationClock.SetStepTime(1.0f / simulationRate);
+	}
+	ImGui::Text("Simulation steps: %llu   Time dropped: %.2fs", static_cast<unsigned long long>(gSimulationClock.TotalSteps()),
+	            gSimulationClock.DroppedTime());
 
-	if (ImGui::Button("Fire Comet"))
+	// Adaptive quality - the tier drops when the update and upload cost stays over the target
+	ImGui::Checkbox("Adaptive Quality", &adaptiveQuality);
+	if (adaptiveQuality)
 	{
-		for (int i = 0; i < numFireworksAtOnce; ++i)
-		{
-			// Launches in a random direction within 15 degrees of up (0,1,0)
-			// This helper function (from MathHelpers.h) is useful for various aspects of fireworks - read its comment
-			CVector3 fireworkDirection = RandomVectorInCone(CVector3{ 0, 1, 0 }, 15);
-
-			Firework firework;
-			firework.position = fireworkPosition;
-			firework.scale = fireworkScale;
-			firework.colour = { fireworkColour[0], fireworkColour[1], fireworkColour[2], fireworkColour[3] }; // 4th value is alpha transparency - 1.0 is not transparent
-			firework.rotation = fireworkRotation;
-
-			FireworkUpdate fireworkUpdate;
-			fireworkUpdate.type = FireworkType::CometRocket;
-			fireworkUpdate.velocity = fireworkDirection * fireworkInitialVelocity; // Initial velocity of rocket (speed 70 to 100)
-			fireworkUpdate.life = burstParticleLife;                     // How long before rocket bursts
-			fireworkUpdate.payloadTypeA = FireworkType::StarSimple; // trail of commet
-			fireworkUpdate.payloadIntA = numBurstParticles;                      // How many stars the emit at the burst
-			fireworkUpdate.payloadColourA = { fireworkColour[0], fireworkColour[1], fireworkColour[2], fireworkColour[3] }; // Colour of stars when it bursts
-
-			AddFirework(firework, fireworkUpdate);
-		}
+		float targetMs = gBudgetGovernor.TargetMs();
+		if (ImGui::SliderFloat("Firework Budget (ms)", &targetMs, 0.5f, 16.0f))  gBudgetGovernor.SetTargetMs(targetMs);
+	}
+	ImGui::Text("Quality: %s   Update + upload: %.2fms", gBudgetGovernor.TierName(), gBudgetGovernor.AverageCostMs());
+	ImGui::Checkbox("Distance LOD", &distanceLod);
+	ImGui::Checkbox("Update LOD", &updateLod);
+	ImGui::Text("Updates deferred: %d", stepStats.numDeferred);
+	ImGui::Checkbox("Instance Bursts", &instanceBursts);
+	ImGui::Text("Instanced bursts: %d (%d stars)", stepStats.numBursts, Simulation.Bursts().NumStars());
+
+	// Culling before upload - each culled particle saves a vertex upload and a geometry shader invocation
+	ImGui::Checkbox("Cull Particles", &cullParticles);
+	ImGui::Checkbox("Instanced Quads", &instancedQuads); // Off to expand points to quads in the geometry shader
+	ImGui::Text("Drawn: %d   Culled: %d outside view, %d faded", numFireworkVertices, fireworkCullCounts.numOutside,
+	            fireworkCullCounts.numFaded);
+	ImGui::Text("Upload: %.1fKB (%.1fKB saved)", fireworkUploadBytes / 1024.0f, (fireworkAllBytes - fireworkUploadBytes) / 1024.0f);
+	const UploadRingStats& uploadStats = FireworkUploadRing->Stats();
+	ImGui::Text("Upload ring: %llu wraps, %llu discards", static_cast<unsigned long long>(uploadStats.numWraps),
+	            static_cast<unsigned long long>(uploadStats.numDiscards));
+
+	// Recreate the worker pool if the thread count is changed - the simulation gives the same results with any number
+	if (ImGui::SliderInt("Simulation Threads", &numSimulationThreads, 1, static_cast<int>(std::thread::hardware_concurrency())))
+	{
+		delete gWorkerPool;
+		gWorkerPool = new WorkerPool(numSimulationThreads);
+		Simulation.SetWorkerPool(gWorkerPool);
 	}
 
-	if (ImGui::Button("Fire Brocade"))
+	// Launch buttons - each launch is fully described by a LaunchParams (see FireworkLaunch.h), so it can be recorded and replayed
+	for (int kind = 0; kind < NumLaunchKinds; ++kind)
 	{
-		for (int i = 0; i < numFireworksAtOnce; ++i)
-		{
-			CVector3 fireworkDirection = RandomVectorInCone(CVector3{ 0, 1, 0 }, 180);
-
-			Firework firework;
-			firework.position = fireworkPosition;
-			firework.scale = fireworkScale;
-			firework.colour = { fireworkColour[0], fireworkColour[1], fireworkColour[2], fireworkColour[3] }; // 4th value is alpha transparency - 1.0 is not transparent
-			firework.rotation = fireworkRotation;
-
-			FireworkUpdate fireworkUpdate;
-			fireworkUpdate.type = FireworkType::BrocadeRocket;
-			fireworkUpdate.velocity = fireworkDirection * fireworkInitialVelocity;
-			fireworkUpdate.life = burstParticleLife;                     // How long before rocket bursts
-			fireworkUpdate.payloadTypeA = FireworkType::StarSimple; // Payload: stars
-			fireworkUpdate.payloadIntA = numBurstParticles;                      // How many stars the emit at the burst
-			fireworkUpdate.payloadColourA = { fireworkColour[0], fireworkColour[1], fireworkColour[2], fireworkColour[3] }; // Colour of stars when it bursts
-
-			AddFirework(firework, fireworkUpdate);
-		}
+		std::string label = std::string("Fire ") + LaunchKindName(static_cast<LaunchKind>(kind));
+		if (ImGui::Button(label.c_str()))  LaunchFromUI(static_cast<LaunchKind>(kind));
 	}
-	
-	if (ImGui::Button("Fire Peony with Small Trails"))
+
+	// Recording and replay of launches for repeatable performance runs (see LaunchLog.h)
+	ImGui::Separator();
+	if (recordingLaunches)
 	{
-		for (int i = 0; i < numFireworksAtOnce; ++i)
-		{
-			CVector3 fireworkDirection = RandomVectorInCone(CVector3{ 0, 1, 0 }, 15);
-
-			Firework firework;
-			firework.position = fireworkPosition;
-			firework.scale = fireworkScale;
-			firework.colour = { fireworkColour[0], fireworkColour[1], fireworkColour[2], fireworkColour[3] }; // 4th value is alpha transparency - 1.0 is not transparent
-			firework.rotation = fireworkRotation;
-
-			FireworkUpdate fireworkUpdate;
-			fireworkUpdate.type = FireworkType::PeonyRocket;
-			fireworkUpdate.velocity       = fireworkDirection * fireworkInitialVelocity; // Initial velocity of rocket (speed 70 to 100)
-			fireworkUpdate.life = burstParticleLife;                     // How long before rocket bursts
-			fireworkUpdate.payloadTypeA   = FireworkType::StarSmallTrail; // Payload of a peony rocket
-			fireworkUpdate.payloadIntA = numBurstParticles;                      // How many stars the emit at the burst
-			fireworkUpdate.payloadColourA = { fireworkColour[0], fireworkColour[1], fireworkColour[2], fireworkColour[3] }; // Colour of stars when it bursts
-
-			AddFirework(firework, fireworkUpdate);
-		}
+		ImGui::Text("Recording: %d launches", gLaunchLog.Size());
+		if (ImGui::Button("Stop Recording"))  StopRecordingLaunches();
 	}
+	else if (gLaunchReplay)
+	{
+		ImGui::Text("Replaying: step %u", Simulation.StepNumber());
+		if (ImGui::Button("Stop Replay"))  StopReplay();
+	}
+	else
+	{
+		if (ImGui::Button("Record Launches"))  StartRecordingLaunches();
+		ImGui::SameLine();
+		if (ImGui::Button("Replay Launches"))  StartReplay();
+	}
+	if (!launchLogStatus.empty())  ImGui::Text("%s", launchLogStatus.c_str());
 
 	ImGui::End();
 
@@ -762,192 +987,8 @@ void RenderScene(float frameTime)
 
 // Code to update fireworks each frame
 
-// Helper function for UpdateFireworks - you may need to use this function yourself if you write more advanced code,
-// but to start with skip over this and look at the next function UpdateFireworks
-// 
-// Removes the firework if its life is <= 0 and updates the given iterators to point at the next firework
-// DOES NOT DECREASE LIFE, you need to do that in the update code
-// 
-// Detail: As we walk through the vector of fireworks to update them, some will die. Removing things in a container when
-// you are in the middle of iterating through it always needs to be done carefully. Process:
-// - If life reaches 0, we remove the current firework by overwriting it with the last firework in the vector.
-// - Then remove that last firework from the end of the vector
-// - That means we don't need to step forward in the vector, because the current firework becomes a new one to update
-// - However, if the firework is still alive, just step forward normally
-void RemoveFireworkIfDeadAndMoveToNext(std::vector<Firework>::iterator& fireworkIt, std::vector<FireworkUpdate>::iterator& fireworkUpdateIt)
-{
-	if (fireworkUpdateIt->life <= 0)
-	{
-		if (fireworkIt + 1 == Fireworks.end())
-		{
-			Fireworks      .pop_back();
-			FireworkUpdates.pop_back();
-			fireworkIt       = Fireworks.end();
-			fireworkUpdateIt = FireworkUpdates.end();
-			return;
-		}
-		else
-		{
-			*fireworkIt       = Fireworks.back(); // Dead firework, copy last one over it
-			*fireworkUpdateIt = FireworkUpdates.back();
-		}
-		Fireworks      .pop_back(); // Remove last firework after copying
-		FireworkUpdates.pop_back();
-	}
-	else
-	{
-		// Firework wasn't removed so step to next firework
-		++fireworkIt;
-		++fireworkUpdateIt;
-	}
-}
-
-
-// Update all the fireworks in the two vectors Fireworks and FireworkUpdates. Much of the assignment work will be in this function.
-void UpdateFireworks(float frameTime)
-{
-	// Two matching vectors of data for fireworks (see comment on declaration near top for reason)
-	// We will step through both vectors at the same time
-	auto fireworkIt       = Fireworks      .begin(); // Using iterators rather than indexes for this code
-	auto fireworkUpdateIt = FireworkUpdates.begin();
-	while (fireworkIt != Fireworks.end())
-	{
-		// Handle firework movement
-		fireworkIt->position += fireworkUpdateIt->velocity * frameTime;
-		fireworkUpdateIt->velocity.y += Gravity * frameTime;
-
-		// Decrease life, but don't remove firework if dead yet - function at end of loop does that
-		fireworkUpdateIt->life -= frameTime;
-
-		//-------------------------------
-		// SIMPLE STAR - UPDATE IN FLIGHT
-		//-------------------------------
-		// Simple stars just shrink, fade out and slightly slow down (whilst falling)
-		if (fireworkUpdateIt->type == FireworkType::StarSimple)
-		{
-			fireworkIt->colour.a -= 0.5f * frameTime; // Decrease alpha of stars, they fade out as they fly
-			fireworkIt->scale    -= 1.0f * frameTime; // Decrease scale of stars, they get smaller as they fly 
-			
-			fireworkUpdateIt->velocity *= powf(0.5f, frameTime); // Stars slow down a little, correct way to do frameTime when using *= instead of +=
-		}
-
-		//------------------------------------
-		// SMALL TRAIL STAR - UPDATE IN FLIGHT
-		//------------------------------------
-		// Trail stars work like simple stars but emit lots of little, short-lived simple stars behind them, leaving a trail
-		if (fireworkUpdateIt->type == FireworkType::StarSmallTrail)
-		{
-			// First do same update as simple star
-			fireworkIt->colour.a -= 0.5f * frameTime; // Decrease alpha of stars, they fade out as they fly
-			fireworkIt->scale    -= 1.0f * frameTime; // Decrease scale of stars, they get smaller as they fly 
-
-			fireworkUpdateIt->velocity *= powf(0.5f, frameTime);
-
-			// Stars with trails launch simple stars frequently as they move, use the firework's timer member for this kind of thing
-			fireworkUpdateIt->timer -= frameTime;
-			while (fireworkUpdateIt->timer <= 0) // Use a while loop in case frame time is slow and we need to emit multiple particles at once
-			{
-				Firework firework;
-				firework.position = fireworkIt->position; // Further fireworks emit from the trail star's position
-				firework.scale = 0.75f;                   // Quite small
-				firework.colour = fireworkIt->colour;     // Same colour as trail star
-				firework.rotation = 0;
-
-				FireworkUpdate fireworkUpdate;
-				fireworkUpdate.type     = FireworkType::StarSimple;
-				fireworkUpdate.velocity = fireworkUpdateIt->velocity * 0.5f + // Add *half* the trail-star's velocity and they will lag behind leaving a trail
-				                          CVector3{ Random(-5.0f, 5.0f), Random(-5.0f, 5.0f), Random(-5.0f, 5.0f) };
-				fireworkUpdate.life = 0.4f; // Very short-lived
-				AddFirework(firework, fireworkUpdate);
-
-				fireworkUpdateIt->timer += 0.05f;
-				// For longer trails have them lag more behind, live longer and emit more frequently
-			}
-		}
-
-		if (fireworkUpdateIt->type == FireworkType::CometRocket)
-		{
-			Firework firework;
-			firework.position = fireworkIt->position; // Further fireworks emit from the trail star's position
-			firework.scale = 0.75f;                   // Quite small
-			firework.colour = fireworkIt->colour;     // Same colour as trail star
-			firework.rotation = 0;
-
-			FireworkUpdate fireworkUpdate;
-			fireworkUpdate.type = FireworkType::StarSimple;
-			fireworkUpdate.velocity = fireworkUpdateIt->velocity * 0.5f + // Add *half* the trail-star's velocity and they will lag behind leaving a trail
-				CVector3{ Random(-5.0f, 5.0f), Random(-5.0f, 5.0f), Random(-5.0f, 5.0f) };
-			fireworkUpdate.life = 0.4f; // Very short-lived
-			fireworkUpdate.timer = 0.05f;
-			AddFirework(firework, fireworkUpdate);
-		}
-
-		//------------------------------------
-		// ADD YOUR FIREWORKS IN-FLIGHT UPDATE
-		//------------------------------------
-
-	
-		//-------------------------------
-
-		// Handle fireworks burst when dead
-		if (fireworkUpdateIt->life <= 0)
-		{
-			//-------------------------------
-			// PEONY ROCKET BURST
-			//-------------------------------
-			if (fireworkUpdateIt->type == FireworkType::PeonyRocket)
-			{
-				// For PeonyRockets: payloadTypeA is the type of star to launch on burst - random in all directions.
-				//                   payloadIntA is the number of stars to launch when it bursts, and payloadColourA is the colour of those stars
-				for (int i = 0; i < fireworkUpdateIt->payloadIntA; ++i)
-				{
-					Firework firework;
-					firework.position = fireworkIt->position; // Stars emit from where the rocket is when it burst (life reached 0)
-					firework.scale = 1.5f;
-					firework.colour = fireworkUpdateIt->payloadColourA; // Rocket contains star colour in its payload
-					firework.rotation = 0;
-
-					FireworkUpdate fireworkUpdate;
-					fireworkUpdate.type     = fireworkUpdateIt->payloadTypeA;
-					fireworkUpdate.velocity = fireworkUpdateIt->velocity + // Add the rocket's velocity at burst to the initial star velocity for more realism
-						                      CVector3{ Random(-50.0f, 50.0f), Random(-50.0f, 50.0f), Random(-50.0f, 50.0f) };
-					fireworkUpdate.life     = 1.4f; // How long stars last
-					fireworkUpdate.timer    = 0;
-					AddFirework(firework, fireworkUpdate);
-				}
-			}
-
-			//-------------------------------
-			// ADD YOUR FIREWORK BURSTS
-			//-------------------------------
-			// E.g. burst that launches two payloads, or burst that launches only in certain directions
-
-			if (fireworkUpdateIt->type == FireworkType::BrocadeRocket)
-			{
-				for (int i = 0; i < fireworkUpdateIt->payloadIntA; ++i)
-				{
-					Firework firework;
-					firework.position = fireworkIt->position;
-					firework.scale = 1.5f;
-					firework.colour = fireworkUpdateIt->payloadColourA;
-					firework.rotation = 0;
-
-					FireworkUpdate fireworkUpdate;
-					fireworkUpdate.type = FireworkType::StarSmallTrail; // <<< MAKE THEM TRAIL STARS
-					fireworkUpdate.velocity = fireworkUpdateIt->velocity +
-						CVector3{ Random(-60.0f, 60.0f), Random(-60.0f, 60.0f), Random(-60.0f, 60.0f) };
-					fireworkUpdate.life = 7.0f; // Live longer so they fall
-					fireworkUpdate.timer = 0.05f; // <<< Start emitting small glitter right away!
-					AddFirework(firework, fireworkUpdate);
-				}
-			}
-
-		}
-
-		// Removes firework if it is dead and moves to next firework - made a helper function in case you need it for your code
-		RemoveFireworkIfDeadAndMoveToNext(fireworkIt, fireworkUpdateIt);
-	}
-}
+// The update for each type of firework is in Particles/FireworkSimulation.cpp - add new types there (see
+// FireworkSimulation::UpdateChunk). UpdateScene below runs one simulation step at a time
 
 //*************************************************************************
 
@@ -965,8 +1006,55 @@ void UpdateScene(float frameTime)
 	// Control camera (will update its view matrix)
 	gCamera->Control(frameTime, Key_Up, Key_Down, Key_Left, Key_Right, Key_W, Key_S, Key_A, Key_D );
 
-	// Assignment function
-	UpdateFireworks(frameTime);
+	// Assignment function - run at a fixed rate whatever the frame rate, so the fireworks behave and cost the same with or
+	// without vsync. Zero, one or several steps may be run in a frame, rendering interpolates between the last two
+	// The quality the governor chose from the previous frames' cost applies to all of this frame's steps
+	gBudgetGovernor.SetEnabled(adaptiveQuality && !recordingLaunches && !gLaunchReplay);
+	Simulation.SetEmissionQuality(gBudgetGovernor.Quality());
+	if (distanceLod && !recordingLaunches && !gLaunchReplay)
+	{
+		Simulation.SetEmissionView(MakeEmissionView(gCamera->ViewMatrix(), gCamera->ProjectionMatrix(), static_cast<float>(gViewportWidth)));
+	}
+	else
+	{
+		Simulation.ClearEmissionView();
+	}
+	if (updateLod && !recordingLaunches && !gLaunchReplay)
+	{
+		Simulation.SetUpdateLodView(MakeUpdateLodView(gCamera->ViewMatrix(), gCamera->ProjectionMatrix(), static_cast<float>(gViewportWidth)));
+	}
+	else
+	{
+		Simulation.ClearUpdateLodView();
+	}
+	Simulation.SetBurstInstancing(instanceBursts && !recordingLaunches && !gLaunchReplay);
+
+	fireworkUpdateMs = 0;
+	int numSteps = gSimulationClock.Advance(frameTime);
+	for (int step = 0; step < numSteps; ++step)
+	{
+		if (gLaunchReplay)
+		{
+			// Feed in the launches recorded for this step, and time the update for the replay profile
+			uint32_t stepNumber = Simulation.StepNumber();
+			gLaunchReplay->Play(stepNumber, Simulation.Launches());
+			Simulation.Step(gSimulationClock.StepTime());
+			fireworkUpdateMs += Simulation.LastStepStats().TotalMs();
+			replayProfile.push_back({ stepNumber, Simulation.NumParticles(), Simulation.LastStepStats().TotalMs() });
+
+			// Replay is over when all launches have been played and the last firework has died
+			if (gLaunchReplay->Finished() && Simulation.NumParticles() == 0)
+			{
+				StopReplay();
+			}
+		}
+		else
+		{
+			Simulation.Step(gSimulationClock.StepTime());
+			fireworkUpdateMs += Simulation.LastStepStats().TotalMs();
+		}
+	}
+	gBudgetGovernor.AddFrame(fireworkUpdateMs + fireworkUploadMs);
 
 	// Toggle FPS limiting
 	if (KeyHit(Key_P))  lockFPS = !lockFPS;
@@ -24,6 +24,7 @@ ID3D11PixelShader*  gPixelLightingPixelShader       = nullptr;
 
 ID3D11VertexShader*   gFireworkPassThruVertexShader = nullptr; // Vertex shader just passes data on when rendering and updating particles
 ID3D11GeometryShader* gFireworkRenderGeometryShader = nullptr; // Geometry shader used for rendering particles
+ID3D11VertexShader*   gFireworkQuadVertexShader     = nullptr; // Vertex shader for rendering particles as instanced quads, with no geometry shader
 
 
 //--------------------------------------------------------------------------------------
@@ -44,11 +45,12 @@ bool LoadShaders()
 
 	gFireworkPassThruVertexShader = LoadVertexShader  ("FireworkPassThru_vs");
 	gFireworkRenderGeometryShader = LoadGeometryShader("FireworkRender_gs"  );
+	gFireworkQuadVertexShader     = LoadVertexShader  ("FireworkQuad_vs"    );
 	
 	if (gPixelLightingVertexShader    == nullptr || gPixelLightingPixelShader       == nullptr ||
 		gBasicTransformVertexShader   == nullptr || gSingleColourTexturePixelShader == nullptr || 
 		gColourTexturePixelShader     == nullptr || gFireworkPassThruVertexShader   == nullptr ||
-		gFireworkRenderGeometryShader == nullptr)
+		gFireworkRenderGeometryShader == nullptr || gFireworkQuadVertexShader       == nullptr)
 	{
 		gLastError = "Error loading shaders";
 		return false;
@@ -60,6 +62,7 @@ bool LoadShaders()
 
 void ReleaseShaders()
 {
+	if (gFireworkQuadVertexShader)        gFireworkQuadVertexShader      ->Release();
 	if (gFireworkRenderGeometryShader)    gFireworkRenderGeometryShader  ->Release();
 	if (gFireworkPassThruVertexShader)    gFireworkPassThruVertexShader  ->Release();
 	if (gPixelLightingPixelShader)        gPixelLightingPixelShader      ->Release();
@@ -235,6 +238,7 @@ ID3DBlob* CreateSignatureForVertexLayout(const D3D11_INPUT_ELEMENT_DESC vertexLa
 		else if (format == DXGI_FORMAT_R32G32B32_SINT)     shaderSource += "int3";
 		else if (format == DXGI_FORMAT_R32G32_SINT)        shaderSource += "int2";
 		else if (format == DXGI_FORMAT_R32_SINT)           shaderSource += "int";
+		else if (format == DXGI_FORMAT_R8G8B8A8_UNORM)     shaderSource += "float4";
 		else return nullptr; // Unsupported type in layout
 
 		uint8_t index = static_cast<uint8_t>(vertexLayout[elt].SemanticIndex);
@@ -24,6 +24,7 @@ extern ID3D11PixelShader*    gPixelLightingPixelShader;
 
 extern ID3D11VertexShader*   gFireworkPassThruVertexShader; // Vertex shader just passes data on when rendering and updating particles
 extern ID3D11GeometryShader* gFireworkRenderGeometryShader; // Geometry shader used for rendering particles
+extern ID3D11VertexShader*   gFireworkQuadVertexShader;     // Vertex shader for rendering particles as instanced quads, with no geometry shader
 
 
 //--------------------------------------------------------------------------------------
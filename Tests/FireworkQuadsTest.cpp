@@ -0,0 +1,134 @@
+//--------------------------------------------------------------------------------------
+// Tests of the instanced quad expansion
+//--------------------------------------------------------------------------------------
+// Particles are expanded to their quad corners for known camera matrices, and the corners
+// are compared with values worked out by hand and with the geometry shader's calculation,
+// which puts camera space corner (x, y, 0) times the scale along the first two rows of the
+// camera matrix
+
+#include "FireworkQuads.h"
+#include "TestCheck.h"
+
+
+const float Pi = 3.14159265f;
+
+void CheckVector(const CVector3& v, const CVector3& expected)
+{
+	CHECK_NEAR(v.x, expected.x, 1e-4);
+	CHECK_NEAR(v.y, expected.y, 1e-4);
+	CHECK_NEAR(v.z, expected.z, 1e-4);
+}
+
+Firework MakeFirework(const CVector3& position, float scale, float rotation)
+{
+	Firework firework;
+	firework.position = position;
+	firework.scale    = scale;
+	firework.colour   = { 1, 1, 1, 1 };
+	firework.rotation = rotation;
+	return firework;
+}
+
+// The corner as FireworkRender_gs.hlsl works it out: position + (float3x3)camera * (corner * scale), reading the
+// matrix elements directly rather than through the basis
+CVector3 GeometryShaderCorner(const Firework& firework, const CMatrix4x4& camera, float cornerX, float cornerY)
+{
+	float x = cornerX * firework.scale, y = cornerY * firework.scale;
+	return { firework.position.x + x * camera.e00 + y * camera.e10,
+	         firework.position.y + x * camera.e01 + y * camera.e11,
+	         firework.position.z + x * camera.e02 + y * camera.e12 };
+}
+
+
+// With the camera at the origin looking down z the quad lies in the xy plane
+void TestIdentityCamera()
+{
+	FireworkQuadBasis basis = MakeFireworkQuadBasis(MatrixIdentity());
+	CheckVector(basis.right, { 1, 0, 0 });
+	CheckVector(basis.up,    { 0, 1, 0 });
+
+	CVector3 corners[NumFireworkQuadVertices];
+	ExpandFireworkQuad(MakeFirework({ 10, 20, 30 }, 2.0f, 0), basis, corners);
+	CheckVector(corners[0], {  8, 22, 30 }); // Top left
+	CheckVector(corners[1], { 12, 22, 30 }); // Top right
+	CheckVector(corners[2], {  8, 18, 30 }); // Bottom left
+	CheckVector(corners[3], { 12, 18, 30 }); // Bottom right
+}
+
+
+// Turning the camera turns the quad to face it, and moving the camera doesn't change the quad
+void TestRotatedCameras()
+{
+	// A quarter turn about y: right is -z and up is still y
+	CMatrix4x4 turned = MatrixRotationY(Pi / 2) * MatrixTranslation({ 100, 5, -40 });
+	FireworkQuadBasis basis = MakeFireworkQuadBasis(turned);
+	CheckVector(basis.right, { 0, 0, -1 });
+	CheckVector(basis.up,    { 0, 1,  0 });
+
+	CVector3 corners[NumFireworkQuadVertices];
+	ExpandFireworkQuad(MakeFirework({ 1, 2, 3 }, 0.5f, 0), basis, corners);
+	CheckVector(corners[0], { 1, 2.5f, 3.5f });
+	CheckVector(corners[1], { 1, 2.5f, 2.5f });
+	CheckVector(corners[2], { 1, 1.5f, 3.5f });
+	CheckVector(corners[3], { 1, 1.5f, 2.5f });
+
+	// A quarter turn about x, looking straight down: up is z
+	basis = MakeFireworkQuadBasis(MatrixRotationX(Pi / 2));
+	CheckVector(basis.right, { 1, 0, 0 });
+	CheckVector(basis.up,    { 0, 0, 1 });
+	ExpandFireworkQuad(MakeFirework({ 0, 50, 0 }, 3.0f, 0), basis, corners);
+	CheckVector(corners[0], { -3, 50,  3 });
+	CheckVector(corners[3], {  3, 50, -3 });
+
+	// Any camera: the same corners as the geometry shader, in a square facing the camera of side 2 x scale
+	CMatrix4x4 camera = MatrixRotationZ(0.3f) * MatrixRotationX(-0.4f) * MatrixRotationY(2.1f) * MatrixTranslation({ 7, 8, 9 });
+	basis = MakeFireworkQuadBasis(camera);
+	Firework firework = MakeFirework({ -20, 35, 60 }, 1.25f, 0);
+	ExpandFireworkQuad(firework, basis, corners);
+	for (int i = 0; i < NumFireworkQuadVertices; ++i)
+	{
+		const FireworkQuadVertex& vertex = FireworkQuadVertices[i];
+		CheckVector(corners[i], GeometryShaderCorner(firework, camera, vertex.cornerX, vertex.cornerY));
+		CHECK_NEAR(Dot(corners[i] - firework.position, camera.GetZAxis()), 0, 1e-4);
+	}
+	CHECK_NEAR(Length(corners[1] - corners[0]), 2 * firework.scale, 1e-4);
+	CHECK_NEAR(Length(corners[2] - corners[0]), 2 * firework.scale, 1e-4);
+	CHECK_NEAR(Dot(corners[1] - corners[0], corners[2] - corners[0]), 0, 1e-4);
+}
+
+
+// The geometry shader doesn't use the particle's rotation, so neither does the instanced quad
+void TestParticleRotationIgnored()
+{
+	FireworkQuadBasis basis = MakeFireworkQuadBasis(MatrixRotationY(0.7f) * MatrixRotationX(0.2f));
+	CVector3 corners[NumFireworkQuadVertices], rotatedCorners[NumFireworkQuadVertices];
+	ExpandFireworkQuad(MakeFirework({ 3, 4, 5 }, 1.5f, 0),   basis, corners);
+	ExpandFireworkQuad(MakeFirework({ 3, 4, 5 }, 1.5f, 135), basis, rotatedCorners);
+	for (int i = 0; i < NumFireworkQuadVertices; ++i)
+	{
+		CHECK(corners[i].x == rotatedCorners[i].x && corners[i].y == rotatedCorners[i].y && corners[i].z == rotatedCorners[i].z);
+	}
+}
+
+
+// The shared quad is the geometry shader's strip, with the same texture coordinates
+void TestQuadVertices()
+{
+	const float expected[NumFireworkQuadVertices][4] = { { -1, 1, 0, 0 }, { 1, 1, 1, 0 }, { -1, -1, 0, 1 }, { 1, -1, 1, 1 } };
+	for (int i = 0; i < NumFireworkQuadVertices; ++i)
+	{
+		const FireworkQuadVertex& vertex = FireworkQuadVertices[i];
+		CHECK(vertex.cornerX == expected[i][0] && vertex.cornerY == expected[i][1]);
+		CHECK(vertex.u == expected[i][2] && vertex.v == expected[i][3]);
+	}
+}
+
+
+int main()
+{
+	TestIdentityCamera();
+	TestRotatedCameras();
+	TestParticleRotationIgnored();
+	TestQuadVertices();
+	return TestResult("FireworkQuadsTest");
+}
@@ -0,0 +1,115 @@
+//--------------------------------------------------------------------------------------
+// Tests of saving and loading launch logs
+//--------------------------------------------------------------------------------------
+// A log saved and loaded again must give the same launches, and a damaged file must fail to
+// load with a message rather than crash or allocate whatever its header asks for
+
+#include "LaunchLog.h"
+#include "TestCheck.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+
+const char* const LogFile     = "LaunchLogTest.fwlog";
+const char* const DamagedFile = "LaunchLogTestDamaged.fwlog";
+
+LaunchLog MakeLog()
+{
+	LaunchLog log(1.0f / 60);
+	for (int i = 0; i < 5; ++i)
+	{
+		LaunchParams params;
+		params.kind            = static_cast<LaunchKind>(i % NumLaunchKinds);
+		params.numFireworks    = 2 + i;
+		params.position        = { i * 1.0f, 0.0f, -i * 2.0f };
+		params.colour          = { 1.0f, 0.5f, 0.25f, 1.0f };
+		params.scale           = 1.0f;
+		params.rotation        = 0.0f;
+		params.initialVelocity = 80.0f + i;
+		params.burstParticles  = 100 + i;
+		params.burstLife       = 2.0f;
+		params.seed            = 7 + i;
+		log.Add(i * 10, params);
+	}
+	return log;
+}
+
+std::vector<char> ReadFile(const char* fileName)
+{
+	std::ifstream file(fileName, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const char* fileName, const std::vector<char>& bytes)
+{
+	std::ofstream file(fileName, std::ios::binary);
+	file.write(bytes.data(), bytes.size());
+}
+
+
+void TestRoundTrip()
+{
+	LaunchLog log = MakeLog();
+	CHECK(log.Save(LogFile));
+
+	LaunchLog loaded;
+	CHECK(loaded.Load(LogFile));
+	CHECK(loaded.Size() == log.Size());
+	for (int i = 0; i < loaded.Size() && i < log.Size(); ++i)
+	{
+		const LaunchEvent& a = log.Events()[i];
+		const LaunchEvent& b = loaded.Events()[i];
+		CHECK(a.step == b.step && a.params.kind == b.params.kind && a.params.numFireworks == b.params.numFireworks);
+		CHECK(a.params.burstParticles == b.params.burstParticles && a.params.seed == b.params.seed);
+		CHECK(a.params.position.z == b.params.position.z && a.params.initialVelocity == b.params.initialVelocity);
+	}
+}
+
+
+void TestDamaged()
+{
+	std::vector<char> good = ReadFile(LogFile);
+	CHECK(good.size() == 16 + 5 * 56);
+
+	// An event count far beyond the file, which must not be allocated for
+	std::vector<char> bytes = good;
+	bytes[12] = bytes[13] = bytes[14] = bytes[15] = static_cast<char>(0xff);
+	WriteFile(DamagedFile, bytes);
+	LaunchLog log;
+	CHECK(!log.Load(DamagedFile));
+	CHECK(log.LastError().find("truncated") != std::string::npos);
+	CHECK(log.Size() == 0);
+
+	// Part of the last event missing
+	bytes = good;
+	bytes.resize(bytes.size() - 3);
+	WriteFile(DamagedFile, bytes);
+	CHECK(!log.Load(DamagedFile));
+	CHECK(log.LastError().find("truncated") != std::string::npos);
+
+	// More bytes than the events
+	bytes = good;
+	bytes.push_back(0);
+	WriteFile(DamagedFile, bytes);
+	CHECK(!log.Load(DamagedFile));
+	CHECK(!log.LastError().empty());
+
+	// Not a log at all
+	WriteFile(DamagedFile, std::vector<char>(4, 'x'));
+	CHECK(!log.Load(DamagedFile));
+
+	std::remove(LogFile);
+	std::remove(DamagedFile);
+}
+
+
+int main()
+{
+	TestRoundTrip();
+	TestDamaged();
+	return TestResult("LaunchLogTest");
+}
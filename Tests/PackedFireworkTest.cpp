@@ -0,0 +1,132 @@
+//--------------------------------------------------------------------------------------
+// Tests of the packed firework vertex
+//--------------------------------------------------------------------------------------
+// Vertices are packed and unpacked again as the vertex shader does, and must come back
+// within the precision of each field. The gathers must write the same vertices as packing
+// the ordinary Firework vertices, 12 bytes each, and nothing past the ones they write
+
+#include "PackedFirework.h"
+#include "TestCheck.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+
+static_assert(sizeof(PackedFirework) == 12, "The packed vertex should be 12 bytes");
+
+Firework MakeFirework(const CVector3& position, float scale, const ColourRGBA& colour, float rotation)
+{
+	Firework firework;
+	firework.position = position;
+	firework.scale    = scale;
+	firework.colour   = colour;
+	firework.rotation = rotation;
+	return firework;
+}
+
+Firework PackAndUnpack(const Firework& vertex, const CVector3& origin)
+{
+	return UnpackFirework(PackFirework(vertex, origin), origin);
+}
+
+
+// Positions are half floats relative to the origin, so keep about three significant figures of the distance from it
+void TestPosition()
+{
+	const CVector3 origin = { 100.0f, 20.0f, -300.0f };
+	const CVector3 offsets[] = { { 0, 0, 0 }, { 0.5f, -0.25f, 1.0f }, { 10.3f, 5.7f, -2.2f }, { -250.0f, 130.0f, 999.0f } };
+	for (const CVector3& offset : offsets)
+	{
+		Firework unpacked = PackAndUnpack(MakeFirework(origin + offset, 1.0f, { 1, 1, 1, 1 }, 0), origin);
+		double tolerance = Length(offset) / 1024.0 + 1e-6;
+		CHECK_NEAR(unpacked.position.x, origin.x + offset.x, tolerance);
+		CHECK_NEAR(unpacked.position.y, origin.y + offset.y, tolerance);
+		CHECK_NEAR(unpacked.position.z, origin.z + offset.z, tolerance);
+	}
+
+	// Too far for a half is clamped, not wrapped or infinite
+	Firework far = PackAndUnpack(MakeFirework({ 1.0e6f, 0, 0 }, 1.0f, { 1, 1, 1, 1 }, 0), { 0, 0, 0 });
+	CHECK(far.position.x == 65504.0f);
+}
+
+
+// Scale is 8 bits of its square root, so small scales get the fine steps, and is clamped to the largest packed scale
+void TestScale()
+{
+	const float scales[] = { 0.05f, 0.2f, 0.5f, 1.0f, 3.0f, MaxPackedScale };
+	for (float scale : scales)
+	{
+		Firework unpacked = PackAndUnpack(MakeFirework({ 0, 0, 0 }, scale, { 1, 1, 1, 1 }, 0), { 0, 0, 0 });
+		double step = 2.0 * std::sqrt(scale * MaxPackedScale) / 255.0; // Derivative of the square, times one step
+		CHECK_NEAR(unpacked.scale, scale, step);
+	}
+	CHECK(PackAndUnpack(MakeFirework({ 0, 0, 0 }, 0.0f, { 1, 1, 1, 1 }, 0), { 0, 0, 0 }).scale == 0.0f);
+	CHECK_NEAR(PackAndUnpack(MakeFirework({ 0, 0, 0 }, -2.0f, { 1, 1, 1, 1 }, 0), { 0, 0, 0 }).scale, 2.0f, 0.03);
+	CHECK(PackAndUnpack(MakeFirework({ 0, 0, 0 }, 50.0f, { 1, 1, 1, 1 }, 0), { 0, 0, 0 }).scale == MaxPackedScale);
+}
+
+
+// Colours are 8 bits each, clamped to [0, 1]. Rotation is 8 bits over a full turn, wrapping round
+void TestColourAndRotation()
+{
+	Firework unpacked = PackAndUnpack(MakeFirework({ 0, 0, 0 }, 1.0f, { 0.1f, 0.5f, 0.9f, 0.33f }, 90.0f), { 0, 0, 0 });
+	CHECK_NEAR(unpacked.colour.r, 0.1f,  0.51 / 255);
+	CHECK_NEAR(unpacked.colour.g, 0.5f,  0.51 / 255);
+	CHECK_NEAR(unpacked.colour.b, 0.9f,  0.51 / 255);
+	CHECK_NEAR(unpacked.colour.a, 0.33f, 0.51 / 255);
+	CHECK_NEAR(unpacked.rotation, 90.0f, 0.5 * 360 / 256);
+
+	unpacked = PackAndUnpack(MakeFirework({ 0, 0, 0 }, 1.0f, { -1.0f, 2.0f, 1.0f, 0.0f }, -45.0f), { 0, 0, 0 });
+	CHECK(unpacked.colour.r == 0.0f && unpacked.colour.g == 1.0f && unpacked.colour.b == 1.0f && unpacked.colour.a == 0.0f);
+	CHECK_NEAR(unpacked.rotation, 315.0f, 0.5 * 360 / 256);
+	CHECK(PackAndUnpack(MakeFirework({ 0, 0, 0 }, 1.0f, { 1, 1, 1, 1 }, 359.9f), { 0, 0, 0 }).rotation == 0.0f);
+}
+
+
+// Gathering from the particle columns gives the same bytes as gathering Firework vertices and packing those
+void TestGathers()
+{
+	const int NumParticles = 50;
+	ParticleStore store;
+	for (int i = 0; i < NumParticles; ++i)
+	{
+		FireworkUpdate update = {};
+		update.type = FireworkType::StarSimple;
+		update.life = 1.0f;
+		store.Add(MakeFirework({ i * 1.5f, 10.0f - i, i * 0.25f }, 0.1f * i, { 1.0f, 0.5f, i / 50.0f, 1.0f - i / 50.0f }, i * 7.0f),
+		          update);
+	}
+	const CVector3 origin = { 5, 5, 5 };
+	std::vector<Firework> vertices(NumParticles);
+	store.GatherVertices(vertices.data(), 0.5f);
+	std::vector<PackedFirework> expected(NumParticles);
+	PackFireworks(vertices.data(), NumParticles, { expected.data(), NumParticles, origin });
+
+	// One spare vertex past the end, which must be left alone
+	std::vector<PackedFirework> packed(NumParticles + 1);
+	std::memset(packed.data(), 0x5a, packed.size() * sizeof(PackedFirework));
+	GatherPackedVertices(store.Span(), 0.5f, { packed.data(), NumParticles, origin });
+	CHECK(std::memcmp(packed.data(), expected.data(), NumParticles * sizeof(PackedFirework)) == 0);
+	CHECK(packed[NumParticles].positionXY == 0x5a5a5a5a && packed[NumParticles].colour == 0x5a5a5a5a);
+
+	// Every third visible, written one after another
+	std::vector<uint8_t> visible(NumParticles);
+	for (int i = 0; i < NumParticles; ++i)  visible[i] = i % 3 == 0;
+	int numWritten = GatherVisiblePackedVertices(store.Span(), visible.data(), 0.5f, { packed.data(), NumParticles, origin });
+	CHECK(numWritten == (NumParticles + 2) / 3);
+	for (int i = 0; i < numWritten; ++i)
+	{
+		CHECK(std::memcmp(&packed[i], &expected[i * 3], sizeof(PackedFirework)) == 0);
+	}
+}
+
+
+int main()
+{
+	TestPosition();
+	TestScale();
+	TestColourAndRotation();
+	TestGathers();
+	return TestResult("PackedFireworkTest");
+}
@@ -0,0 +1,137 @@
+//--------------------------------------------------------------------------------------
+// Tests of the SIMD particle kernels against the scalar reference
+//--------------------------------------------------------------------------------------
+// IntegrateParticles and BuildAliveMask are run at every SIMD level on spans whose lengths
+// are not whole registers and whose start is not register aligned, with a mix of star and
+// other types and of live and dead particles, and compared with the scalar versions
+
+#include "ParticleStore.h"
+#include "ParticleKernels.h"
+#include "TestCheck.h"
+
+#include <vector>
+
+
+// Fill a store with "count" particles of mixed types. Every third particle has run out of life, and a few are at
+// exactly zero life, which counts as dead
+void FillParticles(ParticleStore& store, int count)
+{
+	store.Clear();
+	for (int i = 0; i < count; ++i)
+	{
+		Firework firework;
+		firework.position = { i * 0.75f, 50.0f + i, -2.0f * i };
+		firework.scale    = 1.0f + (i % 5) * 0.1f;
+		firework.colour   = { 1.0f, 0.5f, 0.25f, 1.0f - (i % 4) * 0.2f };
+		firework.rotation = 0;
+
+		FireworkUpdate fireworkUpdate = FireworkUpdate();
+		fireworkUpdate.type     = static_cast<FireworkType>((i * 7) % NumFireworkTypes);
+		fireworkUpdate.id       = i;
+		fireworkUpdate.velocity = { 10.0f - i, 40.0f - 0.5f * i, 0.1f * i };
+		fireworkUpdate.life     = (i % 3 == 0) ? -0.5f : (i % 11 == 0 ? 0.0f : 0.02f * (i % 50));
+		store.Add(firework, fireworkUpdate);
+	}
+}
+
+
+// Relative tolerance for float results - the SIMD versions do the same operations but need not round identically
+bool Near(float a, float b)
+{
+	return std::fabs(a - b) <= 1e-5f * (1.0f + std::fabs(b));
+}
+
+void CheckSameParticles(const ParticleSpan& a, const ParticleSpan& b)
+{
+	CHECK(a.count == b.count);
+	for (int i = 0; i < a.count; ++i)
+	{
+		CHECK(Near(a.posX[i],  b.posX[i])  && Near(a.posY[i],  b.posY[i])  && Near(a.posZ[i],  b.posZ[i]));
+		CHECK(Near(a.prevX[i], b.prevX[i]) && Near(a.prevY[i], b.prevY[i]) && Near(a.prevZ[i], b.prevZ[i]));
+		CHECK(Near(a.velX[i],  b.velX[i])  && Near(a.velY[i],  b.velY[i])  && Near(a.velZ[i],  b.velZ[i]));
+		CHECK(Near(a.life[i], b.life[i]));
+		CHECK(Near(a.scale[i], b.scale[i]));
+		CHECK(Near(a.colourA[i], b.colourA[i]));
+	}
+}
+
+
+const int   TestLengths[] = { 1, 3, 5, 7, 9, 13, 31, 37, 101 };
+const int   TestOffsets[] = { 0, 1, 3 }; // Where the span starts in the store, so the SIMD versions also see unaligned columns
+const float FrameTime     = 1.0f / 60;
+const float Gravity       = -30.0f;
+
+
+void TestIntegrate()
+{
+	for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 })
+	{
+		SetParticleKernelLevel(level);
+		for (ParticleFade fade : { ParticleFade::ByType, ParticleFade::Always, ParticleFade::Never })
+		{
+			for (int length : TestLengths)
+			{
+				for (int offset : TestOffsets)
+				{
+					ParticleStore reference, tested;
+					FillParticles(reference, offset + length);
+					FillParticles(tested,    offset + length);
+
+					// Several steps, so particles that start dead carry on being integrated as the update expects
+					for (int step = 0; step < 3; ++step)
+					{
+						IntegrateParticlesScalar(reference.Span(offset, offset + length), FrameTime, Gravity, fade);
+						IntegrateParticles      (tested   .Span(offset, offset + length), FrameTime, Gravity, fade);
+					}
+					CheckSameParticles(tested.Span(), reference.Span());
+				}
+			}
+		}
+	}
+	SetParticleKernelLevel(DetectSimdLevel());
+}
+
+
+void TestAliveMask()
+{
+	for (int length : TestLengths)
+	{
+		for (int offset : TestOffsets)
+		{
+			ParticleStore store;
+			FillParticles(store, offset + length);
+			ParticleSpan span = store.Span(offset, offset + length);
+
+			SetParticleKernelLevel(SimdLevel::Scalar);
+			std::vector<uint8_t> reference(length, 2);
+			int referenceDead = BuildAliveMask(span, reference.data());
+
+			// The scalar mask itself must follow life > 0
+			int numDead = 0;
+			for (int i = 0; i < length; ++i)
+			{
+				CHECK(reference[i] == (span.life[i] > 0 ? 1 : 0));
+				numDead += span.life[i] > 0 ? 0 : 1;
+			}
+			CHECK(referenceDead == numDead);
+
+			for (SimdLevel level : { SimdLevel::SSE2, SimdLevel::AVX2 })
+			{
+				SetParticleKernelLevel(level);
+				std::vector<uint8_t> alive(length, 2);
+				CHECK(BuildAliveMask(span, alive.data()) == referenceDead);
+				CHECK(alive == reference);
+			}
+		}
+	}
+	SetParticleKernelLevel(DetectSimdLevel());
+}
+
+
+int main()
+{
+	std::printf("Kernels tested up to %s\n", SimdLevelName(DetectSimdLevel()));
+	TestIntegrate();
+	TestAliveMask();
+	return TestResult("ParticleKernelsTest");
+}
@@ -0,0 +1,141 @@
+//--------------------------------------------------------------------------------------
+// Tests of the SoA and AoSoA particle stores
+//--------------------------------------------------------------------------------------
+// Both stores are given the same particles and the same removals, then must hold the same
+// particles, give aligned columns, and update the same way with the particle kernels
+
+#include "ParticleStore.h"
+#include "ParticleKernels.h"
+#include "TestCheck.h"
+
+#include <cstdint>
+#include <vector>
+
+
+// Some particles of every type, not a whole number of blocks
+const int NumTestParticles = 45;
+
+void MakeParticle(int i, Firework& firework, FireworkUpdate& fireworkUpdate)
+{
+	firework.position = { i * 1.5f, 100.0f - i, i * -0.25f };
+	firework.scale    = 1.0f + i * 0.01f;
+	firework.colour   = { 0.1f * (i % 10), 0.5f, 1.0f, 1.0f - i * 0.01f };
+	firework.rotation = i * 7.0f;
+
+	fireworkUpdate = FireworkUpdate();
+	fireworkUpdate.type     = static_cast<FireworkType>(i % NumFireworkTypes);
+	fireworkUpdate.id       = 1000 + i;
+	fireworkUpdate.velocity = { i * 0.5f, 20.0f - i, 3.0f };
+	fireworkUpdate.life     = (i % 7 == 0) ? -1.0f : 0.5f + i * 0.1f;
+	fireworkUpdate.timer    = i * 0.05f;
+	fireworkUpdate.payloadIntA = i;
+}
+
+void FillStores(ParticleStore& store, ParticleBlockStore& blocks)
+{
+	store.Clear();
+	blocks.Clear();
+	for (int i = 0; i < NumTestParticles; ++i)
+	{
+		Firework firework;
+		FireworkUpdate fireworkUpdate;
+		MakeParticle(i, firework, fireworkUpdate);
+		CHECK(store .Add(firework, fireworkUpdate) == i);
+		CHECK(blocks.Add(firework, fireworkUpdate) == i);
+	}
+
+	// Removal copies the last particle into the hole in both stores
+	for (int index : { 3, 17, 0, 30 })
+	{
+		store .Remove(index);
+		blocks.Remove(index);
+	}
+}
+
+bool IsAligned(const void* pointer)
+{
+	return reinterpret_cast<uintptr_t>(pointer) % DefaultColumnAlignment == 0;
+}
+
+
+void TestSameParticles()
+{
+	ParticleStore store;
+	ParticleBlockStore blocks;
+	FillStores(store, blocks);
+	CHECK(store.Size() == blocks.Size());
+
+	for (int i = 0; i < store.Size(); ++i)
+	{
+		Firework       a  = store .GetFirework(i),       b  = blocks.GetFirework(i);
+		FireworkUpdate ua = store .GetFireworkUpdate(i), ub = blocks.GetFireworkUpdate(i);
+		CHECK(a.position.x == b.position.x && a.position.y == b.position.y && a.position.z == b.position.z);
+		CHECK(a.scale == b.scale && a.rotation == b.rotation && a.colour.a == b.colour.a);
+		CHECK(ua.type == ub.type && ua.id == ub.id && ua.life == ub.life && ua.timer == ub.timer);
+		CHECK(ua.velocity.y == ub.velocity.y && ua.payloadIntA == ub.payloadIntA);
+		CHECK(store.Type(i) == blocks.Type(i));
+	}
+}
+
+
+void TestBlockColumns()
+{
+	ParticleStore store;
+	ParticleBlockStore blocks;
+	FillStores(store, blocks);
+
+	int total = 0;
+	for (int b = 0; b < blocks.NumBlocks(); ++b)
+	{
+		ParticleSpan span = blocks.Block(b);
+		const void* columns[] = { span.posX, span.posY, span.posZ, span.prevX, span.prevY, span.prevZ, span.velX, span.velY,
+		                          span.velZ, span.life, span.timer, span.scale, span.colourR, span.colourG, span.colourB,
+		                          span.colourA, span.rotation, span.id };
+		for (const void* column : columns)  CHECK(IsAligned(column));
+		CHECK(span.count > 0 && span.count <= ParticleLaneWidth);
+		for (int i = 0; i < span.count; ++i)  CHECK(span.id[i] == store.GetFireworkUpdate(total + i).id);
+		total += span.count;
+	}
+	CHECK(total == blocks.Size());
+}
+
+
+// Integrating the SoA store in one span or the AoSoA store block by block gives the same particles, at each SIMD level
+void TestKernelsOnBlocks()
+{
+	for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 })
+	{
+		SetParticleKernelLevel(level);
+
+		ParticleStore store;
+		ParticleBlockStore blocks;
+		FillStores(store, blocks);
+
+		const float frameTime = 1.0f / 60;
+		IntegrateParticles(store.Span(), frameTime, -30.0f);
+		for (int b = 0; b < blocks.NumBlocks(); ++b)  IntegrateParticles(blocks.Block(b), frameTime, -30.0f);
+
+		std::vector<Firework> a(store.Size()), b(blocks.Size());
+		store .GatherVertices(a.data(), 0.5f);
+		blocks.GatherVertices(b.data(), 0.5f);
+		for (int i = 0; i < store.Size(); ++i)
+		{
+			CHECK_NEAR(a[i].position.x, b[i].position.x, 1e-4);
+			CHECK_NEAR(a[i].position.y, b[i].position.y, 1e-4);
+			CHECK_NEAR(a[i].position.z, b[i].position.z, 1e-4);
+			CHECK_NEAR(a[i].scale,      b[i].scale,      1e-6);
+			CHECK_NEAR(a[i].colour.a,   b[i].colour.a,   1e-6);
+			CHECK_NEAR(store.GetFireworkUpdate(i).life, blocks.GetFireworkUpdate(i).life, 1e-6);
+		}
+	}
+	SetParticleKernelLevel(DetectSimdLevel());
+}
+
+
+int main()
+{
+	TestSameParticles();
+	TestBlockColumns();
+	TestKernelsOnBlocks();
+	return TestResult("ParticleStoreTest");
+}
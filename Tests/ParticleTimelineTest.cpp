@@ -0,0 +1,134 @@
+//--------------------------------------------------------------------------------------
+// Tests of the particle timeline against the simulation
+//--------------------------------------------------------------------------------------
+// A show is simulated step by step while its spawns are recorded, and the timeline is
+// evaluated in closed form at the same times. Every simulated particle must be found in the
+// timeline by id, at nearly the same position, and evaluating out of order must give the
+// same particles as evaluating in order
+
+#include "FireworkSimulation.h"
+#include "FireworkLaunch.h"
+#include "ParticleTimeline.h"
+#include "TestCheck.h"
+
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+
+const float StepTime    = 1.0f / 60;
+const int   NumSteps    = 8 * 60;
+const int   CheckSteps  = 30;     // Steps between comparisons
+const float MaxPosition = 0.01f;  // Largest distance allowed between a simulated and an evaluated particle
+
+void Launch(int i, FireworkSimulation& simulation)
+{
+	LaunchParams params;
+	params.kind            = static_cast<LaunchKind>(i % NumLaunchKinds);
+	params.numFireworks    = 2;
+	params.position        = { i * 15.0f - 40.0f, 0.0f, 20.0f };
+	params.colour          = { 0.5f, 1.0f, 0.5f, 1.0f };
+	params.scale           = 1.0f;
+	params.rotation        = 0.0f;
+	params.initialVelocity = 90.0f;
+	params.burstParticles  = 150;
+	params.burstLife       = 2.5f;
+	params.seed            = 99 + i;
+	LaunchFireworks(params, simulation.Launches());
+}
+
+
+// Compare every particle of the pool with the evaluated particle of the same id. Returns the number compared
+int CompareWithPool(FireworkSimulation& simulation, ParticleStore& evaluated, double& maxError, int& numMissing)
+{
+	ParticleSpan e = evaluated.Span();
+	std::unordered_map<uint32_t, int> byId;
+	for (int i = 0; i < e.count; ++i)
+	{
+		auto inserted = byId.emplace(e.id[i], i);
+		if (!inserted.second)  inserted.first->second = -1; // Ids that are not unique can't be compared
+	}
+
+	int numCompared = 0;
+	ParticlePool& pool = simulation.Particles();
+	for (int stream = 0; stream < NumParticleStreams; ++stream)
+	{
+		pool.ForEachSpan(stream, 0, pool.StreamSize(stream), [&](const ParticleSpan& p, int)
+		{
+			for (int i = 0; i < p.count; ++i)
+			{
+				auto match = byId.find(p.id[i]);
+				if (match == byId.end())  { ++numMissing; continue; }
+				if (match->second < 0)  continue;
+				int j = match->second;
+				double dx = p.posX[i] - e.posX[j], dy = p.posY[i] - e.posY[j], dz = p.posZ[i] - e.posZ[j];
+				maxError = std::fmax(maxError, std::sqrt(dx * dx + dy * dy + dz * dz));
+				++numCompared;
+			}
+		});
+	}
+	return numCompared;
+}
+
+
+void TestMatchesSimulation()
+{
+	FireworkSimulation simulation(100000); // Room for the whole show, so nothing is evicted and both agree on who is alive
+	ParticleTimeline timeline(StepTime, simulation.Gravity());
+	simulation.SetTimeline(&timeline);
+
+	ParticleStore evaluated, early;
+	double earlyTime = 0;
+	double maxError = 0;
+	int numMissing = 0, numCompared = 0;
+	for (int step = 0; step < NumSteps; ++step)
+	{
+		if (step < 3 * 60 && step % 30 == 0)  Launch(step / 30, simulation);
+		simulation.Step(StepTime);
+		if ((step + 1) % CheckSteps != 0)  continue;
+
+		evaluated.Clear();
+		timeline.Evaluate(simulation.Time(), evaluated);
+		CHECK(evaluated.Size() == timeline.CountAlive(simulation.Time()));
+		numCompared += CompareWithPool(simulation, evaluated, maxError, numMissing);
+
+		// Keep one evaluation from the middle of the show to seek back to
+		if (step + 1 == 4 * 60)
+		{
+			early.Clear();
+			timeline.Evaluate(simulation.Time(), early);
+			earlyTime = simulation.Time();
+		}
+	}
+	CHECK(numCompared > 10000);
+	CHECK(numMissing == 0);
+	CHECK(maxError <= MaxPosition);
+
+	// Seeking back to an earlier time gives exactly the particles evaluated then
+	evaluated.Clear();
+	timeline.Evaluate(earlyTime, evaluated);
+	CHECK(early.Size() > 0 && evaluated.Size() == early.Size());
+	bool same = evaluated.Size() == early.Size();
+	for (int i = 0; same && i < early.Size(); ++i)
+	{
+		Firework a = early.GetFirework(i), b = evaluated.GetFirework(i);
+		same = early.GetFireworkUpdate(i).id == evaluated.GetFireworkUpdate(i).id &&
+		       a.position.x == b.position.x && a.position.y == b.position.y && a.position.z == b.position.z;
+	}
+	CHECK(same);
+
+	// The vertices are the evaluated particles in the same order
+	std::vector<Firework> vertices(timeline.CountAlive(earlyTime));
+	CHECK(timeline.GatherVertices(earlyTime, vertices.data()) == early.Size());
+	for (int i = 0; i < static_cast<int>(vertices.size()); ++i)
+	{
+		CHECK_NEAR(vertices[i].position.y, early.GetFirework(i).position.y, 1e-4);
+	}
+}
+
+
+int main()
+{
+	TestMatchesSimulation();
+	return TestResult("ParticleTimelineTest");
+}
@@ -0,0 +1,165 @@
+//--------------------------------------------------------------------------------------
+// Tests of the portable firework simulation library
+//--------------------------------------------------------------------------------------
+// Runs a short show of every launch kind through FireworkSimulation with no window, and
+// checks it is the same on any number of threads, keeps to its particle limit and burns
+// out once the launches stop
+
+#include "FireworkSimulation.h"
+#include "FireworkLaunch.h"
+#include "SpawnBuffer.h"
+#include "WorkerPool.h"
+#include "TestCheck.h"
+
+#include <vector>
+
+
+const float StepTime       = 1.0f / 60;
+const int   LaunchSteps    = 4 * 60;  // Launches for the first four seconds
+const int   LaunchInterval = 20;      // Steps between launches
+
+// Counts after every step and the vertices after the last
+struct ShowResult
+{
+	std::vector<int>      numParticles;
+	std::vector<int>      numSpawned;
+	std::vector<Firework> vertices;
+	int                   maxParticles = 0;
+	int                   numEvicted   = 0;
+	int                   numEvictedRockets = 0;
+	int                   numCapped    = 0;
+};
+
+ShowResult RunShow(WorkerPool* workers, int maxParticles, int numSteps, int emissionCap = -1)
+{
+	FireworkSimulation simulation(maxParticles);
+	simulation.SetWorkerPool(workers);
+	simulation.SetEmissionCap(emissionCap);
+
+	ShowResult result;
+	for (int step = 0; step < numSteps; ++step)
+	{
+		if (step < LaunchSteps && step % LaunchInterval == 0)
+		{
+			int i = step / LaunchInterval;
+			LaunchParams params;
+			params.kind            = static_cast<LaunchKind>(i % NumLaunchKinds);
+			params.numFireworks    = 3;
+			params.position        = { i * 10.0f - 60.0f, 0.0f, 0.0f };
+			params.colour          = { 1.0f, 0.5f, 0.25f, 1.0f };
+			params.scale           = 1.0f;
+			params.rotation        = 0.0f;
+			params.initialVelocity = 80.0f;
+			params.burstParticles  = 200;
+			params.burstLife       = 2.0f;
+			params.seed            = 1234 + i;
+			LaunchFireworks(params, simulation.Launches());
+		}
+		simulation.Step(StepTime);
+		result.numParticles.push_back(simulation.NumParticles());
+		result.numSpawned  .push_back(simulation.LastStepStats().numSpawned);
+		if (simulation.NumParticles() > result.maxParticles)  result.maxParticles = simulation.NumParticles();
+
+		const auto& stats = simulation.LastStepStats();
+		result.numEvicted += stats.numEvicted;
+		result.numCapped  += stats.numCapped;
+		for (int type = 0; type < NumFireworkTypes; ++type)
+		{
+			if (EvictionClass(static_cast<FireworkType>(type)) >= RocketEvictionClass)  result.numEvictedRockets += stats.numEvictedByType[type];
+		}
+	}
+
+	result.vertices.resize(simulation.Particles().Size());
+	simulation.Particles().GatherVertices(result.vertices.data(), 1.0f);
+	return result;
+}
+
+
+// Chunks are a fixed size, not one per thread, so threads must not change anything
+void TestSameOnAnyThreads()
+{
+	const int numSteps = 6 * 60;
+	ShowResult single = RunShow(nullptr, 50000, numSteps);
+
+	WorkerPool workers(4);
+	ShowResult threaded = RunShow(&workers, 50000, numSteps);
+
+	CHECK(single.numParticles == threaded.numParticles);
+	CHECK(single.numSpawned   == threaded.numSpawned);
+	CHECK(single.vertices.size() == threaded.vertices.size());
+	bool same = single.vertices.size() == threaded.vertices.size();
+	for (size_t i = 0; same && i < single.vertices.size(); ++i)
+	{
+		const Firework& a = single.vertices[i];
+		const Firework& b = threaded.vertices[i];
+		same = a.position.x == b.position.x && a.position.y == b.position.y && a.position.z == b.position.z &&
+		       a.scale == b.scale && a.colour.a == b.colour.a;
+	}
+	CHECK(same);
+	CHECK(single.maxParticles > 1000); // The show did make plenty of particles
+}
+
+
+void TestParticleLimit()
+{
+	const int limit = 2000;
+	ShowResult result = RunShow(nullptr, limit, 6 * 60);
+	CHECK(result.maxParticles <= limit);
+	CHECK(result.maxParticles > limit / 2);
+
+	// A full pool makes room for rockets and their bursts by evicting the oldest stars, never rockets
+	CHECK(result.numEvicted > 0);
+	CHECK(result.numEvictedRockets == 0);
+}
+
+
+// A small emission cap holds trails back, and one too big to reach (even summed over a whole chunk) changes nothing
+void TestEmissionCap()
+{
+	const int numSteps = 3 * 60;
+	ShowResult uncapped = RunShow(nullptr, 50000, numSteps);
+	ShowResult huge     = RunShow(nullptr, 50000, numSteps, 2000000000);
+	ShowResult small    = RunShow(nullptr, 50000, numSteps, 20);
+	CHECK(uncapped.numCapped == 0 && huge.numCapped == 0);
+	CHECK(huge.numSpawned == uncapped.numSpawned);
+	CHECK(small.numCapped > 0);
+}
+
+
+// Emitters that can't run are refused, and the old emitter kept
+void TestInvalidEmitter()
+{
+	FireworkSimulation simulation(1000);
+	EmitterDesc noBurst = CometEmitter();
+	noBurst.burst = 0;
+	EmitterDesc negativeInterval = CometEmitter();
+	negativeInterval.interval = -0.1f;
+	CHECK(!simulation.SetEmitter(FireworkType::CometRocket, noBurst));
+	CHECK(!simulation.SetEmitter(FireworkType::CometRocket, negativeInterval));
+	CHECK(simulation.GetEmitter(FireworkType::CometRocket).burst == CometEmitter().burst);
+
+	EmitterDesc bigger = CometEmitter();
+	bigger.burst = 3;
+	CHECK(simulation.SetEmitter(FireworkType::CometRocket, bigger));
+	CHECK(simulation.GetEmitter(FireworkType::CometRocket).burst == 3);
+}
+
+
+// Every particle has a finite life, so the show burns out
+void TestBurnsOut()
+{
+	ShowResult result = RunShow(nullptr, 50000, LaunchSteps + 20 * 60);
+	CHECK(result.numParticles.back() == 0);
+	CHECK(result.vertices.empty());
+}
+
+
+int main()
+{
+	TestSameOnAnyThreads();
+	TestParticleLimit();
+	TestEmissionCap();
+	TestInvalidEmitter();
+	TestBurnsOut();
+	return TestResult("SimulationTest");
+}
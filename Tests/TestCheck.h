@@ -0,0 +1,48 @@
+//--------------------------------------------------------------------------------------
+// Checks for the unit tests
+//--------------------------------------------------------------------------------------
+// Each test is a small program built with the CMake project and run by CTest. A failed
+// check prints where it failed and carries on, and the program returns TestResult() from
+// main, which is non-zero if any check failed. No test framework is needed, so the tests
+// build anywhere the simulation library does
+
+#ifndef _TEST_CHECK_H_INCLUDED_
+#define _TEST_CHECK_H_INCLUDED_
+
+#include <cmath>
+#include <cstdio>
+
+
+inline int& NumFailedChecks()
+{
+	static int numFailed = 0;
+	return numFailed;
+}
+
+inline void ReportFailedCheck(const char* file, int line, const char* check)
+{
+	std::printf("%s(%d): check failed: %s\n", file, line, check);
+	++NumFailedChecks();
+}
+
+
+// Check a condition is true
+#define CHECK(condition) \
+	do { if (!(condition))  ReportFailedCheck(__FILE__, __LINE__, #condition); } while (0)
+
+// Check two numbers are no more than "tolerance" apart
+#define CHECK_NEAR(a, b, tolerance) \
+	do { if (!(std::fabs(static_cast<double>(a) - static_cast<double>(b)) <= (tolerance))) \
+	         ReportFailedCheck(__FILE__, __LINE__, #a " near " #b); } while (0)
+
+
+// Print the result and return the exit code for main
+inline int TestResult(const char* name)
+{
+	if (NumFailedChecks() == 0)  std::printf("%s: passed\n", name);
+	else                         std::printf("%s: %d checks failed\n", name, NumFailedChecks());
+	return NumFailedChecks() == 0 ? 0 : 1;
+}
+
+
+#endif //_TEST_CHECK_H_INCLUDED_
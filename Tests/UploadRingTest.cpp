@@ -0,0 +1,153 @@
+//--------------------------------------------------------------------------------------
+// Tests of the upload ring against the mock backend
+//--------------------------------------------------------------------------------------
+// Each test runs a few frames of uploads through a small ring and checks where every upload
+// went and how the buffer was mapped for it. The mock also checks that no upload wrote over
+// bytes its pretend GPU was still reading
+
+#include "UploadRing.h"
+#include "TestCheck.h"
+
+#include <cstring>
+
+
+const int Capacity  = 1000;
+const int NumFences = NumUploadFrames;
+
+// Upload "bytes" bytes, all of which are used, and check it went to the expected offset with the expected map mode
+void Upload(UploadRing& ring, MockUploadBackend& backend, int bytes, int alignment, int expectedOffset, UploadMap expectedMode)
+{
+	int discards    = backend.NumDiscards();
+	int noOverwrite = backend.NumNoOverwrite();
+
+	void* mapped = ring.Begin(bytes, alignment);
+	CHECK(mapped != nullptr);
+	if (mapped != nullptr)  std::memset(mapped, 0xAB, bytes);
+	int offset = ring.End(bytes);
+
+	CHECK(offset == expectedOffset);
+	CHECK(offset % alignment == 0);
+	CHECK(backend.CheckWrite(offset, bytes));
+	if (expectedMode == UploadMap::Discard)  CHECK(backend.NumDiscards() == discards + 1 && backend.NumNoOverwrite() == noOverwrite);
+	else                                     CHECK(backend.NumNoOverwrite() == noOverwrite + 1 && backend.NumDiscards() == discards);
+}
+
+
+// Uploads follow each other, aligned, and only the first map discards
+void TestSequential()
+{
+	MockUploadBackend backend(Capacity, NumFences, 2);
+	UploadRing ring(backend);
+
+	Upload(ring, backend, 100, 16, 0,   UploadMap::Discard);
+	Upload(ring, backend, 100, 64, 128, UploadMap::NoOverwrite); // Skips to the next multiple of 64 after 100
+	ring.EndFrame();
+
+	// Bytes not used are given back, so the next upload starts straight after the used ones
+	void* mapped = ring.Begin(500, 4);
+	CHECK(mapped != nullptr);
+	CHECK(ring.End(100) == 228);
+	CHECK(backend.CheckWrite(228, 100));
+	Upload(ring, backend, 50, 4, 328, UploadMap::NoOverwrite);
+
+	CHECK(ring.Stats().numUploads == 4);
+	CHECK(ring.Stats().numBytes == 350);
+	CHECK(ring.Stats().numDiscards == 1);
+}
+
+
+// An upload that doesn't fit before the end of the buffer goes to the start once the GPU has finished with it
+void TestWrap()
+{
+	MockUploadBackend backend(Capacity, NumFences, 1); // Each frame finishes when the next is signalled
+	UploadRing ring(backend);
+
+	Upload(ring, backend, 400, 4, 0,   UploadMap::Discard);
+	ring.EndFrame();
+	Upload(ring, backend, 400, 4, 400, UploadMap::NoOverwrite);
+	ring.EndFrame();
+	Upload(ring, backend, 400, 4, 0,   UploadMap::NoOverwrite); // Only 200 left at the end, the first frame is done
+	ring.EndFrame();
+
+	CHECK(ring.Stats().numWraps == 1);
+	CHECK(ring.Stats().numDiscards == 1);
+}
+
+
+// When the start of the buffer is still in flight an upload that doesn't fit at the end discards
+void TestDiscardInFlight()
+{
+	MockUploadBackend backend(Capacity, NumFences, 3); // The GPU is three frames behind
+	UploadRing ring(backend);
+
+	Upload(ring, backend, 400, 4, 0,   UploadMap::Discard);
+	ring.EndFrame();
+	Upload(ring, backend, 400, 4, 400, UploadMap::NoOverwrite);
+	ring.EndFrame();
+	Upload(ring, backend, 400, 4, 0,   UploadMap::Discard);
+
+	// The frames in flight keep the old buffer, so the new one is free after this upload
+	Upload(ring, backend, 500, 4, 400, UploadMap::NoOverwrite);
+	ring.EndFrame();
+
+	CHECK(ring.Stats().numWraps == 0);
+	CHECK(ring.Stats().numDiscards == 2);
+}
+
+
+// A frame the GPU has finished frees its bytes, so an upload that would have discarded a frame earlier wraps instead
+void TestFenceRetires()
+{
+	MockUploadBackend backend(Capacity, NumFences, 2);
+	UploadRing ring(backend);
+
+	Upload(ring, backend, 400, 4, 0,   UploadMap::Discard);
+	ring.EndFrame();
+	Upload(ring, backend, 400, 4, 400, UploadMap::NoOverwrite);
+	ring.EndFrame();
+
+	// The first frame isn't finished yet, so only the 200 bytes at the end are free
+	CHECK(!backend.FenceDone(0));
+	Upload(ring, backend, 200, 4, 800, UploadMap::NoOverwrite);
+	ring.EndFrame();
+
+	// Now it is, and its 400 bytes at the start can be used again
+	CHECK(backend.FenceDone(0));
+	Upload(ring, backend, 400, 4, 0,   UploadMap::NoOverwrite);
+	ring.EndFrame();
+
+	CHECK(ring.Stats().numWraps == 1);
+	CHECK(ring.Stats().numDiscards == 1);
+}
+
+
+// An upload bigger than the whole buffer fails without mapping, and the ring carries on as before
+void TestTooBig()
+{
+	MockUploadBackend backend(Capacity, NumFences, 2);
+	UploadRing ring(backend);
+
+	Upload(ring, backend, 300, 4, 0, UploadMap::Discard);
+	CHECK(ring.Begin(Capacity + 1, 4) == nullptr);
+	CHECK(ring.Stats().numTooBig == 1);
+	CHECK(backend.NumDiscards() == 1 && backend.NumNoOverwrite() == 0);
+
+	Upload(ring, backend, 300, 4, 300, UploadMap::NoOverwrite);
+	ring.EndFrame();
+
+	// The whole buffer is not too big, but with frames in flight it only fits in a new one
+	Upload(ring, backend, Capacity, 4, 0, UploadMap::Discard);
+	ring.EndFrame();
+	CHECK(ring.Stats().numTooBig == 1);
+}
+
+
+int main()
+{
+	TestSequential();
+	TestWrap();
+	TestDiscardInFlight();
+	TestFenceRetires();
+	TestTooBig();
+	return TestResult("UploadRingTest");
+}
@@ -0,0 +1,55 @@
+//--------------------------------------------------------------------------------------
+// Allocator for std::vector that aligns its storage, used for SIMD-friendly data columns
+//--------------------------------------------------------------------------------------
+
+#ifndef _ALIGNED_ALLOCATOR_H_INCLUDED_
+#define _ALIGNED_ALLOCATOR_H_INCLUDED_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+
+// Default alignment is 32 bytes - the size of an AVX register, so aligned loads can be used on any column
+const std::size_t DefaultColumnAlignment = 32;
+
+
+// Minimal allocator that allocates on the given byte alignment. Use through the AlignedVector alias below
+template <class T, std::size_t Alignment = DefaultColumnAlignment>
+class AlignedAllocator
+{
+public:
+	using value_type = T;
+
+	template <class U>
+	struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+	AlignedAllocator() noexcept {}
+
+	template <class U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+	T* allocate(std::size_t count)
+	{
+		return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+	}
+
+	void deallocate(T* p, std::size_t) noexcept
+	{
+		::operator delete(p, std::align_val_t(Alignment));
+	}
+
+	template <class U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+
+	template <class U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+
+// A std::vector whose data() pointer is always aligned to the given number of bytes
+template <class T, std::size_t Alignment = DefaultColumnAlignment>
+using AlignedVector = std::vector<T, AlignedAllocator<T, Alignment>>;
+
+
+#endif //_ALIGNED_ALLOCATOR_H_INCLUDED_
@@ -0,0 +1,65 @@
+//--------------------------------------------------------------------------------------
+// Runtime detection of the SIMD instruction sets supported by the CPU
+//--------------------------------------------------------------------------------------
+
+#include "CpuFeatures.h"
+
+#if SIMD_X86_AVAILABLE && defined(_MSC_VER)
+	#include <intrin.h>
+	#include <immintrin.h>
+#endif
+
+
+// Query the CPU for its best supported level
+static SimdLevel QuerySimdLevel()
+{
+#if !SIMD_X86_AVAILABLE
+	return SimdLevel::Scalar;
+
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse2    = (info[3] & (1 << 26)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx     = (info[2] & (1 << 28)) != 0;
+	if (!sse2)  return SimdLevel::Scalar;
+
+	// AVX registers are only usable if the OS saves them on context switch (XCR0 bits 1 and 2)
+	if (avx && osxsave && maxLeaf >= 7 && (_xgetbv(0) & 0x6) == 0x6)
+	{
+		__cpuidex(info, 7, 0);
+		if (info[1] & (1 << 5))  return SimdLevel::AVX2;
+	}
+	return SimdLevel::SSE2;
+
+#else
+	// GCC / Clang builtin checks both the CPU and OS support
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))  return SimdLevel::AVX2;
+	if (__builtin_cpu_supports("sse2"))  return SimdLevel::SSE2;
+	return SimdLevel::Scalar;
+#endif
+}
+
+
+// Returns the best SIMD level supported by both this CPU and the operating system. Result is cached after the first call
+SimdLevel DetectSimdLevel()
+{
+	static const SimdLevel level = QuerySimdLevel();
+	return level;
+}
+
+
+// Name of a SIMD level for display, e.g. "AVX2"
+const char* SimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+		case SimdLevel::AVX2: return "AVX2";
+		case SimdLevel::SSE2: return "SSE2";
+		default:              return "Scalar";
+	}
+}
@@ -0,0 +1,37 @@
+//--------------------------------------------------------------------------------------
+// Runtime detection of the SIMD instruction sets supported by the CPU
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+
+#ifndef _CPU_FEATURES_H_INCLUDED_
+#define _CPU_FEATURES_H_INCLUDED_
+
+
+// SIMD instruction set levels, in increasing order of capability
+enum class SimdLevel { Scalar, SSE2, AVX2 };
+
+
+// Returns the best SIMD level supported by both this CPU and the operating system. Result is cached after the first call
+SimdLevel DetectSimdLevel();
+
+// Name of a SIMD level for display, e.g. "AVX2"
+const char* SimdLevelName(SimdLevel level);
+
+
+// True if SSE2 / AVX2 code paths are compiled into this build at all (x86/x64 targets only)
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define SIMD_X86_AVAILABLE 1
+#else
+	#define SIMD_X86_AVAILABLE 0
+#endif
+
+// Functions that use AVX2 intrinsics must be marked with this. Visual Studio allows AVX2 intrinsics anywhere,
+// GCC and Clang need the function to be compiled for the AVX2 target explicitly
+#if defined(_MSC_VER)
+	#define SIMD_TARGET_AVX2
+#else
+	#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+#endif //_CPU_FEATURES_H_INCLUDED_
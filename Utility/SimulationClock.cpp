@@ -0,0 +1,49 @@
+//--------------------------------------------------------------------------------------
+// Fixed-timestep simulation clock
+//--------------------------------------------------------------------------------------
+
+#include "SimulationClock.h"
+
+
+SimulationClock::SimulationClock(float stepTime, int maxStepsPerFrame)
+	: mStepTime(stepTime), mMaxStepsPerFrame(maxStepsPerFrame > 0 ? maxStepsPerFrame : 1)
+{
+	Reset();
+}
+
+
+void SimulationClock::Reset()
+{
+	mAccumulator = 0;
+	mTotalSteps  = 0;
+	mDroppedTime = 0;
+}
+
+
+void SimulationClock::SetStepTime(float stepTime)
+{
+	// Keep the same fraction of a step in the accumulator so interpolation doesn't jump
+	float fraction = mAccumulator / mStepTime;
+	mStepTime = stepTime;
+	mAccumulator = fraction * mStepTime;
+}
+
+
+// Add the real time passed since the last frame, returns the number of fixed steps to run this frame
+int SimulationClock::Advance(float frameTime)
+{
+	if (frameTime > 0)  mAccumulator += frameTime;
+
+	int steps = static_cast<int>(mAccumulator / mStepTime);
+	if (steps > mMaxStepsPerFrame)
+	{
+		// Too far behind - run the maximum and drop whole steps beyond it, keeping the fraction for interpolation
+		mDroppedTime += (steps - mMaxStepsPerFrame) * mStepTime;
+		steps = mMaxStepsPerFrame;
+	}
+	mAccumulator -= static_cast<int>(mAccumulator / mStepTime) * mStepTime;
+	if (mAccumulator < 0)  mAccumulator = 0; // Rounding
+
+	mTotalSteps += steps;
+	return steps;
+}
@@ -0,0 +1,63 @@
+//--------------------------------------------------------------------------------------
+// Fixed-timestep simulation clock
+//--------------------------------------------------------------------------------------
+// Turns variable frame times into a whole number of fixed-length simulation steps. Real time
+// is collected in an accumulator and spent a step at a time, so the simulation behaves the
+// same (and costs the same per second) at any frame rate. Leftover time is returned as an
+// interpolation factor so rendering can blend between the last two simulation states
+// Code in .cpp file
+
+#ifndef _SIMULATION_CLOCK_H_INCLUDED_
+#define _SIMULATION_CLOCK_H_INCLUDED_
+
+#include <stdint.h>
+
+
+class SimulationClock
+{
+public:
+	// Construction //
+
+	// stepTime is the fixed simulation step in seconds. maxStepsPerFrame caps the catch-up after a long frame
+	// (e.g. a breakpoint or window drag) - time beyond the cap is dropped rather than simulated
+	SimulationClock(float stepTime = 1.0f / 60.0f, int maxStepsPerFrame = 5);
+
+
+	// Stepping //
+
+	// Add the real time passed since the last frame, returns the number of fixed steps to run this frame
+	int Advance(float frameTime);
+
+	// Forget any accumulated time and counters
+	void Reset();
+
+
+	// Settings //
+
+	float StepTime() const { return mStepTime; }
+	void  SetStepTime(float stepTime);
+
+	int  MaxStepsPerFrame() const             { return mMaxStepsPerFrame; }
+	void SetMaxStepsPerFrame(int maxSteps)    { mMaxStepsPerFrame = maxSteps > 0 ? maxSteps : 1; }
+
+
+	// State //
+
+	// How far real time is between the last two steps: 0 = at the previous step, 1 = at the latest step.
+	// Render the state as previous + (current - previous) * Interpolation()
+	float Interpolation() const { return mAccumulator / mStepTime; }
+
+	uint64_t TotalSteps()  const { return mTotalSteps; }
+	float    DroppedTime() const { return mDroppedTime; } // Total real time discarded by the catch-up cap
+
+
+private:
+	float    mStepTime;
+	int      mMaxStepsPerFrame;
+	float    mAccumulator;
+	uint64_t mTotalSteps;
+	float    mDroppedTime;
+};
+
+
+#endif //_SIMULATION_CLOCK_H_INCLUDED_
@@ -0,0 +1,93 @@
+//--------------------------------------------------------------------------------------
+// Hierarchical timing wheel - schedules events by tick and fires them when the tick passes
+//--------------------------------------------------------------------------------------
+
+#include "TimingWheel.h"
+
+
+void TimingWheel::Reset()
+{
+	for (auto& level : mSlots)
+	{
+		for (auto& slot : level)  slot.clear();
+	}
+	mDue.clear();
+	mNow  = 0;
+	mSize = 0;
+}
+
+
+void TimingWheel::Insert(uint64_t tick, int tag)
+{
+	++mSize;
+	if (tick <= mNow)  mDue.push_back({ tick, tag });
+	else               Place({ tick, tag });
+}
+
+
+// The level is chosen by how many of that level's slots away the event is, so an event is always cascaded down (or
+// fired) the next time its slot comes round, never a whole turn of the wheel later
+void TimingWheel::Place(const Event& event)
+{
+	if (event.tick - mNow < NumSlots)
+	{
+		mSlots[0][event.tick & SlotMask].push_back(event);
+		return;
+	}
+	for (int level = 1; level < NumLevels; ++level)
+	{
+		int shift = level * SlotBits;
+		if ((event.tick >> shift) - (mNow >> shift) < NumSlots)
+		{
+			mSlots[level][(event.tick >> shift) & SlotMask].push_back(event);
+			return;
+		}
+	}
+
+	// Too far ahead - park it in the top level slot that will cascade last, it will be placed again from there
+	const int topShift = (NumLevels - 1) * SlotBits;
+	mSlots[NumLevels - 1][((mNow >> topShift) + NumSlots - 1) & SlotMask].push_back(event);
+}
+
+
+void TimingWheel::Cascade(int level, int slot)
+{
+	mCascade.swap(mSlots[level][slot]); // Keeps the capacity of both vectors
+	for (const Event& event : mCascade)  Place(event);
+	mCascade.clear();
+}
+
+
+void TimingWheel::Advance(uint64_t tick, std::vector<Event>& fired)
+{
+	mSize -= static_cast<int>(mDue.size());
+	fired.insert(fired.end(), mDue.begin(), mDue.end());
+	mDue.clear();
+
+	while (mNow < tick)
+	{
+		if (mSize == 0)
+		{
+			mNow = tick; // Nothing to fire or cascade on the way
+			break;
+		}
+		++mNow;
+
+		// When a level wraps round, bring down the next slot of the level above it, starting from the top. Events due on
+		// this very tick end up in the first level's current slot and fire below
+		if ((mNow & SlotMask) == 0)
+		{
+			for (int level = NumLevels - 1; level > 0; --level)
+			{
+				int shift = level * SlotBits;
+				if ((mNow & ((uint64_t(1) << shift) - 1)) == 0)  Cascade(level, (mNow >> shift) & SlotMask);
+			}
+		}
+
+		std::vector<Event>& slot = mSlots[0][mNow & SlotMask];
+		if (slot.empty())  continue;
+		mSize -= static_cast<int>(slot.size());
+		fired.insert(fired.end(), slot.begin(), slot.end());
+		slot.clear();
+	}
+}
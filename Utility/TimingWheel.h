@@ -0,0 +1,74 @@
+//--------------------------------------------------------------------------------------
+// Hierarchical timing wheel - schedules events by tick and fires them when the tick passes
+//--------------------------------------------------------------------------------------
+// Three levels of 64 slots. The first level holds events in the next 64 ticks, one slot
+// per tick. Each slot of the second level covers 64 ticks, and each slot of the third
+// level covers 4096 ticks. Each time the lower level wraps round, the next slot of the
+// level above is cascaded down into it. Inserting and firing an event is constant time
+// however far ahead it is, and advancing a tick with nothing due only looks at one slot.
+// Events past the range of the top level are parked in its furthest slot and re-inserted
+// each time it cascades
+// Code in .cpp file
+
+#ifndef _TIMING_WHEEL_H_INCLUDED_
+#define _TIMING_WHEEL_H_INCLUDED_
+
+#include <stdint.h>
+#include <vector>
+
+
+class TimingWheel
+{
+public:
+	// An event is just a tick and a caller-defined tag saying what it is for
+	struct Event
+	{
+		uint64_t tick;
+		int      tag;
+	};
+
+
+	// Construction //
+
+	TimingWheel() { Reset(); }
+
+	// Remove all events and set the current tick back to 0
+	void Reset();
+
+
+	// Usage //
+
+	// Schedule an event for the given tick. Events at or before the current tick fire on the next Advance
+	void Insert(uint64_t tick, int tag);
+
+	// Move the current tick forward to the given tick, appending every event that comes due to "fired"
+	// (in tick order, and in insertion order within a tick)
+	void Advance(uint64_t tick, std::vector<Event>& fired);
+
+	uint64_t CurrentTick() const { return mNow; }
+
+	// Number of events waiting to fire
+	int Size() const { return mSize; }
+
+
+private:
+	static const int SlotBits  = 6;
+	static const int NumSlots  = 1 << SlotBits;
+	static const int SlotMask  = NumSlots - 1;
+	static const int NumLevels = 3;
+
+	// Put an event in the slot for its distance from the current tick
+	void Place(const Event& event);
+
+	// Move the events in a slot back through Place, which puts them in a lower level now that they are closer
+	void Cascade(int level, int slot);
+
+	std::vector<Event> mSlots[NumLevels][NumSlots];
+	std::vector<Event> mDue;     // Inserted at or before the current tick
+	std::vector<Event> mCascade; // Scratch space for Cascade
+	uint64_t mNow;
+	int      mSize;
+};
+
+
+#endif //_TIMING_WHEEL_H_INCLUDED_
@@ -0,0 +1,185 @@
+//--------------------------------------------------------------------------------------
+// Upload ring - sub-allocates per-frame uploads from one large dynamic buffer
+//--------------------------------------------------------------------------------------
+
+#include "UploadRing.h"
+
+#include <algorithm>
+
+
+//--------------------------------------------------------------------------------------
+// Mock backend
+//--------------------------------------------------------------------------------------
+
+MockUploadBackend::MockUploadBackend(int capacity, int numFences, int latency)
+	: mBuffer(capacity), mSignalled(numFences, 0), mLatency(latency)
+{
+}
+
+
+void* MockUploadBackend::Map(UploadMap mode)
+{
+	if (mode == UploadMap::Discard)
+	{
+		// Everything written before is in the old buffer, which is left to the pretend GPU
+		++mNumDiscards;
+		mWrites.clear();
+	}
+	else
+	{
+		++mNumNoOverwrite;
+	}
+	return mBuffer.data();
+}
+
+
+void MockUploadBackend::SignalFence(int fence)
+{
+	++mNumSignalled;
+	mSignalled[fence] = mNumSignalled;
+}
+
+
+// The pretend GPU finishes the frame before the nth fence signalled when n + latency fences have been signalled
+bool MockUploadBackend::FenceDone(int fence)
+{
+	return mNumSignalled >= mSignalled[fence] + mLatency;
+}
+
+
+bool MockUploadBackend::CheckWrite(int offset, int size)
+{
+	// Forget writes of finished frames, then look for any overlap with the rest. Writes by the current frame (before the
+	// next fence) can be overwritten
+	uint64_t current = mNumSignalled + 1;
+	mWrites.erase(std::remove_if(mWrites.begin(), mWrites.end(), [&](const Write& write)
+	{
+		return write.fence < current && mNumSignalled >= write.fence + mLatency;
+	}), mWrites.end());
+
+	bool safe = true;
+	for (const auto& write : mWrites)
+	{
+		bool overlaps = offset < write.offset + write.size && write.offset < offset + size;
+		if (overlaps && write.fence < current)  safe = false;
+	}
+	if (size > 0)  mWrites.push_back({ offset, size, current });
+	return safe;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Ring
+//--------------------------------------------------------------------------------------
+
+UploadRing::UploadRing(UploadBackend& backend)
+	: mBackend(backend), mCapacity(backend.Capacity())
+{
+}
+
+
+void* UploadRing::Begin(int maxBytes, int alignment)
+{
+	RetireFrames();
+	if (maxBytes > mCapacity)
+	{
+		++mStats.numTooBig;
+		return nullptr;
+	}
+
+	// After the last upload if it fits before the end of the buffer and the frames in flight, otherwise at the start if
+	// that fits before the frames in flight. The bytes in between are skipped. If neither fits, discard
+	int aligned = (mHead + alignment - 1) / alignment * alignment;
+	UploadMap mode   = UploadMap::NoOverwrite;
+	int       offset = 0;
+	int       taken  = 0; // Bytes the upload takes from the ring, including those skipped before it
+	bool      wraps  = false;
+	if (mNeedsDiscard)
+	{
+		mode = UploadMap::Discard;
+	}
+	else if (aligned + maxBytes <= mCapacity && mUsed + (aligned - mHead) + maxBytes <= mCapacity)
+	{
+		offset = aligned;
+		taken  = aligned - mHead + maxBytes;
+	}
+	else if (mUsed + (mCapacity - mHead) + maxBytes <= mCapacity)
+	{
+		taken = mCapacity - mHead + maxBytes;
+		wraps = true;
+	}
+	else
+	{
+		mode = UploadMap::Discard;
+	}
+
+	void* mapped = mBackend.Map(mode);
+	if (mapped == nullptr)  return nullptr;
+
+	if (mode == UploadMap::Discard)
+	{
+		// The frames in flight keep the old buffer, so their bytes are free in the new one. They still have fences, which
+		// retire as usual
+		for (auto& frame : mFrames)  frame.numBytes = 0;
+		mUsed       = 0;
+		mFrameBytes = 0;
+		taken       = maxBytes;
+		mNeedsDiscard = false;
+		++mStats.numDiscards;
+	}
+	if (wraps)  ++mStats.numWraps;
+
+	mHead        = offset + maxBytes;
+	mUsed       += taken;
+	mFrameBytes += taken;
+	mMapped      = static_cast<uint8_t*>(mapped);
+	mBeginOffset = offset;
+	mBeginBytes  = maxBytes;
+	return mMapped + offset;
+}
+
+
+int UploadRing::End(int usedBytes)
+{
+	// Give back the bytes not used from the end of the upload
+	usedBytes = std::min(std::max(usedBytes, 0), mBeginBytes);
+	int unused = mBeginBytes - usedBytes;
+	mHead       -= unused;
+	mUsed       -= unused;
+	mFrameBytes -= unused;
+
+	if (mMapped != nullptr)  mBackend.Unmap();
+	mMapped = nullptr;
+	++mStats.numUploads;
+	mStats.numBytes += usedBytes;
+	return mBeginOffset;
+}
+
+
+void UploadRing::EndFrame()
+{
+	// Fences are used in turn, so the next one is free unless every fence has a frame in flight. In that case the frame
+	// joins the newest one, whose fence is signalled again - the GPU passes it later, so its bytes are kept long enough
+	RetireFrames();
+	if (static_cast<int>(mFrames.size()) < mBackend.NumFences())
+	{
+		mFrames.push_back({ mNextFence, mFrameBytes });
+		mNextFence = (mNextFence + 1) % mBackend.NumFences();
+	}
+	else
+	{
+		mFrames.back().numBytes += mFrameBytes;
+	}
+	mBackend.SignalFence(mFrames.back().fence);
+	mFrameBytes = 0;
+}
+
+
+void UploadRing::RetireFrames()
+{
+	while (!mFrames.empty() && mBackend.FenceDone(mFrames.front().fence))
+	{
+		mUsed -= mFrames.front().numBytes;
+		mFrames.pop_front();
+	}
+}
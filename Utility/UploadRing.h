@@ -0,0 +1,174 @@
+//--------------------------------------------------------------------------------------
+// Upload ring - sub-allocates per-frame uploads from one large dynamic buffer
+//--------------------------------------------------------------------------------------
+// Each frame's upload goes after the last one in a buffer big enough for several frames,
+// mapped with "no overwrite" - a promise to the driver not to touch any data the GPU may
+// still be reading, so it never has to stall or copy the buffer. The ring keeps track of
+// the bytes each frame in flight used, with a fence after each frame to find out when the
+// GPU has finished with them. When an upload doesn't fit before the end of the buffer it
+// wraps round to the start, which is still mapped "no overwrite" if the frames there are
+// finished. Only if they are not (the GPU is too far behind, or the buffer too small) is
+// the buffer mapped with "discard", which gives a fresh buffer and lets the driver keep the
+// old one until the GPU is done with it
+//
+// The buffer and fences are reached through the UploadBackend interface, so the ring can
+// run against a D3D11 buffer (see Scene.cpp) or the MockUploadBackend below, which keeps
+// the buffer in ordinary memory and finishes each frame a set number of frames later
+// Code in .cpp file
+
+#ifndef _UPLOAD_RING_H_INCLUDED_
+#define _UPLOAD_RING_H_INCLUDED_
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+
+//--------------------------------------------------------------------------------------
+// Backend
+//--------------------------------------------------------------------------------------
+
+enum class UploadMap
+{
+	Discard,     // Contents can be thrown away, the GPU keeps the old buffer while it needs it
+	NoOverwrite, // Contents kept, the caller promises only to write to parts the GPU isn't using
+};
+
+// A buffer the ring allocates from, and a fixed number of fences to follow the GPU with
+class UploadBackend
+{
+public:
+	virtual ~UploadBackend() {}
+
+	// Size of the buffer in bytes
+	virtual int Capacity() const = 0;
+
+	// Map the whole buffer for writing and return its start, or nullptr on failure. Unmap before the GPU uses it
+	virtual void* Map(UploadMap mode) = 0;
+	virtual void  Unmap() = 0;
+
+	// Fences are numbered from 0 to NumFences() - 1. Signal puts a fence after all the GPU work so far, and FenceDone says
+	// whether the GPU has passed it since it was last signalled. Neither waits
+	virtual int  NumFences() const = 0;
+	virtual void SignalFence(int fence) = 0;
+	virtual bool FenceDone(int fence) = 0;
+};
+
+
+// Backend in ordinary memory for running the ring without a GPU. The pretend GPU finishes each frame "latency" fences
+// later, and the mock counts maps and checks every write is to bytes no frame in flight is using
+class MockUploadBackend : public UploadBackend
+{
+public:
+	MockUploadBackend(int capacity, int numFences, int latency);
+
+	int   Capacity() const override { return static_cast<int>(mBuffer.size()); }
+	void* Map(UploadMap mode) override;
+	void  Unmap() override {}
+
+	int  NumFences() const override { return static_cast<int>(mSignalled.size()); }
+	void SignalFence(int fence) override;
+	bool FenceDone(int fence) override;
+
+	// Bytes [offset, offset + size) have been written for the frame after the last signalled fence. Returns false if any
+	// of them belong to a frame the pretend GPU hasn't finished since the buffer was last discarded
+	bool CheckWrite(int offset, int size);
+
+	int NumDiscards()    const { return mNumDiscards; }
+	int NumNoOverwrite() const { return mNumNoOverwrite; }
+
+private:
+	// Bytes written by the frame before the nth fence signalled, since the last discard
+	struct Write
+	{
+		int      offset;
+		int      size;
+		uint64_t fence;
+	};
+
+	std::vector<uint8_t>  mBuffer;
+	std::vector<uint64_t> mSignalled; // Count of fences signalled when each fence was last signalled
+	std::vector<Write>    mWrites;
+	uint64_t mNumSignalled = 0;
+	int mLatency;
+	int mNumDiscards    = 0;
+	int mNumNoOverwrite = 0;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Ring
+//--------------------------------------------------------------------------------------
+
+// Frames of uploads a ring is usually sized for, and fences for it: the frame being written and two the GPU may still be
+// drawing, which is as far behind as drivers usually let it get
+const int NumUploadFrames = 3;
+
+// What the ring has done since it was made
+struct UploadRingStats
+{
+	uint64_t numUploads  = 0;
+	uint64_t numBytes    = 0; // Bytes uploaded, not counting alignment or bytes skipped when wrapping
+	uint64_t numWraps    = 0; // Uploads that wrapped round to the start with no discard
+	uint64_t numDiscards = 0; // Maps with discard, including the first
+	uint64_t numTooBig   = 0; // Uploads bigger than the buffer, which fail
+};
+
+
+class UploadRing
+{
+public:
+	// Construction //
+
+	// The backend must outlive the ring. Frames in flight are limited by the backend's number of fences
+	UploadRing(UploadBackend& backend);
+
+
+	// Usage //
+
+	// Map space for up to maxBytes, aligned to a multiple of "alignment" bytes from the start of the buffer, and return
+	// where to write them, or nullptr if there isn't space in the whole buffer or the map fails. Call End with the bytes
+	// actually written before the next Begin
+	void* Begin(int maxBytes, int alignment);
+
+	// Unmap after a Begin. The first usedBytes (up to the maxBytes given) are kept for the GPU, the rest go back to the
+	// ring. Returns the offset of the upload in the buffer, to give to the draw call
+	int End(int usedBytes);
+
+	// Call after the draw calls of each frame using the uploads, to put a fence after them
+	void EndFrame();
+
+	const UploadRingStats& Stats() const { return mStats; }
+
+
+private:
+	// A frame whose GPU work may still be running, and the bytes of the ring its uploads use, from the end of the previous
+	// frame's (so including alignment and bytes skipped when wrapping)
+	struct Frame
+	{
+		int fence;
+		int numBytes;
+	};
+
+	// Forget frames the GPU has finished, freeing their bytes
+	void RetireFrames();
+
+	UploadBackend&    mBackend;
+	std::deque<Frame> mFrames;        // Oldest first
+	int  mCapacity;
+	int  mHead         = 0;           // Where the next upload goes, if it fits
+	int  mUsed         = 0;           // Bytes in use by frames in flight and the current frame, ending at mHead
+	int  mFrameBytes   = 0;           // Bytes used by the current frame so far
+	int  mNextFence    = 0;
+	bool mNeedsDiscard = true;        // The first map must discard
+
+	// Current upload
+	uint8_t* mMapped      = nullptr;
+	int      mBeginOffset = 0;
+	int      mBeginBytes  = 0;        // Bytes taken from the ring by Begin, before End gives any back
+
+	UploadRingStats mStats;
+};
+
+
+#endif //_UPLOAD_RING_H_INCLUDED_
@@ -0,0 +1,109 @@
+//--------------------------------------------------------------------------------------
+// Simple pool of worker threads for splitting loops across CPU cores
+//--------------------------------------------------------------------------------------
+
+#include "WorkerPool.h"
+
+
+// Create a pool that runs work on the given number of threads, including the thread that calls ParallelFor
+WorkerPool::WorkerPool(int numThreads)
+{
+	if (numThreads <= 0)
+	{
+		numThreads = static_cast<int>(std::thread::hardware_concurrency());
+		if (numThreads <= 0)  numThreads = 1;
+	}
+
+	// The calling thread also does work, so start one fewer worker
+	for (int i = 1; i < numThreads; ++i)
+	{
+		mThreads.emplace_back(&WorkerPool::WorkerLoop, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWake.notify_all();
+	for (auto& thread : mThreads)  thread.join();
+}
+
+
+// Call task(0) to task(numTasks - 1), spread over the threads in the pool. Returns when all tasks are complete
+void WorkerPool::ParallelFor(int numTasks, const std::function<void(int task)>& task)
+{
+	if (numTasks <= 0)  return;
+
+	// Not worth waking the workers for a single task
+	if (mThreads.empty() || numTasks == 1)
+	{
+		for (int i = 0; i < numTasks; ++i)  task(i);
+		return;
+	}
+
+	{
+		// A worker that woke late for the previous job may still be leaving RunTasks - wait for it before changing the job
+		std::unique_lock<std::mutex> lock(mMutex);
+		mDone.wait(lock, [this] { return mBusyWorkers == 0; });
+
+		mTask     = &task;
+		mNumTasks = numTasks;
+		mNextTask       = 0;
+		mTasksRemaining = numTasks;
+		++mGeneration;
+	}
+	mWake.notify_all();
+
+	// Calling thread works too
+	RunTasks();
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDone.wait(lock, [this] { return mTasksRemaining == 0 && mBusyWorkers == 0; });
+	mTask = nullptr;
+}
+
+
+// Take tasks from the current job until there are none left
+void WorkerPool::RunTasks()
+{
+	while (true)
+	{
+		int task = mNextTask++;
+		if (task >= mNumTasks)  return;
+
+		(*mTask)(task);
+
+		if (--mTasksRemaining == 0)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mDone.notify_all();
+		}
+	}
+}
+
+
+void WorkerPool::WorkerLoop()
+{
+	unsigned int seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [&] { return mQuit || mGeneration != seenGeneration; });
+			if (mQuit)  return;
+			seenGeneration = mGeneration;
+			++mBusyWorkers;
+		}
+
+		RunTasks();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			--mBusyWorkers;
+		}
+		mDone.notify_all();
+	}
+}
@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// Simple pool of worker threads for splitting loops across CPU cores
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+
+#ifndef _WORKER_POOL_H_INCLUDED_
+#define _WORKER_POOL_H_INCLUDED_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class WorkerPool
+{
+public:
+	// Construction //
+
+	// Create a pool that runs work on the given number of threads, including the thread that calls ParallelFor.
+	// Pass 0 to use one thread per hardware thread. A pool of 1 runs everything on the calling thread
+	WorkerPool(int numThreads = 0);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+
+	// Usage //
+
+	// Number of threads work is spread over, including the calling thread
+	int NumThreads() const { return static_cast<int>(mThreads.size()) + 1; }
+
+	// Call task(0) to task(numTasks - 1), spread over the threads in the pool. Returns when all tasks are complete.
+	// Tasks run in no particular order, so any results that need to be deterministic must be stored per task
+	// (not per thread) and combined afterwards in task order
+	void ParallelFor(int numTasks, const std::function<void(int task)>& task);
+
+
+private:
+	void WorkerLoop();
+	void RunTasks();
+
+	std::vector<std::thread> mThreads;
+
+	std::mutex              mMutex;
+	std::condition_variable mWake; // Signals workers that a new job is available (or to quit)
+	std::condition_variable mDone; // Signals the caller that the job has finished
+
+	const std::function<void(int)>* mTask = nullptr;
+	int                             mNumTasks = 0;
+	std::atomic<int>                mNextTask{0};
+	std::atomic<int>                mTasksRemaining{0};
+	int                             mBusyWorkers = 0;  // Workers currently inside RunTasks, protected by mMutex
+	unsigned int                    mGeneration  = 0;  // Incremented for each job so workers can tell a new job has started
+	bool                            mQuit        = false;
+};
+
+
+#endif //_WORKER_POOL_H_INCLUDED_